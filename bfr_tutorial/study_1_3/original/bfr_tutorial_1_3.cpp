@@ -34,20 +34,76 @@
 //      with the vertex positions and normals (previously illustrated) as
 //      part of the tessellation written to the Obj file.
 //
+//      With "-threads N" (0 for all hardware threads) faces are tessellated
+//      in parallel by workers sharing a single SurfaceFactory with a
+//      thread-safe cache.  The Obj file written is identical to that of a
+//      serial run.
+//
+//      With "-frames N" a simple animation of the mesh is tessellated, one
+//      Obj file per frame, with a tutorial::SurfaceCache that persists
+//      across frames (bounded to "-cache N" entries when specified) so
+//      that irregular patches are only constructed for the first frame.
+//
+//      With "-tolerance T" and/or "-pixels P" the uniform rate is replaced
+//      by adaptive rates for each edge, from a chordal error tolerance or
+//      a target edge length in pixels as seen from "-eye x y z" (with
+//      "-fov" and "-imagesize"), bounded by "-maxrate" and optionally by a
+//      budget of triangles for the mesh ("-budget N").
+//
+//      With "-shared" points on the edges and corners of faces are shared
+//      with adjacent faces -- evaluated and written once -- producing a
+//      watertight indexed mesh (UVs remain per face to preserve seams).
+//
+//      Positions of faces that are regular B-spline patches are evaluated
+//      with tutorial::BSplinePatch -- a few coordinates at once -- rather
+//      than one at a time with Surface::Evaluate().  Similarly, UVs that
+//      are linear for a face are interpolated directly from its corners.
+//
+//      With "-shortest" floats are written to the Obj file with the fewest
+//      digits that preserve their value, rather than as "%f".  An output
+//      file ending in ".ply" or ".raw" is written in binary instead (see
+//      utils/meshWriter.h), and "-quantize" writes the positions, normals
+//      and UVs of a ".raw" file as 16-bit integers (utils/quantization.h).
+//
+//      With "-vcache" the triangles of each tessellation pattern (and its
+//      points, unless shared) are ordered for the post-transform vertex
+//      cache by the workers, once for all faces sharing the pattern, and
+//      the ACMR (vertices transformed per triangle) is reported before and
+//      after (see utils/vertexCacheOrder.h).
+//
 
 #include <opensubdiv/far/topologyRefiner.h>
 #include <opensubdiv/bfr/refinerSurfaceFactory.h>
 #include <opensubdiv/bfr/surface.h>
 #include <opensubdiv/bfr/tessellation.h>
+#include <opensubdiv/bfr/surfaceFactoryCache.h>
 
 #include <vector>
 #include <string>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cassert>
 
 //  Local headers with support for this tutorial in "namespace tutorial"
+#include <utils/bsplinePatch.h>
+#include <utils/linearPatch.h>
 #include <utils/meshLoader.h>
-#include <utils/objWriter.h>
+#include <utils/meshWriter.h>
+#include <utils/orderedRing.h>
+#include <utils/parallel.h>
+#include <utils/quantization.h>
+#include <utils/surfaceCache.h>
+#include <utils/tessellationRates.h>
+#include <utils/tessellationPatternCache.h>
+#include <utils/vertexNormals.h>
 
 using namespace OpenSubdiv;
 
@@ -62,6 +118,23 @@ public:
     int             tessUniformRate;
     bool            tessQuadsFlag;
     bool            uv2xyzFlag;
+    int             numThreads;
+    int             numFrames;
+    int             cacheEntries;
+
+    //  Adaptive tessellation rates (enabled by a tolerance or pixel length):
+    float           tessTolerance;
+    float           tessPixelLength;
+    float           tessEye[3];
+    float           tessFieldOfView;
+    int             tessImageSize;
+    int             tessMaxRate;
+    int             tessMaxTriangles;
+
+    bool            sharedVerticesFlag;
+    bool            shortestFloatsFlag;
+    bool            quantizeFlag;
+    bool            vertexCacheFlag;
 
 public:
     Args(int argc, char * argv[]) :
@@ -70,7 +143,22 @@ public:
         schemeType(Sdc::SCHEME_CATMARK),
         tessUniformRate(5),
         tessQuadsFlag(false),
-        uv2xyzFlag(false) {
+        uv2xyzFlag(false),
+        numThreads(1),
+        numFrames(1),
+        cacheEntries(0),
+        tessTolerance(0.0f),
+        tessPixelLength(0.0f),
+        tessFieldOfView(45.0f),
+        tessImageSize(1080),
+        tessMaxRate(32),
+        tessMaxTriangles(0),
+        sharedVerticesFlag(false),
+        shortestFloatsFlag(false),
+        quantizeFlag(false),
+        vertexCacheFlag(false) {
+
+        tessEye[0] = tessEye[1] = tessEye[2] = 0.0f;
 
         for (int i = 1; i < argc; ++i) {
             if (strstr(argv[i], ".obj")) {
@@ -94,6 +182,36 @@ public:
                 tessQuadsFlag = true;
             } else if (!strcmp(argv[i], "-uv2xyz")) {
                 uv2xyzFlag = true;
+            } else if (!strcmp(argv[i], "-threads")) {
+                if (++i < argc) numThreads = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-frames")) {
+                if (++i < argc) numFrames = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-cache")) {
+                if (++i < argc) cacheEntries = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-tolerance")) {
+                if (++i < argc) tessTolerance = (float) atof(argv[i]);
+            } else if (!strcmp(argv[i], "-pixels")) {
+                if (++i < argc) tessPixelLength = (float) atof(argv[i]);
+            } else if (!strcmp(argv[i], "-eye")) {
+                for (int k = 0; (k < 3) && (++i < argc); ++k) {
+                    tessEye[k] = (float) atof(argv[i]);
+                }
+            } else if (!strcmp(argv[i], "-fov")) {
+                if (++i < argc) tessFieldOfView = (float) atof(argv[i]);
+            } else if (!strcmp(argv[i], "-imagesize")) {
+                if (++i < argc) tessImageSize = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-maxrate")) {
+                if (++i < argc) tessMaxRate = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-budget")) {
+                if (++i < argc) tessMaxTriangles = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-shared")) {
+                sharedVerticesFlag = true;
+            } else if (!strcmp(argv[i], "-shortest")) {
+                shortestFloatsFlag = true;
+            } else if (!strcmp(argv[i], "-quantize")) {
+                quantizeFlag = true;
+            } else if (!strcmp(argv[i], "-vcache")) {
+                vertexCacheFlag = true;
             } else {
                 fprintf(stderr,
                     "Warning: Unrecognized argument '%s' ignored\n", argv[i]);
@@ -105,21 +223,425 @@ private:
     Args() { }
 };
 
+//
+//  Use simpler local type names for the Surface and its factory.  The
+//  factory is assigned a thread-safe cache (SurfaceFactoryCacheThreaded
+//  with a reader/writer mutex) so that a single instance can be shared
+//  by all threads tessellating faces:
+//
+typedef Bfr::SurfaceFactoryCacheThreaded<std::shared_timed_mutex,
+                std::shared_lock<std::shared_timed_mutex>,
+                std::unique_lock<std::shared_timed_mutex> > ThreadedCache;
+
+typedef Bfr::RefinerSurfaceFactory<ThreadedCache> SurfaceFactory;
+typedef Bfr::Surface<float>                       Surface;
+
+//
+//  The tessellation of a single face -- points are evaluated and facets
+//  are identified relative to the face, so that faces can be processed in
+//  any order and written in face order afterwards:
+//
+struct FaceTessellation {
+    bool               valid;
+    std::vector<float> pos, du, dv, normals;
+    std::vector<float> uv;
+    std::vector<int>   facets;
+
+    //  Boundary of the tessellation when vertices are shared:
+    int                numBoundaryCoords;
+    std::vector<int>   edgeCounts;
+};
+
+//
+//  Ownership and indices of the points shared by faces when vertices are
+//  shared:  the points at a vertex or along an edge of the base mesh are
+//  evaluated and written by the first face incident to it with a limit
+//  surface.  Since faces are written in order, the Obj indices of these
+//  points are assigned before any other face refers to them.  Points of
+//  an edge are ordered from its first to its second vertex:
+//
+struct SharedBoundary {
+    Far::TopologyLevel const * baseLevel;
+
+    std::vector<int> vertexOwners;
+    std::vector<int> edgeOwners;
+
+    //  Obj index of each vertex and of the first point of each edge:
+    std::vector<int> vertexIndices;
+    std::vector<int> edgeIndices;
+
+    bool IsEdgeForward(int face, int faceEdge) const {
+        Far::ConstIndexArray fVerts = baseLevel->GetFaceVertices(face);
+        Far::ConstIndexArray fEdges = baseLevel->GetFaceEdges(face);
+        return baseLevel->GetEdgeVertices(fEdges[faceEdge])[0] ==
+               fVerts[faceEdge];
+    }
+};
+
+static void
+initSharedBoundary(SharedBoundary & shared,
+                   Far::TopologyRefiner const & meshTopology,
+                   SurfaceFactory const & surfaceFactory) {
+
+    Far::TopologyLevel const & baseLevel = meshTopology.GetLevel(0);
+
+    shared.baseLevel = &baseLevel;
+
+    shared.vertexOwners.assign(baseLevel.GetNumVertices(), -1);
+    shared.edgeOwners.assign(baseLevel.GetNumEdges(), -1);
+    shared.vertexIndices.assign(baseLevel.GetNumVertices(), -1);
+    shared.edgeIndices.assign(baseLevel.GetNumEdges(), -1);
+
+    for (int face = 0; face < baseLevel.GetNumFaces(); ++face) {
+        if (!surfaceFactory.FaceHasLimitSurface(face)) continue;
+
+        Far::ConstIndexArray fVerts = baseLevel.GetFaceVertices(face);
+        Far::ConstIndexArray fEdges = baseLevel.GetFaceEdges(face);
+        for (int i = 0; i < fVerts.size(); ++i) {
+            if (shared.vertexOwners[fVerts[i]] < 0) {
+                shared.vertexOwners[fVerts[i]] = face;
+            }
+            if (shared.edgeOwners[fEdges[i]] < 0) {
+                shared.edgeOwners[fEdges[i]] = face;
+            }
+        }
+    }
+}
+
+//
+//  Coordinates of the points of a face to be evaluated when vertices are
+//  shared -- those of the corners and edges owned by the face followed by
+//  those of the interior, in the order in which they are written:
+//
+static void
+gatherSharedCoords(SharedBoundary const & shared, int faceIndex,
+                   tutorial::TessellationPatternCache::Pattern const & pattern,
+                   std::vector<float> & coords, FaceTessellation & face) {
+
+    Far::ConstIndexArray fVerts = shared.baseLevel->GetFaceVertices(faceIndex);
+    Far::ConstIndexArray fEdges = shared.baseLevel->GetFaceEdges(faceIndex);
+
+    int faceSize = fVerts.size();
+
+    float const * patternCoords = pattern.coords.data();
+
+    coords.clear();
+    face.edgeCounts.assign(pattern.edgeCounts.begin(), pattern.edgeCounts.end());
+
+    //  Boundary points are ordered by vertex, each followed by the points
+    //  of its subsequent edge:
+    int vertexCoord = 0;
+    for (int i = 0; i < faceSize; ++i) {
+        int numEdgeCoords = pattern.edgeCounts[i];
+
+        if (shared.vertexOwners[fVerts[i]] == faceIndex) {
+            coords.insert(coords.end(), patternCoords + 2 * vertexCoord,
+                                        patternCoords + 2 * vertexCoord + 2);
+        }
+        if (shared.edgeOwners[fEdges[i]] == faceIndex) {
+            float const * edgeCoords = patternCoords + 2 * (vertexCoord + 1);
+            if (shared.IsEdgeForward(faceIndex, i)) {
+                coords.insert(coords.end(), edgeCoords,
+                                            edgeCoords + 2 * numEdgeCoords);
+            } else {
+                for (int j = numEdgeCoords - 1; j >= 0; --j) {
+                    coords.push_back(edgeCoords[2*j]);
+                    coords.push_back(edgeCoords[2*j + 1]);
+                }
+            }
+        }
+        vertexCoord += 1 + numEdgeCoords;
+    }
+
+    coords.insert(coords.end(), patternCoords + 2 * pattern.numBoundaryCoords,
+                                patternCoords + 2 * pattern.numCoords);
+
+    face.numBoundaryCoords = pattern.numBoundaryCoords;
+}
+
+//
+//  The Surfaces and intermediate buffers used by each worker.  Since
+//  dynamic memory is involved with these variables, they are preserved
+//  and reused across all faces processed by the worker:
+//
+struct FaceWorkspace {
+    Surface posSurface;
+    Surface uvSurface;
+
+    std::vector<float> facePatchPoints;
+    std::vector<float> sharedCoords;
+    std::vector<int>   faceRates;
+
+    //  Patterns shared by faces with the same parameterization and rates:
+    tutorial::TessellationPatternCache patternCache;
+
+    //  Facets and vertex cache misses of the patterns of all faces:
+    long numFacets;
+    long numOriginalCacheMisses;
+    long numCacheMisses;
+
+    FaceWorkspace() :
+        numFacets(0), numOriginalCacheMisses(0), numCacheMisses(0) { }
+};
+
+//
+//  Tessellate and evaluate a single face:
+//
+static void
+tessellateFace(SurfaceFactory             const & surfaceFactory,
+               std::vector<float>         const & meshVertexPositions,
+               std::vector<float>         const & meshFaceVaryingUVs,
+               int                                tessUniformRate,
+               tutorial::TessellationRates const * tessRates,
+               Bfr::Tessellation::Options const & tessOptions,
+               SharedBoundary             const * shared,
+               int faceIndex, FaceWorkspace & work, FaceTessellation & face) {
+
+    bool meshHasUVs = !meshFaceVaryingUVs.empty();
+
+    //
+    //  Initialize the Surfaces for position and UVs of this face.
+    //  There are two ways to do this -- both illustrated here:
+    //
+    //  Creating Surfaces for the different data interpolation types
+    //  independently is clear and convenient, but considerable work
+    //  may be duplicated in the construction process in the case of
+    //  non-linear face-varying Surfaces. So unless it is known that
+    //  face-varying interpolation is linear, use of InitSurfaces()
+    //  is generally preferred.
+    //
+    //  Remember also that the face-varying identifier is omitted from
+    //  the initialization methods here as it was previously assigned
+    //  to the SurfaceFactory::Options. In the absence of an assignment
+    //  of the default FVarID to the Options, a failure to specify the
+    //  FVarID here will result in failure.
+    //
+    //  The cases below are expanded for illustration purposes, and
+    //  validity of the resulting Surface is tested here, rather than
+    //  the return value of initialization methods.
+    //
+    Surface & posSurface = work.posSurface;
+    Surface & uvSurface  = work.uvSurface;
+
+    bool createSurfacesTogether = true;
+    if (!meshHasUVs) {
+        surfaceFactory.InitVertexSurface(faceIndex, &posSurface);
+    } else if (createSurfacesTogether) {
+        surfaceFactory.InitSurfaces(faceIndex, &posSurface, &uvSurface);
+    } else {
+        if (surfaceFactory.InitVertexSurface(faceIndex, &posSurface)) {
+            surfaceFactory.InitFaceVaryingSurface(faceIndex, &uvSurface);
+        }
+    }
+    face.valid = posSurface.IsValid();
+    if (!face.valid) return;
+
+    //
+    //  Identify the Tessellation for the Parameterization of this face --
+    //  either uniform or with the adaptive rates of its edges (and inner
+    //  rates of quads) -- and the coordinates of the points to evaluate.
+    //  Rather than declaring a Tessellation for each face, its coordinates
+    //  and facets are taken from the cache of patterns already generated:
+    //
+    Bfr::Parameterization faceParam = posSurface.GetParameterization();
+
+    int         numRates = 1;
+    int const * rates    = &tessUniformRate;
+    if (tessRates) {
+        work.faceRates.resize(faceParam.GetFaceSize() + 2);
+        numRates = tessRates->GetFaceRates(faceIndex, work.faceRates.data());
+        rates    = work.faceRates.data();
+    }
+    tutorial::TessellationPatternCache::Pattern const & tessPattern =
+            work.patternCache.GetPattern(faceParam, numRates, rates,
+                                         tessOptions);
+
+    work.numFacets              += tessPattern.numFacets;
+    work.numOriginalCacheMisses += tessPattern.numOriginalCacheMisses;
+    work.numCacheMisses         += tessPattern.numCacheMisses;
+
+    int numOutCoords = tessPattern.numCoords;
+
+    std::vector<float> const & outCoords = tessPattern.coords;
+
+    //
+    //  When vertices are shared, positions are only evaluated at the
+    //  points this face writes (UVs remain face-varying and are evaluated
+    //  at all points):
+    //
+    float const * posCoords    = outCoords.data();
+    int           numPosCoords = numOutCoords;
+    if (shared) {
+        gatherSharedCoords(*shared, faceIndex, tessPattern,
+                           work.sharedCoords, face);
+        posCoords    = work.sharedCoords.data();
+        numPosCoords = (int) work.sharedCoords.size() / 2;
+    }
+
+    //
+    //  Prepare the patch points for the Surface, then use them to
+    //  evaluate output points for all identified coordinates:
+    //
+    std::vector<float> & facePatchPoints = work.facePatchPoints;
+
+    //  Evaluate vertex positions:
+    {
+        //  Resize patch point and output arrays:
+        int pointSize = 3;
+
+        facePatchPoints.resize(posSurface.GetNumPatchPoints() * pointSize);
+
+        face.pos.resize(numPosCoords * pointSize);
+        face.du.resize(numPosCoords * pointSize);
+        face.dv.resize(numPosCoords * pointSize);
+
+        //  Populate patch point and output arrays:
+        posSurface.PreparePatchPoints(meshVertexPositions.data(), pointSize,
+                                      facePatchPoints.data(), pointSize);
+
+        //  Regular B-spline patches (the majority of faces) are evaluated
+        //  for blocks of coordinates at once, all others per coordinate:
+        if (tutorial::BSplinePatch::IsBSplineSurface(posSurface,
+                                                     facePatchPoints.data())) {
+            tutorial::BSplinePatch::Evaluate(facePatchPoints.data(),
+                    numPosCoords, posCoords,
+                    face.pos.data(), face.du.data(), face.dv.data());
+        } else {
+            for (int i = 0, j = 0; i < numPosCoords; ++i, j += pointSize) {
+                posSurface.Evaluate(&posCoords[i*2],
+                                    facePatchPoints.data(), pointSize,
+                                    &face.pos[j], &face.du[j], &face.dv[j]);
+            }
+        }
+
+        //  Normals are computed here in a batch (by the workers rather
+        //  than the writer):
+        face.normals.resize(numPosCoords * pointSize);
+        tutorial::ComputeVertexNormals(numPosCoords, face.du.data(), face.dv.data(),
+                                       face.normals.data());
+    }
+
+    //  Evaluate face-varying UVs (when present):
+    if (meshHasUVs) {
+        int pointSize = 2;
+
+        face.uv.resize(numOutCoords * pointSize);
+
+        //  UVs of quads and triangles that are linear (common with
+        //  face-varying data) are interpolated directly from the UVs of
+        //  their corners -- no patch points are needed:
+        if (tutorial::LinearPatch::IsLinearSurface(uvSurface)) {
+            tutorial::LinearPatch::Evaluate(uvSurface,
+                    meshFaceVaryingUVs.data(), pointSize,
+                    numOutCoords, outCoords.data(), face.uv.data());
+        } else {
+            //  Resize patch point array:
+            //      - note reuse of the same patch point array as position
+            facePatchPoints.resize(uvSurface.GetNumPatchPoints() * pointSize);
+
+            //  Populate patch point and output arrays:
+            uvSurface.PreparePatchPoints(meshFaceVaryingUVs.data(), pointSize,
+                                         facePatchPoints.data(), pointSize);
+
+            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
+                uvSurface.Evaluate(&outCoords[i*2],
+                                   facePatchPoints.data(), pointSize,
+                                   &face.uv[j]);
+            }
+        }
+    }
+
+    //
+    //  Identify the faces of the Tessellation -- indices are relative to
+    //  the points of this face and offset when written:
+    //
+    face.facets.assign(tessPattern.facets.begin(), tessPattern.facets.end());
+}
+
+//
+//  Write a face when vertices are shared -- assigning Obj indices to the
+//  points it owns and mapping its facets to the indices of its boundary
+//  (possibly written by other faces) and interior points.  UVs are written
+//  for every point of the face, so that UV seams are preserved:
+//
+static void
+writeSharedFace(SharedBoundary & shared, int faceIndex,
+                FaceTessellation const & face, int facetSize, bool meshHasUVs,
+                tutorial::MeshWriter & meshWriter,
+                std::vector<int> & boundaryIndices,
+                std::vector<int> & outFacets, std::vector<int> & outUVFacets) {
+
+    Far::ConstIndexArray fVerts = shared.baseLevel->GetFaceVertices(faceIndex);
+    Far::ConstIndexArray fEdges = shared.baseLevel->GetFaceEdges(faceIndex);
+
+    int nextIndex = meshWriter.GetNumVertices();
+
+    boundaryIndices.resize(face.numBoundaryCoords);
+
+    int numBoundary = 0;
+    for (int i = 0; i < fVerts.size(); ++i) {
+        int vertex = fVerts[i];
+        if (shared.vertexOwners[vertex] == faceIndex) {
+            shared.vertexIndices[vertex] = nextIndex++;
+        }
+        boundaryIndices[numBoundary++] = shared.vertexIndices[vertex];
+
+        int edge          = fEdges[i];
+        int numEdgePoints = face.edgeCounts[i];
+        if (shared.edgeOwners[edge] == faceIndex) {
+            shared.edgeIndices[edge] = nextIndex;
+            nextIndex += numEdgePoints;
+        }
+        bool forward = shared.IsEdgeForward(faceIndex, i);
+        for (int j = 0; j < numEdgePoints; ++j) {
+            boundaryIndices[numBoundary++] = shared.edgeIndices[edge] +
+                    (forward ? j : (numEdgePoints - 1 - j));
+        }
+    }
+    assert(numBoundary == face.numBoundaryCoords);
+
+    //  Interior points follow those owned on the boundary:
+    int interiorOffset = nextIndex - numBoundary;
+
+    outFacets.resize(face.facets.size());
+    for (size_t i = 0; i < face.facets.size(); ++i) {
+        int index = face.facets[i];
+        outFacets[i] = (index < 0) ? index : ((index < numBoundary) ?
+                       boundaryIndices[index] : (index + interiorOffset));
+    }
+
+    meshWriter.WriteVertexPositions(face.pos);
+    meshWriter.WriteVertexNormals(face.normals);
+
+    if (meshHasUVs) {
+        int uvIndexOffset = meshWriter.GetNumUVs();
+
+        outUVFacets.resize(face.facets.size());
+        for (size_t i = 0; i < face.facets.size(); ++i) {
+            int index = face.facets[i];
+            outUVFacets[i] = (index < 0) ? index : (index + uvIndexOffset);
+        }
+        meshWriter.WriteVertexUVs(face.uv);
+        meshWriter.WriteFaces(outFacets, outUVFacets, facetSize, true);
+    } else {
+        meshWriter.WriteFaces(outFacets, facetSize, true, false);
+    }
+}
+
 //
 //  The main tessellation function:  given a mesh and vertex positions,
-//  tessellate each face -- writing results in Obj format.
+//  tessellate each face -- writing results in Obj format.  Irregular
+//  patches are taken from (and added to) the given SurfaceCache when
+//  specified, rather than the cache internal to the SurfaceFactory.
+//  Returns false if the output could not be written:
 //
-void
+bool
 tessellateToObj(Far::TopologyRefiner const & meshTopology,
                 std::vector<float>   const & meshVertexPositions,
                 std::vector<float>   const & meshFaceVaryingUVs,
-                Args                 const & options) {
-
-    //
-    //  Use simpler local type names for the Surface and its factory:
-    //
-    typedef Bfr::RefinerSurfaceFactory<> SurfaceFactory;
-    typedef Bfr::Surface<float>          Surface;
+                Args                 const & options,
+                std::string          const & outputObjFile,
+                tutorial::SurfaceCache *     surfaceCache = 0) {
 
     //
     //  Initialize the SurfaceFactory for the given base mesh (very low
@@ -130,7 +652,8 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     //  use of an internal cache.  Creating a separate instance of the
     //  SurfaceFactory for each thread is one way to safely parallelize
     //  this loop.  Another (preferred) is to assign a thread-safe cache
-    //  to the single instance.
+    //  to the single instance -- as is done with the SurfaceFactory type
+    //  declared above.
     //
     //  First declare any evaluation options when initializing:
     //
@@ -146,26 +669,12 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     if (meshHasUVs) {
         surfaceOptions.SetDefaultFVarID(0);
     }
+    if (surfaceCache) {
+        surfaceOptions.SetExternalCache(surfaceCache);
+    }
 
     SurfaceFactory surfaceFactory(meshTopology, surfaceOptions);
 
-    //
-    //  The Surface to be constructed and evaluated for each face -- as
-    //  well as the intermediate and output data associated with it -- can
-    //  be declared in the scope local to each face. But since dynamic
-    //  memory is involved with these variables, it is preferred to declare
-    //  them outside that loop to preserve and reuse that dynamic memory.
-    //
-    Surface posSurface;
-    Surface uvSurface;
-
-    std::vector<float> facePatchPoints;
-
-    std::vector<float> outCoords;
-    std::vector<float> outPos, outDu, outDv;
-    std::vector<float> outUV;
-    std::vector<int>   outFacets;
-
     //
     //  Assign Tessellation Options applied for all faces.  Tessellations
     //  allow the creating of either 3- or 4-sided faces -- both of which
@@ -178,139 +687,222 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     tessOptions.PreserveQuads(options.tessQuadsFlag);
 
     //
-    //  Process each face, writing the output of each in Obj format:
+    //  Faces are divided into chunks that workers claim in turn, each
+    //  worker tessellating its faces with its own Surfaces and buffers.
+    //  Completed tessellations are handed to a writer thread through an
+    //  OrderedRing and written in face order (so the output does not depend
+    //  on the number of threads) while the workers continue -- waiting
+    //  only when the ring is full:
     //
-    tutorial::ObjWriter objWriter(options.outputObjFile);
+    int const numThreads = tutorial::GetNumThreads(options.numThreads);
 
-    int numFaces = surfaceFactory.GetNumFaces();
-    for (int faceIndex = 0; faceIndex < numFaces; ++faceIndex) {
-        //
-        //  Initialize the Surfaces for position and UVs of this face.
-        //  There are two ways to do this -- both illustrated here:
-        //
-        //  Creating Surfaces for the different data interpolation types
-        //  independently is clear and convenient, but considerable work
-        //  may be duplicated in the construction process in the case of
-        //  non-linear face-varying Surfaces. So unless it is known that
-        //  face-varying interpolation is linear, use of InitSurfaces()
-        //  is generally preferred.
-        //
-        //  Remember also that the face-varying identifier is omitted from
-        //  the initialization methods here as it was previously assigned
-        //  to the SurfaceFactory::Options. In the absence of an assignment
-        //  of the default FVarID to the Options, a failure to specify the
-        //  FVarID here will result in failure.
-        //
-        //  The cases below are expanded for illustration purposes, and
-        //  validity of the resulting Surface is tested here, rather than
-        //  the return value of initialization methods.
-        //
-        bool createSurfacesTogether = true;
-        if (!meshHasUVs) {
-            surfaceFactory.InitVertexSurface(faceIndex, &posSurface);
-        } else if (createSurfacesTogether) {
-            surfaceFactory.InitSurfaces(faceIndex, &posSurface, &uvSurface);
+    //
+    //  Adaptive rates are computed for all edges before tessellating, so
+    //  that both faces of an edge use the same rate:
+    //
+    tutorial::TessellationRates * tessRates = 0;
+    if ((options.tessTolerance > 0.0f) || (options.tessPixelLength > 0.0f)) {
+        float const degToRad = 3.14159265f / 180.0f;
+
+        tutorial::TessellationRates::Options rateOptions;
+        rateOptions.chordalTolerance = options.tessTolerance;
+        rateOptions.pixelLength      = options.tessPixelLength;
+        rateOptions.eye[0]           = options.tessEye[0];
+        rateOptions.eye[1]           = options.tessEye[1];
+        rateOptions.eye[2]           = options.tessEye[2];
+        rateOptions.focalLength      = 0.5f * (float) options.tessImageSize /
+                std::tan(0.5f * options.tessFieldOfView * degToRad);
+        rateOptions.maxRate          = options.tessMaxRate;
+        rateOptions.maxTriangles     = options.tessMaxTriangles;
+
+        tessRates = new tutorial::TessellationRates(meshTopology,
+                surfaceFactory, meshVertexPositions.data(), rateOptions,
+                numThreads);
+
+        fprintf(stderr, "Adaptive rates: %ld triangles (budget scale %g)\n",
+                tessRates->GetNumTriangles(), tessRates->GetBudgetScale());
+    }
+
+    int const chunkSize  = 64;
+    int const ringSize   = numThreads * chunkSize * 4;
+
+    std::vector<FaceWorkspace> workspaces(numThreads);
+
+    tutorial::OrderedRing<FaceTessellation> faceRing(ringSize);
+
+    std::vector<float> const noUVs;
+
+    //
+    //  Points on the boundaries of faces are evaluated and written once
+    //  when vertices are shared (not with UVs written as positions, since
+    //  UVs are not continuous across seams):
+    //
+    SharedBoundary * shared = 0;
+    if (options.sharedVerticesFlag) {
+        if (meshHasUVs && options.uv2xyzFlag) {
+            fprintf(stderr, "Warning: Shared vertices ignored with -uv2xyz\n");
         } else {
-            if (surfaceFactory.InitVertexSurface(faceIndex, &posSurface)) {
-                surfaceFactory.InitFaceVaryingSurface(faceIndex, &uvSurface);
-            }
+            shared = new SharedBoundary;
+            initSharedBoundary(*shared, meshTopology, surfaceFactory);
         }
-        if (!posSurface.IsValid()) continue;
+    }
 
-        //
-        //  Declare a simple uniform Tessellation for the Parameterization
-        //  of this face and identify coordinates of the points to evaluate:
-        //
-        Bfr::Tessellation tessPattern(posSurface.GetParameterization(),
-                                      options.tessUniformRate, tessOptions);
+    //
+    //  Triangles of the patterns are ordered for the vertex cache by the
+    //  workers when generated (points are reordered only when not shared,
+    //  as shared points are ordered by boundary and interior):
+    //
+    bool orderForVertexCache = options.vertexCacheFlag && (tessFacetSize == 3);
+    if (options.vertexCacheFlag && !orderForVertexCache) {
+        fprintf(stderr, "Warning: Vertex cache order ignored with -quads\n");
+    }
+    if (orderForVertexCache) {
+        typedef tutorial::TessellationPatternCache PatternCache;
 
-        int numOutCoords = tessPattern.GetNumCoords();
+        PatternCache::Order order = shared ? PatternCache::ORDER_FACETS :
+                                             PatternCache::ORDER_FACETS_AND_COORDS;
+        for (FaceWorkspace & work : workspaces) {
+            work.patternCache.SetOrder(order);
+        }
+    }
+
+    //  The writer is chosen by the extension of the output file (Obj,
+    //  binary PLY or raw arrays):
+    std::unique_ptr<tutorial::MeshWriter> meshWriter(
+            tutorial::MeshWriter::Create(outputObjFile));
+    //  Arrays of a face large enough (e.g. at high tessellation rates) are
+    //  formatted as text on as many threads as faces are tessellated:
+    meshWriter->SetNumThreads(numThreads);
+    if (options.shortestFloatsFlag) {
+        meshWriter->SetFloatFormat(tutorial::FloatFormat::SHORTEST);
+    }
+    if (options.quantizeFlag) {
+        meshWriter->SetQuantization(tutorial::QUANTIZE_POSITIONS |
+                                    tutorial::QUANTIZE_NORMALS |
+                                    tutorial::QUANTIZE_UVS);
+    }
 
-        outCoords.resize(numOutCoords * 2);
+    std::vector<int> outFacets;
+    std::vector<int> outUVFacets;
+    std::vector<int> boundaryIndices;
 
-        tessPattern.GetCoords(outCoords.data());
+    //
+    //  Write the evaluated points and faces connecting them as Obj:
+    //
+    auto writeFace = [&](int faceIndex, FaceTessellation const & face) {
+        if (!face.valid) return;
+
+        if (shared) {
+            meshWriter->WriteGroupName("baseFace_", faceIndex);
+            writeSharedFace(*shared, faceIndex, face, tessFacetSize,
+                            meshHasUVs, *meshWriter, boundaryIndices,
+                            outFacets, outUVFacets);
+            return;
+        }
 
         //
-        //  Prepare the patch points for the Surface, then use them to
-        //  evaluate output points for all identified coordinates:
+        //  Note the need to offset vertex indices for the output faces
+        //  -- using the number of vertices generated prior to this face
+        //  (unused indices of triangles among quads remain negative):
         //
-        //  Evaluate vertex positions:
-        {
-            //  Resize patch point and output arrays:
-            int pointSize = 3;
+        int objVertexIndexOffset = meshWriter->GetNumVertices();
 
-            facePatchPoints.resize(posSurface.GetNumPatchPoints() * pointSize);
-
-            outPos.resize(numOutCoords * pointSize);
-            outDu.resize(numOutCoords * pointSize);
-            outDv.resize(numOutCoords * pointSize);
+        outFacets.resize(face.facets.size());
+        for (size_t i = 0; i < face.facets.size(); ++i) {
+            outFacets[i] = (face.facets[i] < 0) ? face.facets[i] :
+                           (face.facets[i] + objVertexIndexOffset);
+        }
 
-            //  Populate patch point and output arrays:
-            posSurface.PreparePatchPoints(meshVertexPositions.data(), pointSize,
-                                          facePatchPoints.data(), pointSize);
+        meshWriter->WriteGroupName("baseFace_", faceIndex);
 
-            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
-                posSurface.Evaluate(&outCoords[i*2],
-                                    facePatchPoints.data(), pointSize,
-                                    &outPos[j], &outDu[j], &outDv[j]);
+        if (meshHasUVs && options.uv2xyzFlag) {
+            meshWriter->WriteVertexPositions(face.uv, 2);
+            meshWriter->WriteFaces(outFacets, tessFacetSize, false, false);
+        } else {
+            meshWriter->WriteVertexPositions(face.pos);
+            meshWriter->WriteVertexNormals(face.normals);
+            if (meshHasUVs) {
+                meshWriter->WriteVertexUVs(face.uv);
             }
+            meshWriter->WriteFaces(outFacets, tessFacetSize, true, meshHasUVs);
         }
+    };
 
-        //  Evaluate face-varying UVs (when present):
-        if (meshHasUVs) {
-            //  Resize patch point and output arrays:
-            //      - note reuse of the same patch point array as position
-            int pointSize = 2;
+    int numFaces = surfaceFactory.GetNumFaces();
 
-            facePatchPoints.resize(uvSurface.GetNumPatchPoints() * pointSize);
+    std::thread writerThread([&]() {
+        for (int faceIndex = 0; faceIndex < numFaces; ++faceIndex) {
+            writeFace(faceIndex, faceRing.WaitForItem(faceIndex));
+            faceRing.ReleaseItem(faceIndex);
+        }
+    });
+
+    std::atomic<int> nextChunk(0);
+
+    tutorial::ParallelFor(0, numThreads, 1, [&](int workerBegin,
+                                                int workerEnd) {
+        for (int worker = workerBegin; worker < workerEnd; ++worker) {
+            int chunkBegin;
+            while ((chunkBegin = nextChunk.fetch_add(chunkSize)) < numFaces) {
+                int chunkEnd = std::min(chunkBegin + chunkSize, numFaces);
+                for (int faceIndex = chunkBegin; faceIndex < chunkEnd;
+                        ++faceIndex) {
+                    tessellateFace(surfaceFactory, meshVertexPositions,
+                                   meshHasUVs ? meshFaceVaryingUVs : noUVs,
+                                   options.tessUniformRate, tessRates,
+                                   tessOptions, shared,
+                                   faceIndex, workspaces[worker],
+                                   faceRing.AcquireItem(faceIndex));
+                    faceRing.PublishItem(faceIndex);
+                }
+            }
+        }
+    }, numThreads);
 
-            outUV.resize(numOutCoords * pointSize);
+    writerThread.join();
 
-            //  Populate patch point and output arrays:
-            uvSurface.PreparePatchPoints(meshFaceVaryingUVs.data(), pointSize,
-                                         facePatchPoints.data(), pointSize);
+    //  Write all output before reporting, checking for failure:
+    bool success = meshWriter->Close();
 
-            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
-                uvSurface.Evaluate(&outCoords[i*2],
-                                   facePatchPoints.data(), pointSize,
-                                   &outUV[j]);
-            }
+    if (orderForVertexCache) {
+        long numFacets = 0, numOriginalMisses = 0, numMisses = 0;
+        for (FaceWorkspace const & work : workspaces) {
+            numFacets         += work.numFacets;
+            numOriginalMisses += work.numOriginalCacheMisses;
+            numMisses         += work.numCacheMisses;
+        }
+        if (numFacets > 0) {
+            fprintf(stderr, "Vertex cache:  ACMR %.3f before, %.3f after "
+                    "(%ld triangles)\n",
+                    (double) numOriginalMisses / (double) numFacets,
+                    (double) numMisses / (double) numFacets, numFacets);
         }
+    }
 
-        //
-        //  Identify the faces of the Tessellation:
-        //
-        //  Note the need to offset vertex indices for the output faces --
-        //  using the number of vertices generated prior to this face. One
-        //  of several Tessellation methods to transform the facet indices
-        //  simply translates all indices by the desired offset.
-        //
-        int objVertexIndexOffset = objWriter.GetNumVertices();
+    delete tessRates;
+    delete shared;
+    return success;
+}
 
-        int numFacets = tessPattern.GetNumFacets();
-        outFacets.resize(numFacets * tessFacetSize);
-        tessPattern.GetFacets(outFacets.data());
+//
+//  Name of the file for a frame of an animation, e.g. "mesh_0003.obj":
+//
+std::string
+frameObjFile(std::string const & objFile, int frame) {
 
-        tessPattern.TransformFacetCoordIndices(outFacets.data(),
-                                               objVertexIndexOffset);
+    if (objFile.empty()) return objFile;
 
-        //
-        //  Write the evaluated points and faces connecting them as Obj:
-        //
-        objWriter.WriteGroupName("baseFace_", faceIndex);
+    char frameSuffix[32];
+    snprintf(frameSuffix, sizeof(frameSuffix), "_%04d", frame);
 
-        if (meshHasUVs && options.uv2xyzFlag) {
-            objWriter.WriteVertexPositions(outUV, 2);
-            objWriter.WriteFaces(outFacets, tessFacetSize, false, false);
-        } else {
-            objWriter.WriteVertexPositions(outPos);
-            objWriter.WriteVertexNormals(outDu, outDv);
-            if (meshHasUVs) {
-                objWriter.WriteVertexUVs(outUV);
-            }
-            objWriter.WriteFaces(outFacets, tessFacetSize, true, meshHasUVs);
-        }
+    size_t extension = objFile.rfind('.');
+    size_t directory = objFile.find_last_of("/\\");
+    if ((extension == std::string::npos) ||
+            ((directory != std::string::npos) && (extension < directory))) {
+        return objFile + frameSuffix;
     }
+
+    return objFile.substr(0, extension) + frameSuffix + objFile.substr(extension);
 }
 
 //
@@ -331,10 +923,49 @@ main(int argc, char * argv[]) {
         return EXIT_FAILURE;
     }
 
-    tessellateToObj(*meshTopology, meshVtxPositions, meshFVarUVs, args);
+    bool success = true;
+    if (args.numFrames <= 1) {
+        success = tessellateToObj(*meshTopology, meshVtxPositions, meshFVarUVs,
+                                  args, args.outputObjFile);
+    } else {
+        //
+        //  Tessellate a simple animation of the mesh -- a uniform scaling
+        //  varying per frame -- with a SurfaceCache that persists across
+        //  frames, so that irregular patches are only constructed for the
+        //  first frame:
+        //
+        tutorial::SurfaceCache surfaceCache(args.cacheEntries);
+
+        std::vector<float> framePositions(meshVtxPositions.size());
+
+        for (int frame = 0; frame < args.numFrames; ++frame) {
+            float scale = 1.0f + 0.1f * std::sin(0.5f * (float) frame);
+            for (size_t i = 0; i < meshVtxPositions.size(); ++i) {
+                framePositions[i] = scale * meshVtxPositions[i];
+            }
+
+            surfaceCache.ResetCounters();
+
+            std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+
+            success = tessellateToObj(*meshTopology, framePositions,
+                                      meshFVarUVs, args,
+                                      frameObjFile(args.outputObjFile, frame),
+                                      &surfaceCache) && success;
+
+            double ms = 1000.0 * std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+
+            fprintf(stderr, "Frame %d: %.3f ms -- SurfaceCache: %zu entries, "
+                    "%zu hits, %zu misses, %zu evictions\n", frame, ms,
+                    surfaceCache.GetNumEntries(), surfaceCache.GetNumHits(),
+                    surfaceCache.GetNumMisses(), surfaceCache.GetNumEvictions());
+        }
+    }
 
     delete meshTopology;
-    return EXIT_SUCCESS;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 //------------------------------------------------------------------------------
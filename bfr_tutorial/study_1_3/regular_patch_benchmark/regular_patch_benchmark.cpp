@@ -0,0 +1,349 @@
+//------------------------------------------------------------------------------
+//  Benchmark of the evaluation of regular faces:
+//
+//  The mesh is refined uniformly (so that most faces are regular) and the
+//  refined faces become the base faces of a new mesh for Bfr.  A grid of
+//  coordinates is then evaluated for every face that is a regular B-spline
+//  patch -- first with Surface::Evaluate() per coordinate (as done in
+//  bfr_tutorial_1_3) and then with tutorial::BSplinePatch -- and both the
+//  speedup and the largest differences of the results are reported.  The
+//  benchmark fails if any difference exceeds the tolerance of
+//  BSplinePatch::IsBSplineSurface(), relative to the magnitude of the
+//  patch points.
+//
+#include <opensubdiv/far/topologyDescriptor.h>
+#include <opensubdiv/far/topologyRefinerFactory.h>
+#include <opensubdiv/far/primvarRefiner.h>
+#include <opensubdiv/bfr/refinerSurfaceFactory.h>
+#include <opensubdiv/bfr/surface.h>
+
+#include <utils/bsplinePatch.h>
+#include <utils/meshLoader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace OpenSubdiv;
+
+typedef Bfr::RefinerSurfaceFactory<> SurfaceFactory;
+typedef Bfr::Surface<float>          Surface;
+
+//
+//  Command line arguments:
+//
+class Args {
+public:
+    std::string inputObjFile;
+    int         refineLevel;
+    int         tessRate;
+    int         numRepeats;
+
+public:
+    Args(int argc, char * argv[]) :
+        inputObjFile(),
+        refineLevel(2),
+        tessRate(16),
+        numRepeats(10) {
+
+        for (int i = 1; i < argc; ++i) {
+            if (strstr(argv[i], ".obj")) {
+                if (inputObjFile.empty()) {
+                    inputObjFile = std::string(argv[i]);
+                } else {
+                    fprintf(stderr,
+                        "Warning: Extra Obj file '%s' ignored\n", argv[i]);
+                }
+            } else if (!strcmp(argv[i], "-level")) {
+                if (++i < argc) refineLevel = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-res")) {
+                if (++i < argc) tessRate = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-repeat")) {
+                if (++i < argc) numRepeats = atoi(argv[i]);
+            } else {
+                fprintf(stderr,
+                    "Warning: Unrecognized argument '%s' ignored\n", argv[i]);
+            }
+        }
+        refineLevel = std::max(0, refineLevel);
+        tessRate    = std::max(1, tessRate);
+        numRepeats  = std::max(1, numRepeats);
+    }
+
+private:
+    Args() { }
+};
+
+namespace {
+    double
+    elapsedSeconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+    //  Minimal vertex interface for the Far::PrimvarRefiner:
+    struct Vertex {
+        void Clear(void * = 0) { point[0] = point[1] = point[2] = 0.0f; }
+
+        void AddWithWeight(Vertex const & src, float weight) {
+            point[0] += weight * src.point[0];
+            point[1] += weight * src.point[1];
+            point[2] += weight * src.point[2];
+        }
+
+        float point[3];
+    };
+}
+
+//
+//  Refine the mesh uniformly and create a new TopologyRefiner with the
+//  faces of the last level as its base faces:
+//
+static Far::TopologyRefiner *
+createRefinedMesh(Far::TopologyRefiner & refiner, int level,
+                  std::vector<float> & positions) {
+
+    refiner.RefineUniform(Far::TopologyRefiner::UniformOptions(level));
+
+    std::vector<Vertex> vertices(refiner.GetNumVerticesTotal());
+    std::memcpy(&vertices[0], &positions[0], positions.size() * sizeof(float));
+
+    Far::PrimvarRefiner primvarRefiner(refiner);
+
+    Vertex * src = &vertices[0];
+    for (int i = 1; i <= level; ++i) {
+        Vertex * dst = src + refiner.GetLevel(i - 1).GetNumVertices();
+        primvarRefiner.Interpolate(i, src, dst);
+        src = dst;
+    }
+
+    Far::TopologyLevel const & lastLevel = refiner.GetLevel(level);
+
+    std::vector<int> faceSizes(lastLevel.GetNumFaces());
+    std::vector<int> faceVerts;
+    for (int face = 0; face < lastLevel.GetNumFaces(); ++face) {
+        Far::ConstIndexArray fVerts = lastLevel.GetFaceVertices(face);
+        faceSizes[face] = fVerts.size();
+        faceVerts.insert(faceVerts.end(), &fVerts[0], &fVerts[0] + fVerts.size());
+    }
+
+    positions.resize(lastLevel.GetNumVertices() * 3);
+    std::memcpy(&positions[0], src, positions.size() * sizeof(float));
+
+    typedef Far::TopologyDescriptor Descriptor;
+
+    Descriptor descriptor;
+    descriptor.numVertices        = lastLevel.GetNumVertices();
+    descriptor.numFaces           = lastLevel.GetNumFaces();
+    descriptor.numVertsPerFace    = &faceSizes[0];
+    descriptor.vertIndicesPerFace = &faceVerts[0];
+
+    typedef Far::TopologyRefinerFactory<Descriptor> RefinerFactory;
+
+    return RefinerFactory::Create(descriptor,
+            RefinerFactory::Options(refiner.GetSchemeType(),
+                                    refiner.GetSchemeOptions()));
+}
+
+//
+//  Largest absolute difference of two arrays:
+//
+static float
+maxDifference(std::vector<float> const & a, std::vector<float> const & b) {
+
+    float d = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        d = std::max(d, std::abs(a[i] - b[i]));
+    }
+    return d;
+}
+
+//
+//  Largest difference of the results of two arrays for all patches, each
+//  relative to the magnitude of the patch points (as the tolerance of
+//  BSplinePatch::IsBSplineSurface() is):
+//
+static float
+maxRelativeDifference(std::vector<float> const & a,
+                      std::vector<float> const & b,
+                      std::vector<float> const & patchPoints, int numCoords) {
+
+    int numPatches = (int) patchPoints.size() / 48;
+
+    float d = 0.0f;
+    for (int p = 0; p < numPatches; ++p) {
+        float magnitude = 1.0f;
+        for (int i = 0; i < 48; ++i) {
+            magnitude = std::max(magnitude, std::abs(patchPoints[48 * p + i]));
+        }
+
+        size_t base = (size_t) p * numCoords * 3;
+        for (int i = 0; i < numCoords * 3; ++i) {
+            d = std::max(d, std::abs(a[base + i] - b[base + i]) / magnitude);
+        }
+    }
+    return d;
+}
+
+//
+//  Load and refine the mesh, identify its regular faces and time both
+//  evaluations of their grids:
+//
+int
+main(int argc, char * argv[]) {
+
+    Args args(argc, argv);
+
+    std::vector<float> coarsePos;
+    std::vector<float> coarseUVs;
+
+    Far::TopologyRefiner * coarseMesh = tutorial::createTopologyRefiner(
+            args.inputObjFile, Sdc::SCHEME_CATMARK, coarsePos, coarseUVs);
+    if (coarseMesh == 0) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<float> meshPos(coarsePos);
+
+    Far::TopologyRefiner * mesh =
+            createRefinedMesh(*coarseMesh, args.refineLevel, meshPos);
+    delete coarseMesh;
+    if (mesh == 0) {
+        return EXIT_FAILURE;
+    }
+
+    int numFaces = mesh->GetLevel(0).GetNumFaces();
+
+    //
+    //  Gather the Surfaces and patch points of all regular B-spline faces:
+    //
+    SurfaceFactory surfaceFactory(*mesh);
+
+    std::vector<Surface> surfaces;
+    std::vector<float>   patchPoints;
+
+    Surface surface;
+    std::vector<float> facePatchPoints;
+
+    int numRegularFaces = 0;
+    for (int face = 0; face < numFaces; ++face) {
+        if (!surfaceFactory.InitVertexSurface(face, &surface)) continue;
+
+        numRegularFaces += surface.IsRegular();
+
+        facePatchPoints.resize(surface.GetNumPatchPoints() * 3);
+        surface.PreparePatchPoints(meshPos.data(), 3,
+                                   facePatchPoints.data(), 3);
+
+        if (tutorial::BSplinePatch::IsBSplineSurface(surface,
+                                                     facePatchPoints.data())) {
+            surfaces.push_back(surface);
+            patchPoints.insert(patchPoints.end(),
+                               facePatchPoints.begin(), facePatchPoints.end());
+        }
+    }
+
+    int numPatches = (int) surfaces.size();
+    if (numPatches == 0) {
+        fprintf(stderr, "Error:  No regular B-spline faces to evaluate "
+                        "(increase -level)\n");
+        delete mesh;
+        return EXIT_FAILURE;
+    }
+
+    //
+    //  The same grid of coordinates is evaluated for all faces:
+    //
+    int numCoords = (args.tessRate + 1) * (args.tessRate + 1);
+
+    std::vector<float> coords(2 * numCoords);
+    for (int i = 0, k = 0; i <= args.tessRate; ++i) {
+        for (int j = 0; j <= args.tessRate; ++j, ++k) {
+            coords[2 * k    ] = (float) j / (float) args.tessRate;
+            coords[2 * k + 1] = (float) i / (float) args.tessRate;
+        }
+    }
+
+    size_t numResults = (size_t) numPatches * numCoords * 3;
+
+    std::vector<float> genericP(numResults), genericDu(numResults), genericDv(numResults);
+    std::vector<float> kernelP(numResults),  kernelDu(numResults),  kernelDv(numResults);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < args.numRepeats; ++r) {
+        for (int p = 0; p < numPatches; ++p) {
+            size_t base = (size_t) p * numCoords * 3;
+            for (int i = 0; i < numCoords; ++i) {
+                size_t j = base + 3 * i;
+                surfaces[p].Evaluate(&coords[2 * i], &patchPoints[48 * p], 3,
+                                     &genericP[j], &genericDu[j], &genericDv[j]);
+            }
+        }
+    }
+    double genericSeconds = elapsedSeconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < args.numRepeats; ++r) {
+        for (int p = 0; p < numPatches; ++p) {
+            size_t base = (size_t) p * numCoords * 3;
+            tutorial::BSplinePatch::Evaluate(&patchPoints[48 * p], numCoords,
+                    coords.data(),
+                    &kernelP[base], &kernelDu[base], &kernelDv[base]);
+        }
+    }
+    double kernelSeconds = elapsedSeconds(start);
+
+    //
+    //  Report:
+    //
+    double numEvals = (double) numPatches * numCoords * args.numRepeats;
+
+    printf("Mesh:     %d faces (level %d), %d regular, %d B-spline patches\n",
+        numFaces, args.refineLevel, numRegularFaces, numPatches);
+    printf("Grid:     %d coordinates per face, %d repeats\n",
+        numCoords, args.numRepeats);
+#if defined(__AVX__)
+    printf("Kernel:   AVX, %d coordinates per block\n",
+        tutorial::BSplinePatch::kBlockSize);
+#else
+    printf("Kernel:   portable, %d coordinates per block\n",
+        tutorial::BSplinePatch::kBlockSize);
+#endif
+    printf("Throughput:\n");
+    printf("  Surface::Evaluate : %10.3f ms %12.0f evals/s\n",
+        genericSeconds * 1000.0, numEvals / genericSeconds);
+    printf("  BSplinePatch      : %10.3f ms %12.0f evals/s (x%.2f)\n",
+        kernelSeconds * 1000.0, numEvals / kernelSeconds,
+        genericSeconds / kernelSeconds);
+
+    //
+    //  Compare the results within the tolerance relative to each patch:
+    //
+    float const tolerance = tutorial::BSplinePatch::kTolerance;
+
+    float relativeP  = maxRelativeDifference(genericP,  kernelP,
+                                             patchPoints, numCoords);
+    float relativeDu = maxRelativeDifference(genericDu, kernelDu,
+                                             patchPoints, numCoords);
+    float relativeDv = maxRelativeDifference(genericDv, kernelDv,
+                                             patchPoints, numCoords);
+
+    bool matches = (relativeP  <= tolerance) &&
+                   (relativeDu <= tolerance) &&
+                   (relativeDv <= tolerance);
+
+    printf("Max difference (absolute, relative):\n");
+    printf("  P  : %g, %g\n", maxDifference(genericP,  kernelP),  relativeP);
+    printf("  Du : %g, %g\n", maxDifference(genericDu, kernelDu), relativeDu);
+    printf("  Dv : %g, %g\n", maxDifference(genericDv, kernelDv), relativeDv);
+    printf("Results:  %s (relative tolerance %g)\n",
+        matches ? "PASS" : "FAIL", tolerance);
+
+    delete mesh;
+    return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
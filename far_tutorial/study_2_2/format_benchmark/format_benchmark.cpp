@@ -0,0 +1,268 @@
+//------------------------------------------------------------------------------
+// Benchmark of the formatting of a refined mesh as Obj text:
+//
+// The mesh is refined uniformly (to level 4 by default) as in
+// obj_far_tutorial_2_2, and the vertices and faces of the last level are
+// formatted in memory as WriteOBJ() does -- first with boost::format per
+// value and then with tutorial::FormatBuffer, on one thread and on all
+// threads.  The time of each and whether their text is identical are
+// reported.
+//
+// The same vertices and faces are also written to a temporary Obj file with
+// tutorial::ObjWriter -- each array in a single call, formatted on one
+// thread and on all threads -- and the two files compared.
+//
+
+#include <opensubdiv/far/primvarRefiner.h>
+#include <opensubdiv/far/topologyDescriptor.h>
+
+#include <boost/format.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utils/fastFormat.h>
+#include <utils/objWriter.h>
+#include <utils/parallelFormat.h>
+#include <utils/shape_utils.h>
+
+struct Vertex
+{
+  void Clear(void* = 0) { _position[0] = _position[1] = _position[2] = 0.0f; }
+
+  void AddWithWeight(Vertex const& src, float weight)
+  {
+    _position[0] += weight * src._position[0];
+    _position[1] += weight * src._position[1];
+    _position[2] += weight * src._position[2];
+  }
+
+  float _position[3];
+};
+
+// Obj text of the last level with boost::format, as WriteOBJ() was written
+std::string FormatWithBoost(OpenSubdiv::Far::TopologyLevel const& level, Vertex const* verts)
+{
+  std::ostringstream objStream;
+  for (int vert = 0; vert < level.GetNumVertices(); ++vert)
+  {
+    float const* pos = verts[vert]._position;
+    objStream << boost::format("v %1% %2% %3%\n") % pos[0] % pos[1] % pos[2];
+  }
+  for (int face = 0; face < level.GetNumFaces(); ++face)
+  {
+    OpenSubdiv::Far::ConstIndexArray fverts = level.GetFaceVertices(face);
+    objStream << "f ";
+    for (int vert = 0; vert < fverts.size(); ++vert)
+    {
+      objStream << boost::format("%1%/%2% ") % (fverts[vert] + 1) % (fverts[vert] + 1);
+    }
+    objStream << "\n";
+  }
+  return objStream.str();
+}
+
+// Obj text of the last level with tutorial::FormatBuffer, as WriteOBJ() is --
+// formatted on the given number of threads
+std::string FormatWithBuffer(OpenSubdiv::Far::TopologyLevel const& level, Vertex const* verts,
+  int numThreads)
+{
+  tutorial::FormatBuffer buffer;
+  tutorial::FormatInParallel(buffer, level.GetNumVertices(),
+    [&](tutorial::FormatBuffer& rangeBuffer, int begin, int end)
+  {
+    for (int vert = begin; vert < end; ++vert)
+    {
+      float const* pos = verts[vert]._position;
+      char* s = rangeBuffer.Reserve(3 * tutorial::kMaxNumberLength + 8);
+      *s++ = 'v';
+      for (int i = 0; i < 3; ++i)
+      {
+        *s++ = ' ';
+        s = tutorial::FormatGeneral(s, pos[i]);
+      }
+      *s++ = '\n';
+      rangeBuffer.Commit(s);
+    }
+  }, numThreads);
+  tutorial::FormatInParallel(buffer, level.GetNumFaces(),
+    [&](tutorial::FormatBuffer& rangeBuffer, int begin, int end)
+  {
+    for (int face = begin; face < end; ++face)
+    {
+      OpenSubdiv::Far::ConstIndexArray fverts = level.GetFaceVertices(face);
+      char* s = rangeBuffer.Reserve(fverts.size() * (2 * tutorial::kMaxNumberLength + 2) + 4);
+      *s++ = 'f';
+      *s++ = ' ';
+      for (int vert = 0; vert < fverts.size(); ++vert)
+      {
+        s = tutorial::FormatInt(s, fverts[vert] + 1);
+        *s++ = '/';
+        s = tutorial::FormatInt(s, fverts[vert] + 1);
+        *s++ = ' ';
+      }
+      *s++ = '\n';
+      rangeBuffer.Commit(s);
+    }
+  }, numThreads);
+  return std::string(buffer.GetText(), buffer.GetSize());
+}
+
+// Obj file of the last level written with tutorial::ObjWriter -- all vertices
+// and all faces (padded to the largest face size) each in a single call,
+// formatted on the given number of threads -- returning its text
+std::string WriteWithObjWriter(OpenSubdiv::Far::TopologyLevel const& level, Vertex const* verts,
+  int numThreads, std::string const& filename)
+{
+  std::vector<float> positions((size_t)level.GetNumVertices() * 3);
+  for (int vert = 0; vert < level.GetNumVertices(); ++vert)
+  {
+    std::memcpy(&positions[(size_t)vert * 3], verts[vert]._position, 3 * sizeof(float));
+  }
+
+  int faceSize = 0;
+  for (int face = 0; face < level.GetNumFaces(); ++face)
+  {
+    faceSize = std::max(faceSize, level.GetFaceVertices(face).size());
+  }
+  std::vector<int> faceVertices((size_t)level.GetNumFaces() * faceSize, -1);
+  for (int face = 0; face < level.GetNumFaces(); ++face)
+  {
+    OpenSubdiv::Far::ConstIndexArray fverts = level.GetFaceVertices(face);
+    std::copy(fverts.begin(), fverts.end(), &faceVertices[(size_t)face * faceSize]);
+  }
+
+  {
+    tutorial::ObjWriter writer(filename);
+    writer.SetNumThreads(numThreads);
+    writer.WriteVertexPositions(positions);
+    writer.WriteFaces(faceVertices, faceSize);
+    if (!writer.Close())
+    {
+      return std::string();
+    }
+  }
+
+  std::ifstream objstream(filename.c_str(), std::ios::binary);
+  std::stringstream text;
+  text << objstream.rdbuf();
+  return text.str();
+}
+
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+
+  if ((argc < 2) || (argc > 4))
+  {
+    std::cerr << "Usage: app <obj> [<level> [<repeats>]]\n";
+    return EXIT_FAILURE;
+  }
+  int maxlevel = (argc > 2) ? atoi(argv[2]) : 4;
+  int repeats = (argc > 3) ? std::max(1, atoi(argv[3])) : 5;
+
+  std::ifstream objstream(argv[1]);
+  std::stringstream objbuffer;
+  objbuffer << objstream.rdbuf();
+
+  Shape* shape = Shape::parseObj(objbuffer.str().c_str(), Scheme::kCatmark);
+  if (!shape)
+  {
+    std::cerr << "Error: cannot read Obj file '" << argv[1] << "'\n";
+    return EXIT_FAILURE;
+  }
+
+  typedef OpenSubdiv::Far::TopologyDescriptor Descriptor;
+
+  OpenSubdiv::Sdc::Options options;
+  options.SetVtxBoundaryInterpolation(OpenSubdiv::Sdc::Options::VTX_BOUNDARY_EDGE_ONLY);
+
+  Descriptor desc;
+  desc.numVertices = shape->GetNumVertices();
+  desc.numFaces = shape->GetNumFaces();
+  desc.numVertsPerFace = shape->nvertsPerFace.data();
+  desc.vertIndicesPerFace = shape->faceverts.data();
+
+  OpenSubdiv::Far::TopologyRefiner* refiner =
+    OpenSubdiv::Far::TopologyRefinerFactory<Descriptor>::Create(
+      desc, OpenSubdiv::Far::TopologyRefinerFactory<Descriptor>::Options(
+              OpenSubdiv::Sdc::SCHEME_CATMARK, options));
+  refiner->RefineUniform(OpenSubdiv::Far::TopologyRefiner::UniformOptions(maxlevel));
+
+  std::vector<Vertex> vbuffer(refiner->GetNumVerticesTotal());
+  Vertex* verts = &vbuffer[0];
+  for (int i = 0; i < desc.numVertices; ++i)
+  {
+    verts[i]._position[0] = shape->verts[i * 3];
+    verts[i]._position[1] = shape->verts[i * 3 + 1];
+    verts[i]._position[2] = shape->verts[i * 3 + 2];
+  }
+
+  OpenSubdiv::Far::PrimvarRefiner primvarRefiner(*refiner);
+  Vertex* srcVert = verts;
+  for (int level = 1; level <= maxlevel; ++level)
+  {
+    Vertex* dstVert = srcVert + refiner->GetLevel(level - 1).GetNumVertices();
+    primvarRefiner.Interpolate(level, srcVert, dstVert);
+    srcVert = dstVert;
+  }
+
+  OpenSubdiv::Far::TopologyLevel const& lastLevel = refiner->GetLevel(maxlevel);
+
+  // Best of the repeated timings of each (the ObjWriter timings include
+  // writing and reading back the file)
+  std::string objFile = std::string(argv[1]) + ".format_benchmark.obj";
+
+  typedef std::chrono::steady_clock Clock;
+  double seconds[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  std::string texts[5];
+  for (int i = 0; i < repeats; ++i)
+  {
+    for (int method = 0; method < 5; ++method)
+    {
+      Clock::time_point start = Clock::now();
+      if (method == 0)
+      {
+        texts[method] = FormatWithBoost(lastLevel, srcVert);
+      }
+      else if (method < 3)
+      {
+        texts[method] = FormatWithBuffer(lastLevel, srcVert, (method == 1) ? 1 : 0);
+      }
+      else
+      {
+        texts[method] = WriteWithObjWriter(lastLevel, srcVert, (method == 3) ? 1 : 0, objFile);
+      }
+      double s = std::chrono::duration<double>(Clock::now() - start).count();
+      seconds[method] = (i == 0) ? s : std::min(seconds[method], s);
+    }
+  }
+  std::remove(objFile.c_str());
+
+  bool identical = (texts[0] == texts[1]) && (texts[0] == texts[2]);
+  bool writerIdentical = !texts[3].empty() && (texts[3] == texts[4]);
+
+  printf("Level %d : %d vertices, %d faces, %zu bytes\n", maxlevel,
+         lastLevel.GetNumVertices(), lastLevel.GetNumFaces(), texts[0].size());
+  printf("  boost::format                       : %10.3f ms\n", seconds[0] * 1000.0);
+  printf("  tutorial::FormatBuffer              : %10.3f ms (%.1fx)\n", seconds[1] * 1000.0,
+         seconds[0] / seconds[1]);
+  printf("  tutorial::FormatInParallel (%2d thr) : %10.3f ms (%.1fx)\n",
+         tutorial::GetNumThreads(), seconds[2] * 1000.0, seconds[0] / seconds[2]);
+  printf("  Output %s\n", identical ? "identical" : "DIFFERS");
+  printf("  tutorial::ObjWriter         ( 1 thr) : %10.3f ms\n", seconds[3] * 1000.0);
+  printf("  tutorial::ObjWriter         (%2d thr) : %10.3f ms (%.1fx)\n",
+         tutorial::GetNumThreads(), seconds[4] * 1000.0, seconds[3] / seconds[4]);
+  printf("  ObjWriter output %s\n", writerIdentical ? "identical" : "DIFFERS");
+
+  delete refiner;
+  delete shape;
+  return (identical && writerIdentical) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -40,9 +40,12 @@
 #include <boost/format.hpp>
 
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <utils/fastFormat.h>
+#include <utils/parallelFormat.h>
 #include <utils/shape_utils.h>
 
 //------------------------------------------------------------------------------
@@ -118,7 +121,16 @@ void WriteOBJ(int maxlevel, int channelUV, const Vertex* verts, const FVarVertex
 
   std::ofstream objFile;
   objFile.open(objFilename);
-  objFile << boost::format("# maxlevel = %1%\n") % maxlevel;
+
+  // Lines are formatted directly into one buffer written as it fills (as
+  // "%1%" of boost::format, floats are written as "%g"), the many lines of
+  // vertices, uvs and faces in ranges on all threads and then in order
+  tutorial::FormatBuffer buffer(objFile);
+  char* s = buffer.Reserve(tutorial::kMaxNumberLength + 16);
+  std::memcpy(s, "# maxlevel = ", 13);
+  s = tutorial::FormatInt(s + 13, maxlevel);
+  *s++ = '\n';
+  buffer.Commit(s);
   OpenSubdiv::Far::TopologyLevel const& refLastLevel = refiner->GetLevel(maxlevel);
 
   int nverts = refLastLevel.GetNumVertices();
@@ -128,39 +140,71 @@ void WriteOBJ(int maxlevel, int channelUV, const Vertex* verts, const FVarVertex
   // Print vertex positions
   int firstOfLastVerts = refiner->GetNumVerticesTotal() - nverts;
 
-  for (int vert = 0; vert < nverts; ++vert)
+  tutorial::FormatInParallel(buffer, nverts, [&](tutorial::FormatBuffer& rangeBuffer, int begin, int end)
   {
-    float const* pos = verts[firstOfLastVerts + vert].GetPosition();
-    objFile << boost::format("v %1% %2% %3%\n") % pos[0] % pos[1] % pos[2];
-  }
+    for (int vert = begin; vert < end; ++vert)
+    {
+      float const* pos = verts[firstOfLastVerts + vert].GetPosition();
+      char* s = rangeBuffer.Reserve(3 * tutorial::kMaxNumberLength + 8);
+      *s++ = 'v';
+      for (int i = 0; i < 3; ++i)
+      {
+        *s++ = ' ';
+        s = tutorial::FormatGeneral(s, pos[i]);
+      }
+      *s++ = '\n';
+      rangeBuffer.Commit(s);
+    }
+  });
 
   // Print uvs
   int firstOfLastUvs = refiner->GetNumFVarValuesTotal(channelUV) - nuvs;
 
-  for (int fvvert = 0; fvvert < nuvs; ++fvvert)
+  tutorial::FormatInParallel(buffer, nuvs, [&](tutorial::FormatBuffer& rangeBuffer, int begin, int end)
   {
-    FVarVertexUV const& uv = fvVertsUV[firstOfLastUvs + fvvert];
-    objFile << boost::format("vt %1% %2%\n") % uv.u % uv.v;
-  }
+    for (int fvvert = begin; fvvert < end; ++fvvert)
+    {
+      FVarVertexUV const& uv = fvVertsUV[firstOfLastUvs + fvvert];
+      char* s = rangeBuffer.Reserve(2 * tutorial::kMaxNumberLength + 8);
+      *s++ = 'v';
+      *s++ = 't';
+      *s++ = ' ';
+      s = tutorial::FormatGeneral(s, uv.u);
+      *s++ = ' ';
+      s = tutorial::FormatGeneral(s, uv.v);
+      *s++ = '\n';
+      rangeBuffer.Commit(s);
+    }
+  });
 
   // Print faces
-  for (int face = 0; face < nfaces; ++face)
+  tutorial::FormatInParallel(buffer, nfaces, [&](tutorial::FormatBuffer& rangeBuffer, int begin, int end)
   {
-
-    OpenSubdiv::Far::ConstIndexArray fverts = refLastLevel.GetFaceVertices(face);
-    OpenSubdiv::Far::ConstIndexArray fuvs = refLastLevel.GetFaceFVarValues(face, channelUV);
-
-    // all refined Catmark faces should be quads
-    assert(fverts.size() == 4 && fuvs.size() == 4);
-
-    objFile << "f ";
-    for (int vert = 0; vert < fverts.size(); ++vert)
+    for (int face = begin; face < end; ++face)
     {
-      // OBJ uses 1-based arrays...
-      objFile << boost::format("%1%/%2% ") % (fverts[vert] + 1) % (fuvs[vert] + 1);
+
+      OpenSubdiv::Far::ConstIndexArray fverts = refLastLevel.GetFaceVertices(face);
+      OpenSubdiv::Far::ConstIndexArray fuvs = refLastLevel.GetFaceFVarValues(face, channelUV);
+
+      // all refined Catmark faces should be quads
+      assert(fverts.size() == 4 && fuvs.size() == 4);
+
+      char* s = rangeBuffer.Reserve(fverts.size() * (2 * tutorial::kMaxNumberLength + 2) + 4);
+      *s++ = 'f';
+      *s++ = ' ';
+      for (int vert = 0; vert < fverts.size(); ++vert)
+      {
+        // OBJ uses 1-based arrays...
+        s = tutorial::FormatInt(s, fverts[vert] + 1);
+        *s++ = '/';
+        s = tutorial::FormatInt(s, fuvs[vert] + 1);
+        *s++ = ' ';
+      }
+      *s++ = '\n';
+      rangeBuffer.Commit(s);
     }
-    objFile << "\n";
-  }
+  });
+  buffer.Flush();
   objFile.close();
 }
 
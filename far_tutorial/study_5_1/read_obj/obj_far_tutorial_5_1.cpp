@@ -44,26 +44,43 @@
 #include <opensubdiv/far/primvarRefiner.h>
 #include <opensubdiv/far/ptexIndices.h>
 #include <opensubdiv/far/topologyDescriptor.h>
+#include <opensubdiv/osd/cpuEvaluator.h>
+#include <opensubdiv/osd/cpuPatchTable.h>
+#include <opensubdiv/osd/cpuVertexBuffer.h>
+#ifdef OPENSUBDIV_HAS_OPENMP
+#include <opensubdiv/osd/ompEvaluator.h>
+#endif
+#ifdef OPENSUBDIV_HAS_TBB
+#include <opensubdiv/osd/tbbEvaluator.h>
+#endif
 
 #include <vtkNew.h>
 #include <vtkFloatArray.h>
 #include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
 #include <vtkStructuredPoints.h>
 #include <vtkUnstructuredGrid.h>
 #include <vtkXMLUnstructuredGridWriter.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
 
 #include <boost/format.hpp>
 
-#include <Imath/ImathVec.h>
-
+#include <utils/fastFormat.h>
+#include <utils/patchLocator.h>
+#include <utils/patchPointStencils.h>
 #include <utils/shape_utils.h>
+#include <utils/vertexNormals.h>
 
 using namespace OpenSubdiv;
 
@@ -72,6 +89,78 @@ typedef float Real; // Change from default double to match intended Shapes data
 // Creates a Far::TopologyRefiner from the pyramid shape above
 static Far::TopologyRefiner* createTopologyRefiner(const Shape* shape);
 
+//------------------------------------------------------------------------------
+// Command line arguments : <level> <obj> followed by options
+//
+class Args
+{
+public:
+  int maxPatchLevel;
+  std::string inputObjFile;
+  bool useLocator;       // locate patches with tutorial::PatchLocator
+  bool validateLocator;  // compare tutorial::PatchLocator with Far::PatchMap
+  std::string osdBackend; // evaluate with Osd::<backend>Evaluator::EvalPatches
+  bool useStencils;       // compute patch points with tutorial::PatchPointStencils
+  std::string vtuCompressor; // compress the VTU data with zlib or lz4 (none by default)
+
+public:
+  Args(int argc, char** argv)
+    : maxPatchLevel(0)
+    , useLocator(false)
+    , validateLocator(false)
+    , useStencils(false)
+  {
+    if (argc >= 3)
+    {
+      maxPatchLevel = atoi(argv[1]);
+      inputObjFile = argv[2];
+    }
+    for (int i = 3; i < argc; ++i)
+    {
+      if (!strcmp(argv[i], "-locator"))
+      {
+        useLocator = true;
+      }
+      else if (!strcmp(argv[i], "-validate"))
+      {
+        validateLocator = true;
+      }
+      else if (!strcmp(argv[i], "-stencils"))
+      {
+        useStencils = true;
+      }
+      else if (!strcmp(argv[i], "-osd"))
+      {
+        if (++i < argc)
+          osdBackend = argv[i];
+      }
+      else if (!strcmp(argv[i], "-vtucompress"))
+      {
+        if (++i < argc)
+          vtuCompressor = argv[i];
+        if ((vtuCompressor != "zlib") && (vtuCompressor != "lz4"))
+        {
+          std::cerr << "Warning: Unrecognized VTU compressor '" << vtuCompressor
+                    << "' ignored\n";
+          vtuCompressor.clear();
+        }
+      }
+      else
+      {
+        std::cerr << "Warning: Unrecognized argument '" << argv[i] << "' ignored\n";
+      }
+    }
+  }
+
+  bool IsValid() const { return !inputObjFile.empty(); }
+
+  static void PrintUsage()
+  {
+    std::cerr << "Usage: app <level> <obj> [-locator] [-validate] [-stencils] [-osd cpu|omp|tbb]"
+                 " [-vtucompress zlib|lz4]\n";
+  }
+};
+
 //------------------------------------------------------------------------------
 // Vertex container implementation.
 //
@@ -126,7 +215,8 @@ struct LimitFrame
   Real point[3], deriv1[3], deriv2[3];
 };
 
-void VisualizationViaOBJ(const std::vector<LimitFrame>& samples, std::ostream& os)
+void VisualizationViaOBJ(const std::vector<LimitFrame>& samples, const std::vector<float>& normals,
+  std::ostream& os)
 { // Visualization with Maya : print a MEL script that generates particles
   // at the location of the limit vertices
 
@@ -137,88 +227,248 @@ void VisualizationViaOBJ(const std::vector<LimitFrame>& samples, std::ostream& o
   // Output particle positions for the tangent
   os << "# particle -n deriv1 ";
   os << boost::format("# Number of particles %d\n") % nsamples;
+
+  // The many lines of samples are formatted directly into one buffer
+  // written to the stream as it fills
+  tutorial::FormatBuffer buffer(os);
   for (int sample = 0; sample < nsamples; ++sample)
   {
     Real const* pos = samples[sample].point;
-    os << boost::format("v %f %f %f\n") % pos[0] % pos[1] % pos[2];
+    char* s = buffer.Reserve(3 * tutorial::kMaxNumberLength + 8);
+    *s++ = 'v';
+    for (int i = 0; i < 3; ++i)
+    {
+      *s++ = ' ';
+      s = tutorial::FormatFixed(s, pos[i]);
+    }
+    *s++ = '\n';
+    buffer.Commit(s);
   }
 
   for (int sample = 0; sample < nsamples; ++sample)
   {
-    Real const* tan1 = samples[sample].deriv1;
-    Real const* tan2 = samples[sample].deriv2;
-    Imath::Vec3<Real> _tan1(tan1[0], tan1[1], tan1[2]);
-    Imath::Vec3<Real> _tan2(tan2[0], tan2[1], tan2[2]);
-    Imath::Vec3<Real> vn = _tan1.cross(_tan2);
-    vn.normalize();
-    os << boost::format("vn %f %f %f\n") % vn[0] % vn[1] % vn[2];
+    float const* vn = &normals[3 * (size_t)sample];
+    char* s = buffer.Reserve(3 * tutorial::kMaxNumberLength + 8);
+    *s++ = 'v';
+    *s++ = 'n';
+    for (int i = 0; i < 3; ++i)
+    {
+      *s++ = ' ';
+      s = tutorial::FormatFixed(s, vn[i]);
+    }
+    *s++ = '\n';
+    buffer.Commit(s);
   }
 }
 
-void VisualizationViaVTU(const std::vector<LimitFrame>& samples, const std::string& vtuFilename)
+// A vtkFloatArray of 3-tuples using the given array without copying it (the
+// array must outlive any use of the vtkFloatArray)
+static vtkSmartPointer<vtkFloatArray> WrapFloatArray(std::vector<float>& values, const char* name)
 {
-  vtkSmartPointer<vtkPoints> points =
-    vtkSmartPointer<vtkPoints>::New();
-
-  vtkNew<vtkFloatArray> normals;
-  normals->SetName("Normals");
-  normals->SetNumberOfComponents(3);
-
-  vtkNew<vtkFloatArray> deriv1;
-  deriv1->SetName("Derivative1");
-  deriv1->SetNumberOfComponents(3);
-
-  vtkNew<vtkFloatArray> deriv2;
-  deriv2->SetName("Derivative2");
-  deriv2->SetNumberOfComponents(3);
+  vtkSmartPointer<vtkFloatArray> array = vtkSmartPointer<vtkFloatArray>::New();
+  if (name)
+  {
+    array->SetName(name);
+  }
+  array->SetNumberOfComponents(3);
+  array->SetArray(values.data(), (vtkIdType)values.size(), 1 /* save: not deleted by VTK */);
+  return array;
+}
 
+// The points and their data are copied once into contiguous arrays given to
+// VTK as they are (no InsertNext*() per sample) -- as are the normals, not
+// copied -- and written as raw appended binary data, compressed with "zlib"
+// or "lz4" if given
+void VisualizationViaVTU(const std::vector<LimitFrame>& samples, std::vector<float>& normals,
+  const std::string& vtuFilename, const std::string& compressor)
+{
   int nsamples = (int)samples.size();
 
+  std::vector<float> positions(3 * (size_t)nsamples);
+  std::vector<float> deriv1(3 * (size_t)nsamples);
+  std::vector<float> deriv2(3 * (size_t)nsamples);
+
   for (int sample = 0; sample < nsamples; ++sample)
   {
-    Real const* pos = samples[sample].point;
-    points->InsertNextPoint ( pos[0], pos[1], pos[2] );
-
-    Real const* tan1 = samples[sample].deriv1;
-    Imath::Vec3<Real> _tan1(tan1[0], tan1[1], tan1[2]);
-    _tan1.normalize();
-    deriv1->InsertNextTuple3(tan1[0], tan1[1], tan1[2]);
-
-    Real const* tan2 = samples[sample].deriv2;
-    Imath::Vec3<Real> _tan2(tan2[0], tan2[1], tan2[2]);
-    _tan2.normalize();
-    deriv2->InsertNextTuple3(tan2[0], tan2[1], tan2[2]);
-
-    Imath::Vec3<Real> normal = _tan1.cross(_tan2).normalize();
-    std::cout << normal << "\n";
-    normals->InsertNextTuple3(normal.x,normal.y,normal.z);
+    LimitFrame const& frame = samples[sample];
+    std::copy(frame.point, frame.point + 3, &positions[3 * (size_t)sample]);
+    std::copy(frame.deriv1, frame.deriv1 + 3, &deriv1[3 * (size_t)sample]);
+    std::copy(frame.deriv2, frame.deriv2 + 3, &deriv2[3 * (size_t)sample]);
   }
 
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData(WrapFloatArray(positions, 0));
+
   vtkNew<vtkUnstructuredGrid> ug;
 
   ug->SetPoints(points);
 
-  ug->GetPointData()->SetNormals(normals);
-  ug->GetPointData()->AddArray(deriv1);
-  ug->GetPointData()->AddArray(deriv2);
+  ug->GetPointData()->SetNormals(WrapFloatArray(normals, "Normals"));
+  ug->GetPointData()->AddArray(WrapFloatArray(deriv1, "Derivative1"));
+  ug->GetPointData()->AddArray(WrapFloatArray(deriv2, "Derivative2"));
 
   vtkNew<vtkXMLUnstructuredGridWriter> writer;
   writer->SetFileName(vtuFilename.c_str());
   writer->SetInputData(ug);
+  writer->SetDataModeToAppended();
+  writer->EncodeAppendedDataOff();
+  writer->SetHeaderTypeToUInt64();
+  if (compressor == "zlib")
+  {
+    writer->SetCompressorTypeToZLib();
+  }
+  else if (compressor == "lz4")
+  {
+    writer->SetCompressorTypeToLZ4();
+  }
+  else
+  {
+    writer->SetCompressorTypeToNone();
+  }
   writer->Write();
 }
 
+//------------------------------------------------------------------------------
+// Osd evaluation of the samples -- the vertex buffer holds the refined and
+// local points, and the derivatives are evaluated along with the positions.
+//
+template <class EVALUATOR>
+static void EvalPatchesOsd(Osd::CpuVertexBuffer* srcBuffer, Osd::CpuPatchTable const* osdPatchTable,
+  std::vector<Osd::PatchCoord> const& patchCoords, Osd::CpuVertexBuffer* dstBuffer,
+  Osd::CpuVertexBuffer* duBuffer, Osd::CpuVertexBuffer* dvBuffer)
+{
+  Osd::BufferDescriptor desc(0, 3, 3);
+
+  EVALUATOR::EvalPatches(srcBuffer->BindCpuBuffer(), desc, dstBuffer->BindCpuBuffer(), desc,
+    duBuffer->BindCpuBuffer(), desc, dvBuffer->BindCpuBuffer(), desc, (int)patchCoords.size(),
+    patchCoords.data(), osdPatchTable->GetPatchArrayBuffer(),
+    osdPatchTable->GetPatchIndexBuffer(), osdPatchTable->GetPatchParamBuffer());
+}
+
+// Evaluates the samples with the given backend ("cpu", "omp" or "tbb"),
+// reports its throughput next to that of the Far evaluation and replaces
+// the samples with its results.  Returns false if the backend is missing.
+static bool EvaluateWithOsd(std::string const& backend, Far::PatchTable const& patchTable,
+  std::vector<Vertex> const& verts, std::vector<Real> const& sampleS,
+  std::vector<Real> const& sampleT,
+  std::vector<Far::PatchTable::PatchHandle const*> const& sampleHandles, double farSeconds,
+  std::vector<LimitFrame>& samples)
+{
+  typedef void (*EvalFunction)(Osd::CpuVertexBuffer*, Osd::CpuPatchTable const*,
+    std::vector<Osd::PatchCoord> const&, Osd::CpuVertexBuffer*, Osd::CpuVertexBuffer*,
+    Osd::CpuVertexBuffer*);
+
+  EvalFunction evalPatches = 0;
+  if (backend == "cpu")
+  {
+    evalPatches = EvalPatchesOsd<Osd::CpuEvaluator>;
+  }
+#ifdef OPENSUBDIV_HAS_OPENMP
+  else if (backend == "omp")
+  {
+    evalPatches = EvalPatchesOsd<Osd::OmpEvaluator>;
+  }
+#endif
+#ifdef OPENSUBDIV_HAS_TBB
+  else if (backend == "tbb")
+  {
+    evalPatches = EvalPatchesOsd<Osd::TbbEvaluator>;
+  }
+#endif
+  if (!evalPatches)
+  {
+    return false;
+  }
+
+  int nverts = (int)verts.size();
+  int nsamples = (int)samples.size();
+
+  // Set up the Osd patch table, vertex buffers and patch coordinates
+  std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now();
+
+  Osd::CpuPatchTable* osdPatchTable = Osd::CpuPatchTable::Create(&patchTable);
+
+  Osd::CpuVertexBuffer* srcBuffer = Osd::CpuVertexBuffer::Create(3, nverts);
+  srcBuffer->UpdateData(&verts[0].point[0], 0, nverts);
+
+  Osd::CpuVertexBuffer* dstBuffer = Osd::CpuVertexBuffer::Create(3, nsamples);
+  Osd::CpuVertexBuffer* duBuffer = Osd::CpuVertexBuffer::Create(3, nsamples);
+  Osd::CpuVertexBuffer* dvBuffer = Osd::CpuVertexBuffer::Create(3, nsamples);
+
+  std::vector<Osd::PatchCoord> patchCoords(nsamples);
+  for (int sample = 0; sample < nsamples; ++sample)
+  {
+    patchCoords[sample] =
+      Osd::PatchCoord(*sampleHandles[sample], (float)sampleS[sample], (float)sampleT[sample]);
+  }
+
+  double setupSeconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - setupStart).count();
+
+  std::chrono::steady_clock::time_point evalStart = std::chrono::steady_clock::now();
+
+  evalPatches(srcBuffer, osdPatchTable, patchCoords, dstBuffer, duBuffer, dvBuffer);
+
+  double osdSeconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - evalStart).count();
+
+  // Compare with the Far results before replacing them
+  float const* P = dstBuffer->BindCpuBuffer();
+  float const* dPds = duBuffer->BindCpuBuffer();
+  float const* dPdt = dvBuffer->BindCpuBuffer();
+
+  double maxDiff = 0.0;
+  for (int sample = 0; sample < nsamples; ++sample)
+  {
+    LimitFrame& dst = samples[sample];
+    for (int k = 0; k < 3; ++k)
+    {
+      int i = sample * 3 + k;
+      maxDiff = std::max(maxDiff, (double)std::fabs(dst.point[k] - P[i]));
+      maxDiff = std::max(maxDiff, (double)std::fabs(dst.deriv1[k] - dPds[i]));
+      maxDiff = std::max(maxDiff, (double)std::fabs(dst.deriv2[k] - dPdt[i]));
+
+      dst.point[k] = P[i];
+      dst.deriv1[k] = dPds[i];
+      dst.deriv2[k] = dPdt[i];
+    }
+  }
+
+  std::cerr << boost::format("%d samples\n") % nsamples;
+  std::cerr << boost::format("  Far::PatchTable::EvaluateBasis : %10.3f ms %10.3f Msamples/s\n") %
+      (farSeconds * 1000.0) % (nsamples / farSeconds * 1.0e-6);
+  std::cerr << boost::format("  Osd::EvalPatches (%s)%*s : %10.3f ms %10.3f Msamples/s\n") %
+      backend % (10 - (int)backend.size()) % "" % (osdSeconds * 1000.0) %
+      (nsamples / osdSeconds * 1.0e-6);
+  std::cerr << boost::format("  Osd setup %.3f ms, max difference %g\n") % (setupSeconds * 1000.0) %
+      maxDiff;
+
+  delete osdPatchTable;
+  delete srcBuffer;
+  delete dstBuffer;
+  delete duBuffer;
+  delete dvBuffer;
+  return true;
+}
+
 //------------------------------------------------------------------------------
 int main(int argc, char** argv)
 {
 
-  if (argc != 3)
+  Args args(argc, argv);
+  if (!args.IsValid())
   {
-    std::cerr << "Usage: app <level> <obj>\n";
+    Args::PrintUsage();
     return EXIT_FAILURE;
   }
-  int maxPatchLevel = atoi(argv[1]);
-  std::ifstream objstream(argv[2]);
+  int maxPatchLevel = args.maxPatchLevel;
+
+  // Optionally locate patches with the flat tutorial::PatchLocator instead
+  // of the Far::PatchMap, and/or validate its results against the PatchMap
+  bool useLocator = args.useLocator;
+  bool validateLocator = args.validateLocator;
+
+  std::ifstream objstream(args.inputObjFile);
   std::stringstream objbuffer;
   objbuffer << objstream.rdbuf();
 
@@ -278,80 +528,211 @@ int main(int argc, char** argv)
   int nRefinerVertices = refiner->GetNumVerticesTotal();
   int nLocalPoints = patchTable->GetNumLocalPoints();
 
+  // The Osd evaluators index the refined vertices of the PatchTable
+  bool useStencils = args.useStencils;
+  if (useStencils && !args.osdBackend.empty())
+  {
+    std::cerr << "Warning: -stencils ignored with -osd\n";
+    useStencils = false;
+  }
+
   // Create a buffer to hold the position of the refined verts and
   // local points, then copy the coarse positions at the beginning.
-  std::vector<Vertex> verts(nRefinerVertices + nLocalPoints);
-  std::memcpy(&verts[0], shape->verts.data(), shape->GetNumVertices() * 3 * sizeof(Real));
+  // Only the coarse positions are needed when the patch points are
+  // computed from them directly.
+  int nCoarseVertices = shape->GetNumVertices();
+
+  std::vector<Vertex> verts(useStencils ? nCoarseVertices : (nRefinerVertices + nLocalPoints));
+  std::memcpy(&verts[0], shape->verts.data(), nCoarseVertices * 3 * sizeof(Real));
 
-  // Adaptive refinement may result in fewer levels than the max specified.
-  int nRefinedLevels = refiner->GetNumLevels();
+  // Points referenced by the patches and the buffer indexed by them
+  tutorial::PatchPointStencils<Real>* patchPoints = 0;
+  std::vector<Vertex> points;
 
-  // Interpolate vertex primvar data : they are the control vertices
-  // of the limit patches (see tutorial_1_1 for details)
-  Far::PrimvarRefinerReal<Real> primvarRefiner(*refiner);
+  std::chrono::steady_clock::time_point pointsStart = std::chrono::steady_clock::now();
 
-  Vertex* src = &verts[0];
-  for (int level = 1; level < nRefinedLevels; ++level)
+  if (useStencils)
   {
-    Vertex* dst = src + refiner->GetLevel(level - 1).GetNumVertices();
-    primvarRefiner.Interpolate(level, src, dst);
-    src = dst;
-  }
+    patchPoints = new tutorial::PatchPointStencils<Real>(*refiner, *patchTable);
+
+    pointsStart = std::chrono::steady_clock::now();
 
-  // Evaluate local points from interpolated vertex primvars.
-  if (nLocalPoints)
+    // Single pass from the coarse vertices to all patch points
+    points.resize(patchPoints->GetNumPoints());
+    patchPoints->Update(&verts[0], &points[0]);
+  }
+  else
   {
-    patchTable->GetLocalPointStencilTable<Real>()->UpdateValues(
-      &verts[0], &verts[nRefinerVertices]);
+    // Adaptive refinement may result in fewer levels than the max specified.
+    int nRefinedLevels = refiner->GetNumLevels();
+
+    // Interpolate vertex primvar data : they are the control vertices
+    // of the limit patches (see tutorial_1_1 for details)
+    Far::PrimvarRefinerReal<Real> primvarRefiner(*refiner);
+
+    Vertex* src = &verts[0];
+    for (int level = 1; level < nRefinedLevels; ++level)
+    {
+      Vertex* dst = src + refiner->GetLevel(level - 1).GetNumVertices();
+      primvarRefiner.Interpolate(level, src, dst);
+      src = dst;
+    }
+
+    // Evaluate local points from interpolated vertex primvars.
+    if (nLocalPoints)
+    {
+      patchTable->GetLocalPointStencilTable<Real>()->UpdateValues(
+        &verts[0], &verts[nRefinerVertices]);
+    }
   }
 
+  double pointsSeconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - pointsStart).count();
+
+  std::cerr << boost::format("Patch points (%s) : %d computed in %.3f ms\n") %
+      (useStencils ? "PatchPointStencils" : "PrimvarRefiner") %
+      (useStencils ? patchPoints->GetNumPoints() : (nRefinerVertices + nLocalPoints)) %
+      (pointsSeconds * 1000.0);
+
+  // The control points of the patches are either the refined vertices and
+  // local points or the compact patch points
+  Vertex const* patchVerts = useStencils ? &points[0] : &verts[0];
+
   // Create a Far::PatchMap to help locating patches in the table
   Far::PatchMap patchmap(*patchTable);
 
+  // The flat alternative to the PatchMap (quad-based patches only)
+  tutorial::PatchLocator locator(*patchTable);
+  if ((useLocator || validateLocator) && !locator.IsValid())
+  {
+    std::cerr << "Warning: PatchLocator does not support this PatchTable\n";
+    useLocator = validateLocator = false;
+  }
+
   // Create a Far::PtexIndices to help find indices of ptex faces.
   Far::PtexIndices ptexIndices(*refiner);
 
   // Generate random samples on each ptex face
   int nsamplesPerFace = 200, nfaces = ptexIndices.GetNumFaces();
 
-  std::vector<LimitFrame> samples(nsamplesPerFace * nfaces);
+  int nsamples = nsamplesPerFace * nfaces;
+
+  std::vector<LimitFrame> samples(nsamples);
 
   srand(static_cast<int>(2147483647));
 
-  Real pWeights[20], dsWeights[20], dtWeights[20];
+  // Generate the random (s,t) of all samples and locate their patches
+  std::vector<Real> sampleS(nsamples), sampleT(nsamples);
+  std::vector<Far::PatchTable::PatchHandle const*> sampleHandles(nsamples);
 
-  for (int face = 0, count = 0; face < nfaces; ++face)
+  int nmismatches = 0;
+
+  for (int face = 0; face < nfaces; ++face)
   {
+    Real* faceS = &sampleS[face * nsamplesPerFace];
+    Real* faceT = &sampleT[face * nsamplesPerFace];
+    Far::PatchTable::PatchHandle const** faceHandles = &sampleHandles[face * nsamplesPerFace];
 
-    for (int sample = 0; sample < nsamplesPerFace; ++sample, ++count)
+    for (int sample = 0; sample < nsamplesPerFace; ++sample)
     {
+      faceS[sample] = (Real)rand() / (Real)RAND_MAX;
+      faceT[sample] = (Real)rand() / (Real)RAND_MAX;
+    }
 
-      Real s = (Real)rand() / (Real)RAND_MAX, t = (Real)rand() / (Real)RAND_MAX;
-
-      // Locate the patch corresponding to the face ptex idx and (s,t)
-      Far::PatchTable::PatchHandle const* handle = patchmap.FindPatch(face, s, t);
-      assert(handle);
-
-      // Evaluate the patch weights, identify the CVs and compute the limit frame:
-      patchTable->EvaluateBasis(*handle, s, t, pWeights, dsWeights, dtWeights);
+    // Locate the patches corresponding to the face ptex idx and (s,t)
+    if (useLocator)
+    {
+      locator.FindPatches(face, nsamplesPerFace, faceS, faceT, faceHandles);
+    }
+    else
+    {
+      for (int sample = 0; sample < nsamplesPerFace; ++sample)
+      {
+        faceHandles[sample] = patchmap.FindPatch(face, faceS[sample], faceT[sample]);
+      }
+    }
 
-      Far::ConstIndexArray cvs = patchTable->GetPatchVertices(*handle);
+    if (validateLocator)
+    {
+      std::vector<Far::PatchTable::PatchHandle const*> batchHandles(nsamplesPerFace);
+      locator.FindPatches(face, nsamplesPerFace, faceS, faceT, batchHandles.data());
 
-      LimitFrame& dst = samples[count];
-      dst.Clear();
-      for (int cv = 0; cv < cvs.size(); ++cv)
+      for (int sample = 0; sample < nsamplesPerFace; ++sample)
       {
-        dst.AddWithWeight(verts[cvs[cv]], pWeights[cv], dsWeights[cv], dtWeights[cv]);
+        Far::PatchTable::PatchHandle const* expected =
+          patchmap.FindPatch(face, faceS[sample], faceT[sample]);
+        Far::PatchTable::PatchHandle const* found =
+          locator.FindPatch(face, faceS[sample], faceT[sample]);
+
+        if (!expected || !found || !batchHandles[sample] ||
+          (found->patchIndex != expected->patchIndex) ||
+          (batchHandles[sample]->patchIndex != expected->patchIndex))
+        {
+          ++nmismatches;
+        }
       }
     }
   }
 
+  // Evaluate the patch weights, identify the CVs and compute the limit frames:
+  Real pWeights[20], dsWeights[20], dtWeights[20];
+
+  std::chrono::steady_clock::time_point farStart = std::chrono::steady_clock::now();
+
+  for (int sample = 0; sample < nsamples; ++sample)
+  {
+    Far::PatchTable::PatchHandle const* handle = sampleHandles[sample];
+    assert(handle);
+
+    patchTable->EvaluateBasis(
+      *handle, sampleS[sample], sampleT[sample], pWeights, dsWeights, dtWeights);
+
+    Far::ConstIndexArray cvs = patchPoints ? patchPoints->GetPatchPoints(*handle)
+                                           : patchTable->GetPatchVertices(*handle);
+
+    LimitFrame& dst = samples[sample];
+    dst.Clear();
+    for (int cv = 0; cv < cvs.size(); ++cv)
+    {
+      dst.AddWithWeight(patchVerts[cvs[cv]], pWeights[cv], dsWeights[cv], dtWeights[cv]);
+    }
+  }
+
+  double farSeconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - farStart).count();
+
+  // Evaluate the same samples with Osd and compare
+  if (!args.osdBackend.empty())
+  {
+    if (!EvaluateWithOsd(args.osdBackend, *patchTable, verts, sampleS, sampleT, sampleHandles,
+          farSeconds, samples))
+    {
+      std::cerr << "Warning: Osd backend '" << args.osdBackend << "' is not available\n";
+    }
+  }
+
+  if (validateLocator)
+  {
+    std::cerr << "PatchLocator: " << (nsamplesPerFace * nfaces) << " samples validated against "
+              << "Far::PatchMap, " << nmismatches << " mismatches\n";
+  }
+
+  // Normals of the samples, computed once in a batch for both visualizations
+  // (from the derivatives interleaved in the LimitFrames)
+  std::vector<float> normals(3 * (size_t)nsamples);
+  if (nsamples > 0)
+  {
+    tutorial::ComputeVertexNormals(nsamples, samples[0].deriv1, samples[0].deriv2, normals.data(),
+      (int)(sizeof(LimitFrame) / sizeof(float)));
+  }
+
   std::ofstream output_stream("particles.obj");
-  VisualizationViaOBJ(samples,output_stream);
+  VisualizationViaOBJ(samples, normals, output_stream);
   output_stream.close();
 
-  VisualizationViaVTU(samples, "particles.vtu");
+  VisualizationViaVTU(samples, normals, "particles.vtu", args.vtuCompressor);
 
+  delete patchPoints;
   delete refiner;
   delete patchTable;
   return EXIT_SUCCESS;
@@ -34,21 +34,51 @@
 //      with the vertex positions and normals (previously illustrated) as
 //      part of the tessellation written to the Obj file.
 //
+//      With "-threads N" (0 for all hardware threads) faces are tessellated
+//      in parallel by workers sharing a single SurfaceFactory with a
+//      thread-safe cache.  The Obj file written is identical to that of a
+//      serial run.
+//
+//      With "-frames N" a simple animation of the mesh is tessellated, one
+//      Obj file per frame, with a tutorial::SurfaceCache that persists
+//      across frames (bounded to "-cache N" entries when specified) so
+//      that irregular patches are only constructed for the first frame.
+//
 
 #include <opensubdiv/far/topologyRefiner.h>
 #include <opensubdiv/bfr/refinerSurfaceFactory.h>
 #include <opensubdiv/bfr/surface.h>
 #include <opensubdiv/bfr/tessellation.h>
+#include <opensubdiv/bfr/surfaceFactoryCache.h>
 
 #include <vector>
 #include <string>
 #include <cstring>
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <cmath>
 
 //  Local headers with support for this tutorial in "namespace tutorial"
+#include <utils/bsplinePatch.h>
+#include <utils/linearPatch.h>
 #include <utils/meshLoader.h>
-#include <utils/objWriter.h>
+#include <utils/meshWriter.h>
+#include <utils/orderedRing.h>
+#include <utils/gridStencilCache.h>
+#include <utils/faceStencilTable.h>
+#include <utils/faceGridWriter.h>
+#include <utils/parallel.h>
+#include <utils/quantization.h>
+#include <utils/surfaceCache.h>
+#include <utils/tessellationPatternCache.h>
+#include <utils/vertexNormals.h>
 
 using namespace OpenSubdiv;
 
@@ -63,6 +93,23 @@ public:
     int             tessUniformRate;
     bool            tessQuadsFlag;
     bool            uv2xyzFlag;
+    int             gridResolution;
+    bool            gridCacheFlag;
+    int             numThreads;
+    int             numFrames;
+    int             cacheEntries;
+    bool            stencilTableFlag;
+    std::string     stencilTableFile;
+    bool            gridNormalsFlag;
+
+    //  Output of the grid points of all faces:
+    tutorial::FaceGridWriter::Format gridOutputFormat;
+    std::string     gridOutputFile;
+    bool            gridWriterThreadFlag;
+
+    bool            shortestFloatsFlag;
+    bool            quantizeFlag;
+    bool            vertexCacheFlag;
 
 public:
     Args(int argc, char * argv[]) :
@@ -71,7 +118,21 @@ public:
         schemeType(Sdc::SCHEME_CATMARK),
         tessUniformRate(5),
         tessQuadsFlag(false),
-        uv2xyzFlag(false) {
+        uv2xyzFlag(false),
+        gridResolution(16),
+        gridCacheFlag(false),
+        numThreads(1),
+        numFrames(1),
+        cacheEntries(0),
+        stencilTableFlag(false),
+        stencilTableFile(),
+        gridNormalsFlag(false),
+        gridOutputFormat(tutorial::FaceGridWriter::FORMAT_OBJ_PER_FACE),
+        gridOutputFile(),
+        gridWriterThreadFlag(false),
+        shortestFloatsFlag(false),
+        quantizeFlag(false),
+        vertexCacheFlag(false) {
 
         for (int i = 1; i < argc; ++i) {
             if (strstr(argv[i], ".obj")) {
@@ -95,6 +156,48 @@ public:
                 tessQuadsFlag = true;
             } else if (!strcmp(argv[i], "-uv2xyz")) {
                 uv2xyzFlag = true;
+            } else if (!strcmp(argv[i], "-gridres")) {
+                if (++i < argc) gridResolution = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-gridcache")) {
+                gridCacheFlag = true;
+            } else if (!strcmp(argv[i], "-threads")) {
+                if (++i < argc) numThreads = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-frames")) {
+                if (++i < argc) numFrames = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-cache")) {
+                if (++i < argc) cacheEntries = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-stencils")) {
+                stencilTableFlag = true;
+            } else if (!strcmp(argv[i], "-stencilfile")) {
+                if (++i < argc) stencilTableFile = std::string(argv[i]);
+                stencilTableFlag = true;
+            } else if (!strcmp(argv[i], "-gridnormals")) {
+                gridNormalsFlag  = true;
+                stencilTableFlag = true;
+            } else if (!strcmp(argv[i], "-gridout")) {
+                if (++i < argc) {
+                    if (!strcmp(argv[i], "obj")) {
+                        gridOutputFormat = tutorial::FaceGridWriter::FORMAT_OBJ;
+                    } else if (!strcmp(argv[i], "bin")) {
+                        gridOutputFormat = tutorial::FaceGridWriter::FORMAT_BINARY;
+                    } else if (!strcmp(argv[i], "files")) {
+                        gridOutputFormat =
+                            tutorial::FaceGridWriter::FORMAT_OBJ_PER_FACE;
+                    } else {
+                        fprintf(stderr, "Warning: Unrecognized grid output "
+                            "format '%s' ignored\n", argv[i]);
+                    }
+                }
+            } else if (!strcmp(argv[i], "-gridfile")) {
+                if (++i < argc) gridOutputFile = std::string(argv[i]);
+            } else if (!strcmp(argv[i], "-gridthread")) {
+                gridWriterThreadFlag = true;
+            } else if (!strcmp(argv[i], "-shortest")) {
+                shortestFloatsFlag = true;
+            } else if (!strcmp(argv[i], "-quantize")) {
+                quantizeFlag = true;
+            } else if (!strcmp(argv[i], "-vcache")) {
+                vertexCacheFlag = true;
             } else {
                 fprintf(stderr,
                     "Warning: Unrecognized argument '%s' ignored\n", argv[i]);
@@ -139,21 +242,336 @@ void printUVs(Far::ConstIndexArray const & cia,std::vector<float>   const & mesh
 	std::cerr << "]" << std::endl;
 }
 
+//
+//  Use simpler local type names for the Surface and its factory.  The
+//  factory is assigned a thread-safe cache (SurfaceFactoryCacheThreaded
+//  with a reader/writer mutex) so that a single instance can be shared
+//  by all threads tessellating faces:
+//
+typedef Bfr::SurfaceFactoryCacheThreaded<std::shared_timed_mutex,
+                std::shared_lock<std::shared_timed_mutex>,
+                std::unique_lock<std::shared_timed_mutex> > ThreadedCache;
+
+typedef Bfr::RefinerSurfaceFactory<ThreadedCache> SurfaceFactory;
+typedef Bfr::Surface<float>                       Surface;
+
+//
+//  Data shared by all faces (and all workers) of a tessellation:
+//
+struct TessellationContext {
+    SurfaceFactory const *     surfaceFactory;
+    std::vector<float> const * meshVertexPositions;
+    std::vector<float> const * meshFaceVaryingUVs;
+    bool                       meshHasUVs;
+
+    Args const *               options;
+    Bfr::Tessellation::Options tessOptions;
+
+    //  The GridStencilCache is not thread-safe -- only its lookups and
+    //  insertions are serialized (keys and stencils are computed by the
+    //  workers):
+    tutorial::GridStencilCache * gridCache;
+    std::mutex                   gridCacheMutex;
+
+    //  Grid points of all faces from precomputed stencils (optional, with
+    //  normals from their derivatives):
+    tutorial::FaceStencilTable const * stencilTable;
+    float const *                      stencilTablePoints;
+    float const *                      stencilTableNormals;
+};
+
+//
+//  The tessellation of a single face -- points are evaluated and facets
+//  are identified relative to the face, so that faces can be processed in
+//  any order and written in face order afterwards:
+//
+struct FaceTessellation {
+    bool               valid;
+    int                numControlPoints;
+    std::vector<float> pos, du, dv, normals;
+    std::vector<float> uv;
+    std::vector<int>   facets;
+    std::vector<float> gridPoints;
+};
+
+//
+//  The Surfaces and intermediate buffers used by each worker.  Since
+//  dynamic memory is involved with these variables, they are preserved
+//  and reused across all faces processed by the worker:
+//
+struct FaceWorkspace {
+    Surface posSurface;
+    Surface uvSurface;
+
+    std::vector<float> facePatchPoints;
+
+    //  Patterns shared by faces with the same parameterization and rate:
+    tutorial::TessellationPatternCache patternCache;
+
+    //  Facets and vertex cache misses of the patterns of all faces:
+    long numFacets;
+    long numOriginalCacheMisses;
+    long numCacheMisses;
+
+    std::vector<float> limitStencils;
+    std::vector<float> faceControlPoints;
+
+    //  Stencil at the center of each face identifying its grid stencils:
+    std::vector<float> centerStencil;
+
+    FaceWorkspace() :
+        numFacets(0), numOriginalCacheMisses(0), numCacheMisses(0) { }
+};
+
+//
+//  Evaluate the grid of each face with limit stencils -- the points are
+//  written with those of all other faces once evaluated:
+//
+static void
+evaluateFaceGrid(TessellationContext & context, int faceIndex,
+                 FaceWorkspace & work, FaceTessellation & face) {
+
+    Surface const & posSurface = work.posSurface;
+
+    //
+    //  Grid points of all faces may have been computed in a single pass
+    //  from precomputed stencils -- in which case they are only written:
+    //
+    if (context.stencilTable) {
+        face.numControlPoints =
+            context.stencilTable->GetNumControlPoints(faceIndex);
+        return;
+    }
+
+    //
+    //  Resize stencils and control point arrays based on the number
+    //  of control points for the Surface:
+    //
+    int numControlPoints = posSurface.GetNumControlPoints();
+    face.numControlPoints = numControlPoints;
+
+    work.limitStencils.resize(3 * numControlPoints);
+
+    float * pStencil  = work.limitStencils.data();
+
+    work.faceControlPoints.resize(numControlPoints * 3);
+    posSurface.GatherControlPoints(context.meshVertexPositions->data(), 3,
+                                   work.faceControlPoints.data(), 3);
+
+    tutorial::GridStencilCache & gridCache = *context.gridCache;
+    tutorial::GridStencilCache::GridStencils const * gridStencils = 0;
+    tutorial::GridStencilCache::Key gridKey;
+    if (context.options->gridCacheFlag &&
+            gridCache.GetKey(posSurface, work.centerStencil, gridKey)) {
+        {
+            std::lock_guard<std::mutex> lock(context.gridCacheMutex);
+            gridStencils = gridCache.FindStencils(gridKey);
+        }
+        if (gridStencils == 0) {
+            tutorial::GridStencilCache::GridStencils newStencils;
+            gridCache.ComputeStencils(posSurface, newStencils);
+
+            std::lock_guard<std::mutex> lock(context.gridCacheMutex);
+            gridStencils = gridCache.AddStencils(gridKey, newStencils);
+        }
+    }
+
+	if (gridStencils)
+	{
+        //  Regular face -- a single dense multiply for all points:
+        face.gridPoints.resize(gridStencils->numPoints * 3);
+        gridStencils->Apply(work.faceControlPoints.data(), 3,
+                            face.gridPoints.data());
+	}
+	else
+	{
+		int rows = context.options->gridResolution;
+		int columns = rows;
+		float u_delta = 1.0/(rows-1);
+		float v_delta = 1.0/(columns-1);
+        face.gridPoints.resize(rows * columns * 3);
+		for (auto i=0;i<rows;i++)
+		{
+			for (auto j=0;j<columns;j++)
+			{
+        		float uv[2] = {i*u_delta,j*v_delta};
+                // faceSurface.EvaluateStencil(uv, pStencil, duStencil, dvStencil);
+        		posSurface.EvaluateStencil(uv, pStencil);
+                float const * controlPoints = work.faceControlPoints.data();
+                float * p = &face.gridPoints[(i * columns + j) * 3];
+                posSurface.ApplyStencil(pStencil,  controlPoints, 3, p);
+			}
+		}
+	}
+}
+
+//
+//  Tessellate and evaluate a single face:
+//
+static void
+tessellateFace(TessellationContext & context, int faceIndex,
+               FaceWorkspace & work, FaceTessellation & face) {
+
+    SurfaceFactory const & surfaceFactory = *context.surfaceFactory;
+
+    //
+    //  Initialize the Surfaces for position and UVs of this face.
+    //  There are two ways to do this -- both illustrated here:
+    //
+    //  Creating Surfaces for the different data interpolation types
+    //  independently is clear and convenient, but considerable work
+    //  may be duplicated in the construction process in the case of
+    //  non-linear face-varying Surfaces. So unless it is known that
+    //  face-varying interpolation is linear, use of InitSurfaces()
+    //  is generally preferred.
+    //
+    //  Remember also that the face-varying identifier is omitted from
+    //  the initialization methods here as it was previously assigned
+    //  to the SurfaceFactory::Options. In the absence of an assignment
+    //  of the default FVarID to the Options, a failure to specify the
+    //  FVarID here will result in failure.
+    //
+    //  The cases below are expanded for illustration purposes, and
+    //  validity of the resulting Surface is tested here, rather than
+    //  the return value of initialization methods.
+    //
+    Surface & posSurface = work.posSurface;
+    Surface & uvSurface  = work.uvSurface;
+
+    bool createSurfacesTogether = true;
+    if (!context.meshHasUVs) {
+        surfaceFactory.InitVertexSurface(faceIndex, &posSurface);
+    } else if (createSurfacesTogether) {
+        surfaceFactory.InitSurfaces(faceIndex, &posSurface, &uvSurface);
+    } else {
+        if (surfaceFactory.InitVertexSurface(faceIndex, &posSurface)) {
+            surfaceFactory.InitFaceVaryingSurface(faceIndex, &uvSurface);
+        }
+    }
+    face.valid = posSurface.IsValid();
+    if (!face.valid) return;
+
+    //
+    //  Identify a simple uniform Tessellation for the Parameterization
+    //  of this face and the coordinates of the points to evaluate --
+    //  taken from the cache of patterns already generated:
+    //
+    tutorial::TessellationPatternCache::Pattern const & tessPattern =
+            work.patternCache.GetPattern(posSurface.GetParameterization(), 1,
+                                         &context.options->tessUniformRate,
+                                         context.tessOptions);
+
+    work.numFacets              += tessPattern.numFacets;
+    work.numOriginalCacheMisses += tessPattern.numOriginalCacheMisses;
+    work.numCacheMisses         += tessPattern.numCacheMisses;
+
+    int numOutCoords = tessPattern.numCoords;
+
+    std::vector<float> const & outCoords = tessPattern.coords;
+
+    //
+    //  Prepare the patch points for the Surface, then use them to
+    //  evaluate output points for all identified coordinates:
+    //
+    std::vector<float> & facePatchPoints = work.facePatchPoints;
+
+    //  Evaluate vertex positions:
+    {
+        //  Resize patch point and output arrays:
+        int pointSize = 3;
+
+        facePatchPoints.resize(posSurface.GetNumPatchPoints() * pointSize);
+
+        face.pos.resize(numOutCoords * pointSize);
+        face.du.resize(numOutCoords * pointSize);
+        face.dv.resize(numOutCoords * pointSize);
+
+        //  Populate patch point and output arrays:
+        posSurface.PreparePatchPoints(context.meshVertexPositions->data(),
+                                      pointSize,
+                                      facePatchPoints.data(), pointSize);
+
+        //  Regular B-spline patches (the majority of faces) are evaluated
+        //  for blocks of coordinates at once, all others per coordinate:
+        if (tutorial::BSplinePatch::IsBSplineSurface(posSurface,
+                                                     facePatchPoints.data())) {
+            tutorial::BSplinePatch::Evaluate(facePatchPoints.data(),
+                    numOutCoords, outCoords.data(),
+                    face.pos.data(), face.du.data(), face.dv.data());
+        } else {
+            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
+                posSurface.Evaluate(&outCoords[i*2],
+                                    facePatchPoints.data(), pointSize,
+                                    &face.pos[j], &face.du[j], &face.dv[j]);
+            }
+        }
+
+        //  Normals are computed here in a batch (by the workers rather
+        //  than the writer):
+        face.normals.resize(numOutCoords * pointSize);
+        tutorial::ComputeVertexNormals(numOutCoords, face.du.data(), face.dv.data(),
+                                       face.normals.data());
+    }
+
+    //  Evaluate face-varying UVs (when present):
+    if (context.meshHasUVs) {
+        int pointSize = 2;
+
+        face.uv.resize(numOutCoords * pointSize);
+
+        //  UVs of quads and triangles that are linear (common with
+        //  face-varying data) are interpolated directly from the UVs of
+        //  their corners -- no patch points are needed:
+        if (tutorial::LinearPatch::IsLinearSurface(uvSurface)) {
+            tutorial::LinearPatch::Evaluate(uvSurface,
+                    context.meshFaceVaryingUVs->data(), pointSize,
+                    numOutCoords, outCoords.data(), face.uv.data());
+        } else {
+            //  Resize patch point array:
+            //      - note reuse of the same patch point array as position
+            facePatchPoints.resize(uvSurface.GetNumPatchPoints() * pointSize);
+
+            //  Populate patch point and output arrays:
+            uvSurface.PreparePatchPoints(context.meshFaceVaryingUVs->data(),
+                                         pointSize,
+                                         facePatchPoints.data(), pointSize);
+
+            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
+                uvSurface.Evaluate(&outCoords[i*2],
+                                   facePatchPoints.data(), pointSize,
+                                   &face.uv[j]);
+            }
+        }
+    }
+
+    bool evaluateLimitStencil = true;
+    if (evaluateLimitStencil) {
+        evaluateFaceGrid(context, faceIndex, work, face);
+    }
+
+    //
+    //  Identify the faces of the Tessellation -- indices are relative to
+    //  the points of this face and offset when written:
+    //
+    face.facets.assign(tessPattern.facets.begin(), tessPattern.facets.end());
+}
+
 //
 //  The main tessellation function:  given a mesh and vertex positions,
-//  tessellate each face -- writing results in Obj format.
+//  tessellate each face -- writing results in Obj format.  Irregular
+//  patches are taken from (and added to) the given SurfaceCache when
+//  specified, rather than the cache internal to the SurfaceFactory.
+//  Returns false if the output could not be written:
 //
-void
+bool
 tessellateToObj(Far::TopologyRefiner const & meshTopology,
                 std::vector<float>   const & meshVertexPositions,
                 std::vector<float>   const & meshFaceVaryingUVs,
-                Args                 const & options) {
-
-    //
-    //  Use simpler local type names for the Surface and its factory:
-    //
-    typedef Bfr::RefinerSurfaceFactory<> SurfaceFactory;
-    typedef Bfr::Surface<float>          Surface;
+                Args                 const & options,
+                std::string          const & outputObjFile,
+                std::string          const & gridOutputFile,
+                tutorial::SurfaceCache *     surfaceCache = 0,
+                tutorial::FaceStencilTable const * stencilTable = 0) {
 
     //
     //  Initialize the SurfaceFactory for the given base mesh (very low
@@ -164,7 +582,8 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     //  use of an internal cache.  Creating a separate instance of the
     //  SurfaceFactory for each thread is one way to safely parallelize
     //  this loop.  Another (preferred) is to assign a thread-safe cache
-    //  to the single instance.
+    //  to the single instance -- as is done with the SurfaceFactory type
+    //  declared above.
     //
     //  First declare any evaluation options when initializing:
     //
@@ -180,25 +599,18 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     if (meshHasUVs) {
         surfaceOptions.SetDefaultFVarID(0);
     }
+    if (surfaceCache) {
+        surfaceOptions.SetExternalCache(surfaceCache);
+    }
 
     SurfaceFactory surfaceFactory(meshTopology, surfaceOptions);
 
     //
-    //  The Surface to be constructed and evaluated for each face -- as
-    //  well as the intermediate and output data associated with it -- can
-    //  be declared in the scope local to each face. But since dynamic
-    //  memory is involved with these variables, it is preferred to declare
-    //  them outside that loop to preserve and reuse that dynamic memory.
+    //  The limit stencils for the grid of each face are evaluated per point
+    //  unless the weights of regular faces are to be taken from the cache:
     //
-    Surface posSurface;
-    Surface uvSurface;
-
-    std::vector<float> facePatchPoints;
-
-    std::vector<float> outCoords;
-    std::vector<float> outPos, outDu, outDv;
-    std::vector<float> outUV;
-    std::vector<int>   outFacets;
+    tutorial::GridStencilCache gridCache(options.gridResolution,
+                                         options.gridResolution);
 
     //
     //  Assign Tessellation Options applied for all faces.  Tessellations
@@ -207,197 +619,314 @@ tessellateToObj(Far::TopologyRefiner const & meshTopology,
     //
     int const tessFacetSize = 3 + options.tessQuadsFlag;
 
-    Bfr::Tessellation::Options tessOptions;
-    tessOptions.SetFacetSize(tessFacetSize);
-    tessOptions.PreserveQuads(options.tessQuadsFlag);
+    TessellationContext context;
+    context.surfaceFactory      = &surfaceFactory;
+    context.meshVertexPositions = &meshVertexPositions;
+    context.meshFaceVaryingUVs  = &meshFaceVaryingUVs;
+    context.meshHasUVs          = meshHasUVs;
+    context.options             = &options;
+    context.gridCache           = &gridCache;
+    context.stencilTable        = 0;
+    context.stencilTablePoints  = 0;
+    context.stencilTableNormals = 0;
+
+    context.tessOptions.SetFacetSize(tessFacetSize);
+    context.tessOptions.PreserveQuads(options.tessQuadsFlag);
 
     //
-    //  Process each face, writing the output of each in Obj format:
+    //  Faces are divided into chunks that workers claim in turn, each
+    //  worker tessellating its faces with its own Surfaces and buffers.
+    //  Completed tessellations are handed to a writer thread through an
+    //  OrderedRing and written in face order (so the output does not depend
+    //  on the number of threads) while the workers continue -- waiting
+    //  only when the ring is full:
     //
-    tutorial::ObjWriter objWriter(options.outputObjFile);
+    int const numThreads = tutorial::GetNumThreads(options.numThreads);
+    int const chunkSize  = 64;
+    int const ringSize   = numThreads * chunkSize * 4;
 
-    int numFaces = surfaceFactory.GetNumFaces();
-    for (int faceIndex = 0; faceIndex < numFaces; ++faceIndex) {
-        //
-        //  Initialize the Surfaces for position and UVs of this face.
-        //  There are two ways to do this -- both illustrated here:
-        //
-        //  Creating Surfaces for the different data interpolation types
-        //  independently is clear and convenient, but considerable work
-        //  may be duplicated in the construction process in the case of
-        //  non-linear face-varying Surfaces. So unless it is known that
-        //  face-varying interpolation is linear, use of InitSurfaces()
-        //  is generally preferred.
-        //
-        //  Remember also that the face-varying identifier is omitted from
-        //  the initialization methods here as it was previously assigned
-        //  to the SurfaceFactory::Options. In the absence of an assignment
-        //  of the default FVarID to the Options, a failure to specify the
-        //  FVarID here will result in failure.
-        //
-        //  The cases below are expanded for illustration purposes, and
-        //  validity of the resulting Surface is tested here, rather than
-        //  the return value of initialization methods.
-        //
-        bool createSurfacesTogether = true;
-        if (!meshHasUVs) {
-            surfaceFactory.InitVertexSurface(faceIndex, &posSurface);
-        } else if (createSurfacesTogether) {
-            surfaceFactory.InitSurfaces(faceIndex, &posSurface, &uvSurface);
-        } else {
-            if (surfaceFactory.InitVertexSurface(faceIndex, &posSurface)) {
-                surfaceFactory.InitFaceVaryingSurface(faceIndex, &uvSurface);
-            }
+    //
+    //  With precomputed stencils, the grid points of all faces are
+    //  computed from the positions in a single (multithreaded) pass --
+    //  along with their derivatives when normals are written:
+    //
+    std::vector<float> stencilTablePoints;
+    std::vector<float> stencilTableDu, stencilTableDv, stencilTableNormals;
+
+    bool writeGridNormals = stencilTable && stencilTable->HasDerivatives() &&
+                            options.gridNormalsFlag;
+    if (stencilTable) {
+        int numSamples = stencilTable->GetNumFaces() *
+                         stencilTable->GetNumSamplesPerFace();
+
+        stencilTablePoints.resize((size_t) numSamples * 3);
+        if (writeGridNormals) {
+            stencilTableDu.resize((size_t) numSamples * 3);
+            stencilTableDv.resize((size_t) numSamples * 3);
+            stencilTableNormals.resize((size_t) numSamples * 3);
+        }
+        stencilTable->Apply(meshVertexPositions.data(),
+                            stencilTablePoints.data(),
+                            writeGridNormals ? stencilTableDu.data() : 0,
+                            writeGridNormals ? stencilTableDv.data() : 0,
+                            numThreads);
+        if (writeGridNormals) {
+            tutorial::ComputeVertexNormals(numSamples, stencilTableDu.data(),
+                                           stencilTableDv.data(),
+                                           stencilTableNormals.data());
         }
-        if (!posSurface.IsValid()) continue;
-
-        //
-        //  Declare a simple uniform Tessellation for the Parameterization
-        //  of this face and identify coordinates of the points to evaluate:
-        //
-        Bfr::Tessellation tessPattern(posSurface.GetParameterization(),
-                                      options.tessUniformRate, tessOptions);
-
-        int numOutCoords = tessPattern.GetNumCoords();
-
-        outCoords.resize(numOutCoords * 2);
-
-        tessPattern.GetCoords(outCoords.data());
-
-        //
-        //  Prepare the patch points for the Surface, then use them to
-        //  evaluate output points for all identified coordinates:
-        //
-        //  Evaluate vertex positions:
-        {
-            //  Resize patch point and output arrays:
-            int pointSize = 3;
 
-            facePatchPoints.resize(posSurface.GetNumPatchPoints() * pointSize);
+        context.stencilTable        = stencilTable;
+        context.stencilTablePoints  = stencilTablePoints.data();
+        context.stencilTableNormals = writeGridNormals ?
+                                      stencilTableNormals.data() : 0;
+    }
 
-            outPos.resize(numOutCoords * pointSize);
-            outDu.resize(numOutCoords * pointSize);
-            outDv.resize(numOutCoords * pointSize);
+    std::vector<FaceWorkspace> workspaces(numThreads);
 
-            //  Populate patch point and output arrays:
-            posSurface.PreparePatchPoints(meshVertexPositions.data(), pointSize,
-                                          facePatchPoints.data(), pointSize);
-
-            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
-                posSurface.Evaluate(&outCoords[i*2],
-                                    facePatchPoints.data(), pointSize,
-                                    &outPos[j], &outDu[j], &outDv[j]);
-            }
+    //
+    //  Triangles and points of the patterns are ordered for the vertex
+    //  cache by the workers when generated:
+    //
+    bool orderForVertexCache = options.vertexCacheFlag && (tessFacetSize == 3);
+    if (options.vertexCacheFlag && !orderForVertexCache) {
+        fprintf(stderr, "Warning: Vertex cache order ignored with -quads\n");
+    }
+    if (orderForVertexCache) {
+        for (FaceWorkspace & work : workspaces) {
+            work.patternCache.SetOrder(
+                    tutorial::TessellationPatternCache::ORDER_FACETS_AND_COORDS);
         }
+    }
 
-        //  Evaluate face-varying UVs (when present):
-        if (meshHasUVs) {
-            //  Resize patch point and output arrays:
-            //      - note reuse of the same patch point array as position
-            int pointSize = 2;
+    tutorial::OrderedRing<FaceTessellation> faceRing(ringSize);
+
+    //  The writer is chosen by the extension of the output file (Obj,
+    //  binary PLY or raw arrays):
+    std::unique_ptr<tutorial::MeshWriter> meshWriter(
+            tutorial::MeshWriter::Create(outputObjFile));
+    //  Arrays of a face large enough (e.g. at high tessellation rates) are
+    //  formatted as text on as many threads as faces are tessellated:
+    meshWriter->SetNumThreads(numThreads);
+    if (options.shortestFloatsFlag) {
+        meshWriter->SetFloatFormat(tutorial::FloatFormat::SHORTEST);
+    }
+    if (options.quantizeFlag) {
+        meshWriter->SetQuantization(tutorial::QUANTIZE_POSITIONS |
+                                    tutorial::QUANTIZE_NORMALS |
+                                    tutorial::QUANTIZE_UVS);
+    }
 
-            facePatchPoints.resize(uvSurface.GetNumPatchPoints() * pointSize);
+    std::vector<int> outFacets;
 
-            outUV.resize(numOutCoords * pointSize);
+    int numFaces = surfaceFactory.GetNumFaces();
 
-            //  Populate patch point and output arrays:
-            uvSurface.PreparePatchPoints(meshFaceVaryingUVs.data(), pointSize,
-                                         facePatchPoints.data(), pointSize);
+    //
+    //  The grid points of all faces are written in face order -- to a
+    //  file per face or a single stream (optionally by a writer thread):
+    //
+    tutorial::FaceGridWriter gridWriter(options.gridOutputFormat,
+            gridOutputFile, numFaces, options.gridWriterThreadFlag,
+            writeGridNormals);
+    if (!gridWriter.IsValid()) {
+        return false;
+    }
 
-            for (int i = 0, j = 0; i < numOutCoords; ++i, j += pointSize) {
-                uvSurface.Evaluate(&outCoords[i*2],
-                                   facePatchPoints.data(), pointSize,
-                                   &outUV[j]);
-            }
-        }
+    auto writeFace = [&](int faceIndex, FaceTessellation const & face) {
+        if (!face.valid) return;
 
+        //  Diagnostics are reported here to keep them in face order:
         {
         	Far::ConstIndexArray uvcia = getFaceUVIndices(meshTopology, faceIndex);
         	printCIA(uvcia);
         	printUVs(uvcia,meshFaceVaryingUVs);
         }
-        bool evaluateLimitStencil = true;
-        if (evaluateLimitStencil){
-            std::vector<float> limitStencils;
-            std::vector<float> faceControlPoints;
-
-
-            //
-            //  Resize stencils and control point arrays based on the number
-            //  of control points for the Surface:
-            //
-            int numControlPoints = posSurface.GetNumControlPoints();
-            fprintf(stderr,"numControlPoints = %d\n",numControlPoints);
-
-            limitStencils.resize(3 * numControlPoints);
-
-            float * pStencil  = limitStencils.data();
-            float * duStencil = limitStencils.data() + numControlPoints;
-            float * dvStencil = limitStencils.data() + numControlPoints * 2;
-
-            faceControlPoints.resize(numControlPoints * 3);
-            posSurface.GatherControlPoints(meshVertexPositions.data(), 3,
-                                                        faceControlPoints.data(), 3);
-        	char filename[256];
-        	sprintf(filename,"face_%05d.obj",faceIndex);
-        	FILE* fp = fopen(filename,"w");
-        	if (fp)
-        	{
-        		int rows = 16;
-        		int columns = rows;
-        		float u_delta = 1.0/(rows-1);
-        		float v_delta = 1.0/(columns-1);
-        		for (auto i=0;i<rows;i++)
-        		{
-        			for (auto j=0;j<columns;j++)
-        			{
-                		float uv[2] = {i*u_delta,j*v_delta};
-                        // faceSurface.EvaluateStencil(uv, pStencil, duStencil, dvStencil);
-                		posSurface.EvaluateStencil(uv, pStencil);
-                        float const * controlPoints = faceControlPoints.data();
-                        float p[3];
-                        posSurface.ApplyStencil(pStencil,  controlPoints, 3, p);
-                        fprintf(fp,"v %f %f %f\n",p[0],p[1],p[2]);
-        			}
-        		}
-        		fclose(fp);
-        	}
+        fprintf(stderr,"numControlPoints = %d\n",face.numControlPoints);
+
+        if (stencilTable) {
+            int numSamples = stencilTable->GetNumSamplesPerFace();
+            size_t offset  = (size_t) faceIndex * numSamples * 3;
+            float const * normals = context.stencilTableNormals ?
+                                    context.stencilTableNormals + offset : 0;
+            gridWriter.WriteFace(faceIndex, context.stencilTablePoints + offset,
+                                 numSamples, normals);
+        } else {
+            gridWriter.WriteFace(faceIndex, face.gridPoints.data(),
+                                 (int) face.gridPoints.size() / 3);
         }
 
         //
-        //  Identify the faces of the Tessellation:
+        //  Note the need to offset vertex indices for the output faces
+        //  -- using the number of vertices generated prior to this face
+        //  (unused indices of triangles among quads remain negative):
         //
-        //  Note the need to offset vertex indices for the output faces --
-        //  using the number of vertices generated prior to this face. One
-        //  of several Tessellation methods to transform the facet indices
-        //  simply translates all indices by the desired offset.
-        //
-        int objVertexIndexOffset = objWriter.GetNumVertices();
-
-        int numFacets = tessPattern.GetNumFacets();
-        outFacets.resize(numFacets * tessFacetSize);
-        tessPattern.GetFacets(outFacets.data());
+        int objVertexIndexOffset = meshWriter->GetNumVertices();
 
-        tessPattern.TransformFacetCoordIndices(outFacets.data(),
-                                               objVertexIndexOffset);
+        outFacets.resize(face.facets.size());
+        for (size_t i = 0; i < face.facets.size(); ++i) {
+            outFacets[i] = (face.facets[i] < 0) ? face.facets[i] :
+                           (face.facets[i] + objVertexIndexOffset);
+        }
 
         //
         //  Write the evaluated points and faces connecting them as Obj:
         //
-        objWriter.WriteGroupName("baseFace_", faceIndex);
+        meshWriter->WriteGroupName("baseFace_", faceIndex);
 
         if (meshHasUVs && options.uv2xyzFlag) {
-            objWriter.WriteVertexPositions(outUV, 2);
-            objWriter.WriteFaces(outFacets, tessFacetSize, false, false);
+            meshWriter->WriteVertexPositions(face.uv, 2);
+            meshWriter->WriteFaces(outFacets, tessFacetSize, false, false);
         } else {
-            objWriter.WriteVertexPositions(outPos);
-            objWriter.WriteVertexNormals(outDu, outDv);
+            meshWriter->WriteVertexPositions(face.pos);
+            meshWriter->WriteVertexNormals(face.normals);
             if (meshHasUVs) {
-                objWriter.WriteVertexUVs(outUV);
+                meshWriter->WriteVertexUVs(face.uv);
             }
-            objWriter.WriteFaces(outFacets, tessFacetSize, true, meshHasUVs);
+            meshWriter->WriteFaces(outFacets, tessFacetSize, true, meshHasUVs);
         }
+    };
+
+    std::thread writerThread([&]() {
+        for (int faceIndex = 0; faceIndex < numFaces; ++faceIndex) {
+            writeFace(faceIndex, faceRing.WaitForItem(faceIndex));
+            faceRing.ReleaseItem(faceIndex);
+        }
+    });
+
+    std::atomic<int> nextChunk(0);
+
+    tutorial::ParallelFor(0, numThreads, 1, [&](int workerBegin,
+                                                int workerEnd) {
+        for (int worker = workerBegin; worker < workerEnd; ++worker) {
+            int chunkBegin;
+            while ((chunkBegin = nextChunk.fetch_add(chunkSize)) < numFaces) {
+                int chunkEnd = std::min(chunkBegin + chunkSize, numFaces);
+                for (int faceIndex = chunkBegin; faceIndex < chunkEnd;
+                        ++faceIndex) {
+                    tessellateFace(context, faceIndex, workspaces[worker],
+                                   faceRing.AcquireItem(faceIndex));
+                    faceRing.PublishItem(faceIndex);
+                }
+            }
+        }
+    }, numThreads);
+
+    writerThread.join();
+
+    //  Write all output before reporting, checking for failure:
+    bool success = meshWriter->Close();
+    success = gridWriter.Close() && success;
+
+    if (orderForVertexCache) {
+        long numFacets = 0, numOriginalMisses = 0, numMisses = 0;
+        for (FaceWorkspace const & work : workspaces) {
+            numFacets         += work.numFacets;
+            numOriginalMisses += work.numOriginalCacheMisses;
+            numMisses         += work.numCacheMisses;
+        }
+        if (numFacets > 0) {
+            fprintf(stderr, "Vertex cache:  ACMR %.3f before, %.3f after "
+                    "(%ld triangles)\n",
+                    (double) numOriginalMisses / (double) numFacets,
+                    (double) numMisses / (double) numFacets, numFacets);
+        }
+    }
+
+    if (options.gridCacheFlag) {
+        fprintf(stderr, "GridStencilCache: %d entries, %d hits, %d misses\n",
+                gridCache.GetNumEntries(), gridCache.GetNumHits(),
+                gridCache.GetNumMisses());
     }
+    return success;
+}
+
+//
+//  Name of the file for a frame of an animation, e.g. "mesh_0003.obj":
+//
+std::string
+frameObjFile(std::string const & objFile, int frame) {
+
+    if (objFile.empty()) return objFile;
+
+    char frameSuffix[32];
+    snprintf(frameSuffix, sizeof(frameSuffix), "_%04d", frame);
+
+    size_t extension = objFile.rfind('.');
+    size_t directory = objFile.find_last_of("/\\");
+    if ((extension == std::string::npos) ||
+            ((directory != std::string::npos) && (extension < directory))) {
+        return objFile + frameSuffix;
+    }
+
+    return objFile.substr(0, extension) + frameSuffix + objFile.substr(extension);
+}
+
+//
+//  Name of the grid file (or the prefix of the per face files) for a frame,
+//  e.g. "grid_0003_face_00000.obj" for the prefix "grid":
+//
+std::string
+frameGridFile(std::string const & gridFile,
+              tutorial::FaceGridWriter::Format format, int frame) {
+
+    if (format != tutorial::FaceGridWriter::FORMAT_OBJ_PER_FACE) {
+        return frameObjFile(gridFile, frame);
+    }
+
+    char frameSuffix[32];
+    snprintf(frameSuffix, sizeof(frameSuffix), "_%04d_", frame);
+    return gridFile + frameSuffix;
+}
+
+//
+//  Precompute the limit stencils of the grid of all faces (including the
+//  derivatives for normals) -- or load them from the given file when it
+//  matches the mesh and grid resolution (a table computed for a file that
+//  does not match is saved to it):
+//
+tutorial::FaceStencilTable *
+createStencilTable(Far::TopologyRefiner const & meshTopology,
+                   Args const & options) {
+
+    tutorial::FaceStencilTable * table = new tutorial::FaceStencilTable;
+
+    int numFaces = meshTopology.GetLevel(0).GetNumFaces();
+
+    FILE * existing = options.stencilTableFile.empty() ? 0 :
+                      fopen(options.stencilTableFile.c_str(), "rb");
+    if (existing) {
+        fclose(existing);
+        if (table->Load(options.stencilTableFile) &&
+                (table->GetNumFaces() == numFaces) &&
+                (table->GetNumRows() == options.gridResolution) &&
+                (table->GetNumColumns() == options.gridResolution) &&
+                (table->HasDerivatives() || !options.gridNormalsFlag)) {
+            fprintf(stderr, "Stencils loaded from '%s'\n",
+                    options.stencilTableFile.c_str());
+            return table;
+        }
+        fprintf(stderr, "Warning: Stencils in '%s' do not match -- "
+                "recomputing\n", options.stencilTableFile.c_str());
+    }
+
+    std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+    Bfr::RefinerSurfaceFactory<> surfaceFactory(meshTopology);
+
+    table->Build(surfaceFactory, numFaces, options.gridResolution,
+                 options.gridResolution, options.gridNormalsFlag,
+                 tutorial::GetNumThreads(options.numThreads));
+
+    double ms = 1000.0 * std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "Stencils computed for %d faces in %.3f ms\n",
+            numFaces, ms);
+
+    if (!options.stencilTableFile.empty()) {
+        table->Save(options.stencilTableFile);
+    }
+    return table;
 }
 
 //
@@ -418,10 +947,77 @@ main(int argc, char * argv[]) {
         return EXIT_FAILURE;
     }
 
-    tessellateToObj(*meshTopology, meshVtxPositions, meshFVarUVs, args);
+    //
+    //  Grid points are written to a file per face by default (the file
+    //  name of the single stream formats defaults to "faces.obj" or
+    //  "faces.grid"):
+    //
+    std::string gridOutputFile = args.gridOutputFile;
+    if (gridOutputFile.empty()) {
+        if (args.gridOutputFormat == tutorial::FaceGridWriter::FORMAT_OBJ) {
+            gridOutputFile = "faces.obj";
+        } else if (args.gridOutputFormat ==
+                   tutorial::FaceGridWriter::FORMAT_BINARY) {
+            gridOutputFile = "faces.grid";
+        }
+    }
+
+    //
+    //  Stencils depend only on topology and are applied to all frames:
+    //
+    tutorial::FaceStencilTable * stencilTable = 0;
+    if (args.stencilTableFlag) {
+        stencilTable = createStencilTable(*meshTopology, args);
+    }
+
+    bool success = true;
+    if (args.numFrames <= 1) {
+        success = tessellateToObj(*meshTopology, meshVtxPositions, meshFVarUVs,
+                                  args, args.outputObjFile, gridOutputFile, 0,
+                                  stencilTable);
+    } else {
+        //
+        //  Tessellate a simple animation of the mesh -- a uniform scaling
+        //  varying per frame -- with a SurfaceCache that persists across
+        //  frames, so that irregular patches are only constructed for the
+        //  first frame:
+        //
+        tutorial::SurfaceCache surfaceCache(args.cacheEntries);
+
+        std::vector<float> framePositions(meshVtxPositions.size());
+
+        for (int frame = 0; frame < args.numFrames; ++frame) {
+            float scale = 1.0f + 0.1f * std::sin(0.5f * (float) frame);
+            for (size_t i = 0; i < meshVtxPositions.size(); ++i) {
+                framePositions[i] = scale * meshVtxPositions[i];
+            }
+
+            surfaceCache.ResetCounters();
+
+            std::chrono::steady_clock::time_point start =
+                    std::chrono::steady_clock::now();
+
+            success = tessellateToObj(*meshTopology, framePositions,
+                                      meshFVarUVs, args,
+                                      frameObjFile(args.outputObjFile, frame),
+                                      frameGridFile(gridOutputFile,
+                                                    args.gridOutputFormat,
+                                                    frame),
+                                      &surfaceCache, stencilTable) && success;
+
+            double ms = 1000.0 * std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+
+            fprintf(stderr, "Frame %d: %.3f ms -- SurfaceCache: %zu entries, "
+                    "%zu hits, %zu misses, %zu evictions\n", frame, ms,
+                    surfaceCache.GetNumEntries(), surfaceCache.GetNumHits(),
+                    surfaceCache.GetNumMisses(), surfaceCache.GetNumEvictions());
+        }
+    }
 
+    delete stencilTable;
     delete meshTopology;
-    return EXIT_SUCCESS;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,258 @@
+//------------------------------------------------------------------------------
+//  Benchmark of closest point queries on the limit surface:
+//
+//  Query points are generated by offsetting random limit surface samples
+//  (ptexFace, s, t) along the surface normal by a small random distance,
+//  so that the sample itself is a known bound on the distance of the
+//  closest point.  The queries are projected back onto the limit surface
+//  with tutorial::PatchProjector, first on a single thread and then on all
+//  threads, and both throughput and accuracy are reported.
+//
+#include <opensubdiv/far/patchTable.h>
+#include <opensubdiv/far/topologyRefiner.h>
+
+#include <utils/meshLoader.h>
+#include <utils/parallel.h>
+#include <utils/patchBVH.h>
+#include <utils/patchProjector.h>
+#include <utils/patchSurface.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace OpenSubdiv;
+
+//
+//  Command line arguments:
+//
+class Args {
+public:
+    std::string inputObjFile;
+    int         maxPatchLevel;
+    int         numQueries;
+    float       offsetFraction;
+    int         numThreads;
+
+public:
+    Args(int argc, char * argv[]) :
+        inputObjFile(),
+        maxPatchLevel(3),
+        numQueries(100000),
+        offsetFraction(0.01f),
+        numThreads(0) {
+
+        for (int i = 1; i < argc; ++i) {
+            if (strstr(argv[i], ".obj")) {
+                if (inputObjFile.empty()) {
+                    inputObjFile = std::string(argv[i]);
+                } else {
+                    fprintf(stderr,
+                        "Warning: Extra Obj file '%s' ignored\n", argv[i]);
+                }
+            } else if (!strcmp(argv[i], "-level")) {
+                if (++i < argc) maxPatchLevel = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-n")) {
+                if (++i < argc) numQueries = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-offset")) {
+                if (++i < argc) offsetFraction = (float) atof(argv[i]);
+            } else if (!strcmp(argv[i], "-threads")) {
+                if (++i < argc) numThreads = atoi(argv[i]);
+            } else {
+                fprintf(stderr,
+                    "Warning: Unrecognized argument '%s' ignored\n", argv[i]);
+            }
+        }
+    }
+
+private:
+    Args() { }
+};
+
+namespace {
+    double
+    elapsedSeconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+    float
+    randomFloat() {
+        return (float) rand() / (float) RAND_MAX;
+    }
+}
+
+//
+//  Accuracy of the projected results -- the distance found should never
+//  exceed the offset of the query from its original sample:
+//
+struct Accuracy {
+    int    numMissed;        // no result
+    int    numWorse;         // distance found exceeds the known bound
+    double maxExcess;        // largest excess over the known bound
+    double meanSampleError;  // distance between result and original sample
+    double maxSampleError;
+};
+
+static Accuracy
+measureAccuracy(std::vector<tutorial::PatchProjector::Result> const & results,
+                std::vector<float> const & samples,
+                std::vector<float> const & offsets, float tolerance) {
+
+    Accuracy a;
+    a.numMissed       = 0;
+    a.numWorse        = 0;
+    a.maxExcess       = 0.0;
+    a.meanSampleError = 0.0;
+    a.maxSampleError  = 0.0;
+
+    int numQueries = (int) results.size();
+    for (int i = 0; i < numQueries; ++i) {
+        tutorial::PatchProjector::Result const & r = results[i];
+        if (r.faceId < 0) {
+            ++ a.numMissed;
+            continue;
+        }
+
+        double excess = r.distance - std::fabs(offsets[i]);
+        if (excess > tolerance) ++ a.numWorse;
+        a.maxExcess = std::max(a.maxExcess, excess);
+
+        float const * S = &samples[3 * i];
+        double e = std::sqrt((r.P[0] - S[0]) * (r.P[0] - S[0]) +
+                             (r.P[1] - S[1]) * (r.P[1] - S[1]) +
+                             (r.P[2] - S[2]) * (r.P[2] - S[2]));
+        a.meanSampleError += e;
+        a.maxSampleError = std::max(a.maxSampleError, e);
+    }
+    if (numQueries > a.numMissed) {
+        a.meanSampleError /= (numQueries - a.numMissed);
+    }
+    return a;
+}
+
+//
+//  Load the mesh, generate the queries and time their projection:
+//
+int
+main(int argc, char * argv[]) {
+
+    Args args(argc, argv);
+
+    std::vector<float> coarsePos;
+    std::vector<float> coarseUVs;
+
+    Far::TopologyRefiner * refiner = tutorial::createTopologyRefiner(
+            args.inputObjFile, Sdc::SCHEME_CATMARK, coarsePos, coarseUVs);
+    if (refiner == 0) {
+        return EXIT_FAILURE;
+    }
+
+    tutorial::PatchSurface surface(*refiner, coarsePos, args.maxPatchLevel);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    tutorial::PatchBVH bvh(surface.GetPatchTable(), surface.GetPoints());
+    if (!bvh.IsValid() || (bvh.GetNumPatches() == 0)) {
+        fprintf(stderr, "Error:  No quad-based patches to query\n");
+        delete refiner;
+        return EXIT_FAILURE;
+    }
+    double bvhSeconds = elapsedSeconds(start);
+
+    //
+    //  Generate the queries from random samples of the limit surface:
+    //
+    tutorial::PatchBVH::Bounds const & meshBounds = bvh.GetNode(0).bounds;
+    float diagonal = std::sqrt(
+        (meshBounds.max[0] - meshBounds.min[0]) * (meshBounds.max[0] - meshBounds.min[0]) +
+        (meshBounds.max[1] - meshBounds.min[1]) * (meshBounds.max[1] - meshBounds.min[1]) +
+        (meshBounds.max[2] - meshBounds.min[2]) * (meshBounds.max[2] - meshBounds.min[2]));
+
+    int numQueries = args.numQueries;
+
+    std::vector<float> samples(3 * numQueries);
+    std::vector<float> offsets(numQueries);
+    std::vector<float> queries(3 * numQueries);
+
+    srand(static_cast<int>(2147483647));
+
+    for (int i = 0; i < numQueries; ) {
+        int   face = rand() % surface.GetNumPtexFaces();
+        float s    = randomFloat();
+        float t    = randomFloat();
+
+        float * P = &samples[3 * i];
+        float Du[3], Dv[3];
+        if (!surface.Evaluate(face, s, t, P, Du, Dv)) continue;
+
+        float N[3] = { Du[1] * Dv[2] - Du[2] * Dv[1],
+                       Du[2] * Dv[0] - Du[0] * Dv[2],
+                       Du[0] * Dv[1] - Du[1] * Dv[0] };
+        float lenN = std::sqrt(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+        if (lenN <= 0.0f) continue;
+
+        offsets[i] = (2.0f * randomFloat() - 1.0f) * args.offsetFraction * diagonal;
+
+        float * Q = &queries[3 * i];
+        for (int k = 0; k < 3; ++k) {
+            Q[k] = P[k] + N[k] * (offsets[i] / lenN);
+        }
+        ++ i;
+    }
+
+    //
+    //  Project the queries on one thread and then on all threads:
+    //
+    tutorial::PatchProjector projector(surface.GetPatchTable(),
+                                       surface.GetPoints(), bvh);
+
+    std::vector<tutorial::PatchProjector::Result> results(numQueries);
+
+    start = std::chrono::steady_clock::now();
+    projector.ProjectPoints(numQueries, queries.data(), results.data(), 1);
+    double serialSeconds = elapsedSeconds(start);
+
+    long numPatchTests = projector.GetNumPatchTests();
+
+    int numThreads = tutorial::GetNumThreads(args.numThreads);
+
+    start = std::chrono::steady_clock::now();
+    projector.ProjectPoints(numQueries, queries.data(), results.data(),
+                            numThreads);
+    double parallelSeconds = elapsedSeconds(start);
+
+    Accuracy accuracy = measureAccuracy(results, samples, offsets,
+                                        1.0e-5f * diagonal);
+
+    //
+    //  Report:
+    //
+    printf("Mesh:     %d ptex faces, %d patches, %d BVH nodes (built in %.3f ms)\n",
+        surface.GetNumPtexFaces(), bvh.GetNumPatches(), bvh.GetNumNodes(),
+        bvhSeconds * 1000.0);
+    printf("Queries:  %d, offset up to %g (%g of the bounding box diagonal)\n",
+        numQueries, args.offsetFraction * diagonal, args.offsetFraction);
+    printf("Patches tested per query:  %.2f\n",
+        (double) numPatchTests / std::max(1, numQueries));
+    printf("Throughput:\n");
+    printf("  1 thread   : %10.3f ms %12.0f queries/s\n",
+        serialSeconds * 1000.0, numQueries / serialSeconds);
+    printf("  %-2d threads : %10.3f ms %12.0f queries/s (x%.2f)\n", numThreads,
+        parallelSeconds * 1000.0, numQueries / parallelSeconds,
+        serialSeconds / parallelSeconds);
+    printf("Accuracy:\n");
+    printf("  missed                   : %d\n", accuracy.numMissed);
+    printf("  further than sample      : %d (max excess %g)\n",
+        accuracy.numWorse, accuracy.maxExcess);
+    printf("  distance to sample       : mean %g, max %g\n",
+        accuracy.meanSampleError, accuracy.maxSampleError);
+
+    delete refiner;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+//------------------------------------------------------------------------------
+//  Ray casting of the limit surface:
+//
+//  Casts one ray per pixel from a pinhole camera framing the mesh against
+//  the patches of the limit surface with tutorial::PatchRayIntersector --
+//  first on a single thread and then on all threads -- and reports the
+//  throughput.  The (ptexFace, s, t) of every hit is checked by evaluating
+//  the limit surface there, and an image of the hit normals can be written
+//  as a binary PPM file.
+//
+#include <opensubdiv/far/patchTable.h>
+#include <opensubdiv/far/topologyRefiner.h>
+
+#include <utils/meshLoader.h>
+#include <utils/parallel.h>
+#include <utils/patchBVH.h>
+#include <utils/patchRayIntersector.h>
+#include <utils/patchSurface.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace OpenSubdiv;
+
+//
+//  Command line arguments:
+//
+class Args {
+public:
+    std::string inputObjFile;
+    std::string outputPpmFile;
+    int         maxPatchLevel;
+    int         resolution;
+    int         numThreads;
+
+public:
+    Args(int argc, char * argv[]) :
+        inputObjFile(),
+        outputPpmFile(),
+        maxPatchLevel(3),
+        resolution(512),
+        numThreads(0) {
+
+        for (int i = 1; i < argc; ++i) {
+            if (strstr(argv[i], ".obj")) {
+                if (inputObjFile.empty()) {
+                    inputObjFile = std::string(argv[i]);
+                } else {
+                    fprintf(stderr,
+                        "Warning: Extra Obj file '%s' ignored\n", argv[i]);
+                }
+            } else if (!strcmp(argv[i], "-o")) {
+                if (++i < argc) outputPpmFile = std::string(argv[i]);
+            } else if (!strcmp(argv[i], "-level")) {
+                if (++i < argc) maxPatchLevel = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-res")) {
+                if (++i < argc) resolution = atoi(argv[i]);
+            } else if (!strcmp(argv[i], "-threads")) {
+                if (++i < argc) numThreads = atoi(argv[i]);
+            } else {
+                fprintf(stderr,
+                    "Warning: Unrecognized argument '%s' ignored\n", argv[i]);
+            }
+        }
+    }
+
+private:
+    Args() { }
+};
+
+namespace {
+    double
+    elapsedSeconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+//
+//  Rays of a pinhole camera on the +z side of the bounds looking down -z,
+//  ordered by rows so that consecutive rays (packets) are coherent:
+//
+static void
+generateCameraRays(tutorial::PatchBVH::Bounds const & bounds, int resolution,
+                   std::vector<tutorial::PatchRayIntersector::Ray> & rays) {
+
+    float center[3], radius = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        center[k] = 0.5f * (bounds.min[k] + bounds.max[k]);
+        radius = std::max(radius, 0.5f * (bounds.max[k] - bounds.min[k]));
+    }
+
+    float const tanHalfFov = 0.5f;
+    float distance = 1.5f * radius / tanHalfFov + radius;
+
+    rays.resize(resolution * resolution);
+    for (int y = 0; y < resolution; ++y) {
+        for (int x = 0; x < resolution; ++x) {
+            tutorial::PatchRayIntersector::Ray & ray = rays[y * resolution + x];
+
+            ray.origin[0] = center[0];
+            ray.origin[1] = center[1];
+            ray.origin[2] = center[2] + distance;
+
+            ray.direction[0] = tanHalfFov * (2.0f * (x + 0.5f) / resolution - 1.0f);
+            ray.direction[1] = tanHalfFov * (1.0f - 2.0f * (y + 0.5f) / resolution);
+            ray.direction[2] = -1.0f;
+
+            ray.tMin = 0.0f;
+            ray.tMax = 1.0e30f;
+        }
+    }
+}
+
+static bool
+writeNormalsPPM(std::string const & filename, int resolution,
+                std::vector<tutorial::PatchRayIntersector::Hit> const & hits) {
+
+    FILE * fptr = fopen(filename.c_str(), "wb");
+    if (fptr == 0) {
+        fprintf(stderr, "Error:  Cannot open PPM file '%s'\n", filename.c_str());
+        return false;
+    }
+    fprintf(fptr, "P6\n%d %d\n255\n", resolution, resolution);
+
+    std::vector<unsigned char> row(3 * resolution);
+    for (int y = 0; y < resolution; ++y) {
+        for (int x = 0; x < resolution; ++x) {
+            tutorial::PatchRayIntersector::Hit const & hit = hits[y * resolution + x];
+            for (int k = 0; k < 3; ++k) {
+                row[3 * x + k] = (hit.faceId < 0) ? 0 :
+                    (unsigned char) (127.5f * (hit.N[k] + 1.0f));
+            }
+        }
+        fwrite(row.data(), 1, row.size(), fptr);
+    }
+    fclose(fptr);
+    return true;
+}
+
+//
+//  Load the mesh, cast the rays and report:
+//
+int
+main(int argc, char * argv[]) {
+
+    Args args(argc, argv);
+
+    std::vector<float> coarsePos;
+    std::vector<float> coarseUVs;
+
+    Far::TopologyRefiner * refiner = tutorial::createTopologyRefiner(
+            args.inputObjFile, Sdc::SCHEME_CATMARK, coarsePos, coarseUVs);
+    if (refiner == 0) {
+        return EXIT_FAILURE;
+    }
+
+    tutorial::PatchSurface surface(*refiner, coarsePos, args.maxPatchLevel);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    tutorial::PatchBVH bvh(surface.GetPatchTable(), surface.GetPoints());
+    if (!bvh.IsValid() || (bvh.GetNumPatches() == 0)) {
+        fprintf(stderr, "Error:  No quad-based patches to intersect\n");
+        delete refiner;
+        return EXIT_FAILURE;
+    }
+    double bvhSeconds = elapsedSeconds(start);
+
+    std::vector<tutorial::PatchRayIntersector::Ray> rays;
+    generateCameraRays(bvh.GetNode(0).bounds, args.resolution, rays);
+
+    int numRays = (int) rays.size();
+
+    //
+    //  Cast the rays on one thread and then on all threads:
+    //
+    tutorial::PatchRayIntersector intersector(surface.GetPatchTable(),
+                                              surface.GetPoints(), bvh);
+
+    std::vector<tutorial::PatchRayIntersector::Hit> hits(numRays);
+
+    start = std::chrono::steady_clock::now();
+    intersector.IntersectRays(numRays, rays.data(), hits.data(), 1);
+    double serialSeconds = elapsedSeconds(start);
+
+    int numThreads = tutorial::GetNumThreads(args.numThreads);
+
+    start = std::chrono::steady_clock::now();
+    intersector.IntersectRays(numRays, rays.data(), hits.data(), numThreads);
+    double parallelSeconds = elapsedSeconds(start);
+
+    //
+    //  Check that the (ptexFace, s, t) of each hit evaluates to its point:
+    //
+    int    numHits = 0;
+    double maxError = 0.0;
+    for (int i = 0; i < numRays; ++i) {
+        tutorial::PatchRayIntersector::Hit const & hit = hits[i];
+        if (hit.faceId < 0) continue;
+        ++ numHits;
+
+        float P[3];
+        if (!surface.Evaluate(hit.faceId, hit.s, hit.t, P)) {
+            maxError = HUGE_VAL;
+            continue;
+        }
+        double e = std::sqrt((P[0] - hit.P[0]) * (P[0] - hit.P[0]) +
+                             (P[1] - hit.P[1]) * (P[1] - hit.P[1]) +
+                             (P[2] - hit.P[2]) * (P[2] - hit.P[2]));
+        maxError = std::max(maxError, e);
+    }
+
+    printf("Mesh:     %d ptex faces, %d patches, %d BVH nodes (built in %.3f ms)\n",
+        surface.GetNumPtexFaces(), bvh.GetNumPatches(), bvh.GetNumNodes(),
+        bvhSeconds * 1000.0);
+    printf("Rays:     %d (%dx%d), %d hits, packets of %d\n", numRays,
+        args.resolution, args.resolution, numHits,
+        tutorial::PatchRayIntersector::kPacketSize);
+    printf("Throughput:\n");
+    printf("  1 thread   : %10.3f ms %12.0f rays/s\n",
+        serialSeconds * 1000.0, numRays / serialSeconds);
+    printf("  %-2d threads : %10.3f ms %12.0f rays/s (x%.2f)\n", numThreads,
+        parallelSeconds * 1000.0, numRays / parallelSeconds,
+        serialSeconds / parallelSeconds);
+    printf("Max distance between hits and their (ptexFace, s, t): %g\n",
+        maxError);
+
+    if (!args.outputPpmFile.empty()) {
+        writeNormalsPPM(args.outputPpmFile, args.resolution, hits);
+    }
+
+    delete refiner;
+    return EXIT_SUCCESS;
+}
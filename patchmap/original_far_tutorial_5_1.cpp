@@ -45,6 +45,7 @@
 #include <opensubdiv/far/patchTableFactory.h>
 #include <opensubdiv/far/patchMap.h>
 #include <opensubdiv/far/ptexIndices.h>
+#include <utils/patchPointStencils.h>
 
 #include <cassert>
 #include <cstdio>
@@ -137,7 +138,11 @@ struct LimitFrame {
 };
 
 //------------------------------------------------------------------------------
-int main(int, char **) {
+int main(int argc, char **argv) {
+
+    // Optionally compute the patch points in a single pass from the coarse
+    // vertices with tutorial::PatchPointStencils
+    bool useStencils = (argc > 1) && !strcmp(argv[1], "-stencils");
 
     // Generate a Far::TopologyRefiner (see tutorial_1_1 for details).
     Far::TopologyRefiner * refiner = createTopologyRefiner();
@@ -194,7 +199,12 @@ int main(int, char **) {
 
     // Create a buffer to hold the position of the refined verts and
     // local points, then copy the coarse positions at the beginning.
-    std::vector<Vertex> verts(nRefinerVertices + nLocalPoints);
+    // Only the coarse positions are needed when the patch points are
+    // computed from them directly.
+    int nCoarseVertices = refiner->GetLevel(0).GetNumVertices();
+
+    std::vector<Vertex> verts(useStencils ? nCoarseVertices
+                                          : (nRefinerVertices + nLocalPoints));
     std::memcpy(&verts[0], g_verts, g_nverts*3*sizeof(Real));
 
     // NICHOLAS
@@ -203,26 +213,42 @@ int main(int, char **) {
           std::cout << boost::format("NICHOLAS v %1% %2% %3%\n") % v.point[0] % v.point[1] % v.point[2];
         }
     }
-    // Adaptive refinement may result in fewer levels than the max specified.
-    int nRefinedLevels = refiner->GetNumLevels();
-
-    // Interpolate vertex primvar data : they are the control vertices
-    // of the limit patches (see tutorial_1_1 for details)
-    Far::PrimvarRefinerReal<Real> primvarRefiner(*refiner);
-
-    Vertex * src = &verts[0];
-    for (int level = 1; level < nRefinedLevels; ++level) {
-        Vertex * dst = src + refiner->GetLevel(level-1).GetNumVertices();
-        primvarRefiner.Interpolate(level, src, dst);
-        src = dst;
-    }
+    // Points referenced by the patches and the buffer indexed by them
+    tutorial::PatchPointStencils<Real> * patchPoints = 0;
+    std::vector<Vertex> points;
 
-    // Evaluate local points from interpolated vertex primvars.
-    if (nLocalPoints) {
-        patchTable->GetLocalPointStencilTable<Real>()->UpdateValues(
-            &verts[0], &verts[nRefinerVertices]);
+    if (useStencils) {
+        patchPoints = new tutorial::PatchPointStencils<Real>(*refiner, *patchTable);
+
+        // Single pass from the coarse vertices to all patch points
+        points.resize(patchPoints->GetNumPoints());
+        patchPoints->Update(&verts[0], &points[0]);
+    } else {
+        // Adaptive refinement may result in fewer levels than the max specified.
+        int nRefinedLevels = refiner->GetNumLevels();
+
+        // Interpolate vertex primvar data : they are the control vertices
+        // of the limit patches (see tutorial_1_1 for details)
+        Far::PrimvarRefinerReal<Real> primvarRefiner(*refiner);
+
+        Vertex * src = &verts[0];
+        for (int level = 1; level < nRefinedLevels; ++level) {
+            Vertex * dst = src + refiner->GetLevel(level-1).GetNumVertices();
+            primvarRefiner.Interpolate(level, src, dst);
+            src = dst;
+        }
+
+        // Evaluate local points from interpolated vertex primvars.
+        if (nLocalPoints) {
+            patchTable->GetLocalPointStencilTable<Real>()->UpdateValues(
+                &verts[0], &verts[nRefinerVertices]);
+        }
     }
 
+    // The control points of the patches are either the refined vertices and
+    // local points or the compact patch points
+    Vertex const * patchVerts = useStencils ? &points[0] : &verts[0];
+
     // Create a Far::PatchMap to help locating patches in the table
     Far::PatchMap patchmap(*patchTable);
 
@@ -254,12 +280,14 @@ int main(int, char **) {
             // Evaluate the patch weights, identify the CVs and compute the limit frame:
             patchTable->EvaluateBasis(*handle, s, t, pWeights, dsWeights, dtWeights);
 
-            Far::ConstIndexArray cvs = patchTable->GetPatchVertices(*handle);
+            Far::ConstIndexArray cvs = patchPoints ?
+                patchPoints->GetPatchPoints(*handle) :
+                patchTable->GetPatchVertices(*handle);
 
             LimitFrame & dst = samples[count];
             dst.Clear();
             for (int cv=0; cv < cvs.size(); ++cv) {
-                dst.AddWithWeight(verts[cvs[cv]], pWeights[cv], dsWeights[cv], dtWeights[cv]);
+                dst.AddWithWeight(patchVerts[cvs[cv]], pWeights[cv], dsWeights[cv], dtWeights[cv]);
             }
 
         }
@@ -311,6 +339,7 @@ int main(int, char **) {
         printf("select deriv1Shape deriv2Shape;\n");
     }
 
+    delete patchPoints;
     delete refiner;
     delete patchTable;
     return EXIT_SUCCESS;
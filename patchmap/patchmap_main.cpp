@@ -1,3 +1,4 @@
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -17,21 +18,35 @@
 #include <opensubdiv/vtr/types.h> // Dummy include to ensure that we are using OpenSubdiv v3 or later
 
 #include "shape_utils.h"
+#include <utils/fastFormat.h>
 
 void print_specific_level(const OpenSubdiv::Far::TopologyRefiner *refiner, int levelOfInterest) {
 
   OpenSubdiv::Far::TopologyLevel const &thisLevel = refiner->GetLevel(levelOfInterest);
   int thisLevelNumFaces = thisLevel.GetNumFaces();
 
+  // One buffer for all lines of the level, written to std::cout as it fills
+  tutorial::FormatBuffer buffer(std::cout);
+
   for (int faceIndex =0, ptexface=0; faceIndex < thisLevelNumFaces; ++faceIndex) {
     OpenSubdiv::Far::ConstIndexArray thisLevelFaceVertices =
         thisLevel.GetFaceVertices(faceIndex);
 
-    std::cout << boost::format("thisLevelFaceVertices[lvl=%1%][%2%] : {") % levelOfInterest % faceIndex;
+    char *s = buffer.Reserve(2 * tutorial::kMaxNumberLength + 32);
+    std::memcpy(s, "thisLevelFaceVertices[lvl=", 26);
+    s = tutorial::FormatInt(s + 26, levelOfInterest);
+    *s++ = ']';
+    *s++ = '[';
+    s = tutorial::FormatInt(s, faceIndex);
+    std::memcpy(s, "] : {", 5);
+    s += 5;
+    buffer.Commit(s);
     for (auto faceVertex : thisLevelFaceVertices) {
-      std::cout << boost::format(" %1%") % faceVertex;
+      s = buffer.Reserve(tutorial::kMaxNumberLength + 1);
+      *s++ = ' ';
+      buffer.Commit(tutorial::FormatInt(s, faceVertex));
     }
-    std::cout << "}\n";
+    buffer.Append("}\n", 2);
   }
 }
 int main(int argc, char **argv) {
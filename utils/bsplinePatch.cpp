@@ -0,0 +1,211 @@
+#include "bsplinePatch.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    int const kLanes = BSplinePatch::kBlockSize;
+
+    //
+    //  The arithmetic of a block of coordinates -- AVX registers or a small
+    //  array with loops over its lanes:
+    //
+#if defined(__AVX__)
+    typedef __m256 Lanes;
+
+    inline Lanes load(float const x[])   { return _mm256_loadu_ps(x); }
+    inline void  store(float x[], Lanes a) { _mm256_storeu_ps(x, a); }
+    inline Lanes splat(float s)          { return _mm256_set1_ps(s); }
+    inline Lanes add(Lanes a, Lanes b)   { return _mm256_add_ps(a, b); }
+    inline Lanes sub(Lanes a, Lanes b)   { return _mm256_sub_ps(a, b); }
+    inline Lanes mul(Lanes a, Lanes b)   { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+    inline Lanes madd(Lanes a, Lanes b, Lanes c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    inline Lanes madd(Lanes a, Lanes b, Lanes c) { return add(mul(a, b), c); }
+#endif
+#else
+    struct Lanes {
+        float x[kLanes];
+    };
+
+    inline Lanes load(float const x[]) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = x[k];
+        return r;
+    }
+    inline void store(float x[], Lanes const & a) {
+        for (int k = 0; k < kLanes; ++k) x[k] = a.x[k];
+    }
+    inline Lanes splat(float s) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = s;
+        return r;
+    }
+    inline Lanes add(Lanes const & a, Lanes const & b) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = a.x[k] + b.x[k];
+        return r;
+    }
+    inline Lanes sub(Lanes const & a, Lanes const & b) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = a.x[k] - b.x[k];
+        return r;
+    }
+    inline Lanes mul(Lanes const & a, Lanes const & b) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = a.x[k] * b.x[k];
+        return r;
+    }
+    inline Lanes madd(Lanes const & a, Lanes const & b, Lanes const & c) {
+        Lanes r;
+        for (int k = 0; k < kLanes; ++k) r.x[k] = a.x[k] * b.x[k] + c.x[k];
+        return r;
+    }
+#endif
+
+    //
+    //  Cubic B-spline basis and its derivative at t for all lanes:
+    //
+    inline void
+    evalBasis(Lanes t, Lanes w[4], Lanes d[4]) {
+
+        Lanes s  = sub(splat(1.0f), t);
+        Lanes t2 = mul(t, t);
+        Lanes s2 = mul(s, s);
+        Lanes t3 = mul(t2, t);
+        Lanes s3 = mul(s2, s);
+
+        w[0] = mul(s3, splat(1.0f / 6.0f));
+        w[1] = add(madd(t3, splat(0.5f), splat(2.0f / 3.0f)), mul(t2, splat(-1.0f)));
+        w[2] = add(madd(t3, splat(-0.5f), splat(1.0f / 6.0f)),
+                   mul(add(t2, t), splat(0.5f)));
+        w[3] = mul(t3, splat(1.0f / 6.0f));
+
+        d[0] = mul(s2, splat(-0.5f));
+        d[1] = madd(t2, splat(1.5f), mul(t, splat(-2.0f)));
+        d[2] = madd(t2, splat(-1.5f), add(t, splat(0.5f)));
+        d[3] = mul(t2, splat(0.5f));
+    }
+
+    //
+    //  Evaluate a block of coordinates -- results for each component are
+    //  contiguous over the lanes.  Each row of points is first combined in
+    //  u (with its derivative) and the rows are then combined in v:
+    //
+    void
+    evaluateBlock(float const patchPoints[], float const u[], float const v[],
+                  float P[3][kLanes], float Du[3][kLanes], float Dv[3][kLanes]) {
+
+        Lanes wu[4], du[4], wv[4], dv[4];
+        evalBasis(load(u), wu, du);
+        evalBasis(load(v), wv, dv);
+
+        for (int c = 0; c < 3; ++c) {
+            Lanes p  = splat(0.0f);
+            Lanes pu = splat(0.0f);
+            Lanes pv = splat(0.0f);
+
+            for (int i = 0; i < 4; ++i) {
+                float const * row = patchPoints + 12 * i + c;
+
+                Lanes x  = splat(row[0]);
+                Lanes r  = mul(wu[0], x);
+                Lanes ru = mul(du[0], x);
+                for (int j = 1; j < 4; ++j) {
+                    x  = splat(row[3 * j]);
+                    r  = madd(wu[j], x, r);
+                    ru = madd(du[j], x, ru);
+                }
+                p  = madd(wv[i], r,  p);
+                pu = madd(wv[i], ru, pu);
+                pv = madd(dv[i], r,  pv);
+            }
+            store(P[c],  p);
+            store(Du[c], pu);
+            store(Dv[c], pv);
+        }
+    }
+}
+
+//
+//  Definitions of BSplinePatch methods:
+//
+float const BSplinePatch::kTolerance = 1.0e-5f;
+
+bool
+BSplinePatch::IsBSplineSurface(Surface const & surface,
+                               float const patchPoints[], float tolerance) {
+
+    if (!surface.IsRegular() || surface.IsLinear() ||
+        (surface.GetNumPatchPoints() != 16) ||
+        (surface.GetParameterization().GetType() != Bfr::Parameterization::QUAD)) {
+        return false;
+    }
+
+    float magnitude = 1.0f;
+    for (int i = 0; i < 16 * 3; ++i) {
+        magnitude = std::max(magnitude, std::abs(patchPoints[i]));
+    }
+    float const maxError = tolerance * magnitude;
+
+    float const corners[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+    float P[6], Du[6], Dv[6];
+    Evaluate(patchPoints, 2, corners, P, Du, Dv);
+
+    for (int k = 0; k < 2; ++k) {
+        float sP[3], sDu[3], sDv[3];
+        surface.Evaluate(&corners[2 * k], patchPoints, 3, sP, sDu, sDv);
+
+        for (int c = 0; c < 3; ++c) {
+            if ((std::abs(sP[c]  - P[3 * k + c])  > maxError) ||
+                (std::abs(sDu[c] - Du[3 * k + c]) > maxError) ||
+                (std::abs(sDv[c] - Dv[3 * k + c]) > maxError)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+BSplinePatch::Evaluate(float const patchPoints[], int numCoords,
+                       float const uv[], float P[], float Du[], float Dv[]) {
+
+    float u[kLanes], v[kLanes];
+    float bP[3][kLanes], bDu[3][kLanes], bDv[3][kLanes];
+
+    for (int first = 0; first < numCoords; first += kLanes) {
+        int numLanes = std::min(kLanes, numCoords - first);
+
+        //  Lanes past the last coordinate repeat it and are discarded:
+        for (int k = 0; k < kLanes; ++k) {
+            int i = first + std::min(k, numLanes - 1);
+            u[k] = uv[2 * i];
+            v[k] = uv[2 * i + 1];
+        }
+
+        evaluateBlock(patchPoints, u, v, bP, bDu, bDv);
+
+        for (int k = 0; k < numLanes; ++k) {
+            int j = 3 * (first + k);
+            for (int c = 0; c < 3; ++c) {
+                P[j + c]  = bP[c][k];
+                Du[j + c] = bDu[c][k];
+                Dv[j + c] = bDv[c][k];
+            }
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,51 @@
+#ifndef BSPLINE_PATCH_H
+#define BSPLINE_PATCH_H
+
+#include <opensubdiv/bfr/surface.h>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Fast evaluation of regular bicubic B-spline patches.
+//
+//  Most faces of a typical Catmull-Clark mesh are regular, and evaluating
+//  them through Surface::Evaluate() (one coordinate at a time, through the
+//  general patch basis) leaves most of the work on the table.  Here the
+//  16 patch points of a regular Surface are evaluated directly for blocks
+//  of kBlockSize (u,v) coordinates at once -- position and derivatives --
+//  with AVX when enabled for the target (e.g. OSDQUESTIONS_NATIVE_ARCH)
+//  and otherwise with loops over the block that the compiler vectorizes.
+//
+//  Patch points are ordered as those of Far's regular B-spline patches:
+//  4 rows of 4 points, with u varying along each row and the face spanning
+//  the inner points 5, 6, 10 and 9.
+//
+class BSplinePatch {
+public:
+    typedef OpenSubdiv::Bfr::Surface<float> Surface;
+
+    static int const kBlockSize = 8;
+
+    //  Default tolerance of comparisons with the Surface:
+    static float const kTolerance;
+
+    //  Returns true if the Surface is regular with the 16 patch points of
+    //  an interior B-spline patch.  Regular patches on a boundary (which
+    //  Bfr evaluates with a boundary mask rather than phantom points) are
+    //  rejected by comparing with the Surface at opposite corners of the
+    //  face, where a boundary on any side changes the result -- the
+    //  tolerance is relative to the magnitude of the patch points:
+    static bool IsBSplineSurface(Surface const & surface,
+                                 float const patchPoints[],
+                                 float tolerance = kTolerance);
+
+    //  Evaluate 3D points and first derivatives at numCoords interleaved
+    //  (u,v) coordinates given the 16 3D patch points of the Surface:
+    static void Evaluate(float const patchPoints[], int numCoords,
+                         float const uv[], float P[], float Du[], float Dv[]);
+};
+
+} // end namespace
+
+#endif /* BSPLINE_PATCH_H */
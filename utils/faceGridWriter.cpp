@@ -0,0 +1,251 @@
+#include "faceGridWriter.h"
+
+#include <cstring>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    char const kBinaryTag[8]  = { 'O', 'S', 'D', 'Q', 'G', 'R', 'D', '1' };
+    char const kNormalsTag[8] = { 'O', 'S', 'D', 'Q', 'G', 'R', 'N', '1' };
+
+    //  Faces queued for the writer thread before WriteFace() blocks:
+    size_t const kMaxQueuedFaces = 64;
+
+    //  Buffer size of single stream output:
+    size_t const kStreamBufferSize = 1 << 20;
+
+    //  Obj vertices of the points of a face (and their normals if given):
+    bool
+    writeObjPoints(FILE * fptr, float const points[], float const normals[],
+                   int numPoints) {
+        bool success = true;
+        for (int i = 0; i < numPoints; ++i, points += 3) {
+            success = (fprintf(fptr, "v %f %f %f\n",
+                               points[0], points[1], points[2]) > 0) && success;
+        }
+        for (int i = 0; normals && (i < numPoints); ++i, normals += 3) {
+            success = (fprintf(fptr, "vn %f %f %f\n",
+                               normals[0], normals[1], normals[2]) > 0) &&
+                      success;
+        }
+        return success;
+    }
+}
+
+//
+//  Definitions of FaceGridWriter methods:
+//
+FaceGridWriter::FaceGridWriter(Format format, std::string const & path,
+                               int numFaces, bool useWriterThread,
+                               bool withNormals) :
+        _format(format), _path(path), _fptr(0),
+        _numFaces(numFaces), _lastFace(-1), _withNormals(withNormals),
+        _numPointsWritten(0),
+        _useWriterThread(useWriterThread), _closing(false),
+        _success(true), _numFailedFiles(0), _closed(false) {
+
+    if (_format != FORMAT_OBJ_PER_FACE) {
+        _fptr = fopen(path.c_str(), (_format == FORMAT_BINARY) ? "wb" : "w");
+        if (_fptr == 0) {
+            fprintf(stderr, "Error:  FaceGridWriter cannot open file '%s'\n",
+                path.c_str());
+            return;
+        }
+        setvbuf(_fptr, 0, _IOFBF, kStreamBufferSize);
+
+        if (_format == FORMAT_BINARY) {
+            _success = (fwrite(withNormals ? kNormalsTag : kBinaryTag,
+                               sizeof(kBinaryTag), 1, _fptr) == 1);
+            _faceOffsets.assign(numFaces + 1, 0);
+        }
+    }
+
+    if (_useWriterThread) {
+        _writerThread = std::thread(&FaceGridWriter::writerLoop, this);
+    }
+}
+
+FaceGridWriter::~FaceGridWriter() {
+
+    Close();
+}
+
+void
+FaceGridWriter::WriteFace(int face, float const points[], int numPoints,
+                          float const normals[]) {
+
+    if (!IsValid()) return;
+
+    if (!_useWriterThread) {
+        writeFace(face, points, numPoints, normals);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_closing) return;
+
+    _queueChanged.wait(lock, [this] {
+        return _queue.size() < kMaxQueuedFaces;
+    });
+
+    _queue.push_back(Job());
+
+    Job & job = _queue.back();
+    job.face = face;
+    if (!_freeBuffers.empty()) {
+        job.points.swap(_freeBuffers.back());
+        _freeBuffers.pop_back();
+    }
+    job.points.assign(points, points + 3 * numPoints);
+    if (_withNormals) {
+        job.points.insert(job.points.end(), normals, normals + 3 * numPoints);
+    }
+
+    _queueChanged.notify_all();
+}
+
+void
+FaceGridWriter::writerLoop() {
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+        _queueChanged.wait(lock, [this] {
+            return !_queue.empty() || _closing;
+        });
+        if (_queue.empty()) break;
+
+        Job job;
+        job.face = _queue.front().face;
+        job.points.swap(_queue.front().points);
+        _queue.pop_front();
+
+        lock.unlock();
+        int numPoints = (int) job.points.size() / (_withNormals ? 6 : 3);
+        writeFace(job.face, job.points.data(), numPoints,
+                  job.points.data() + 3 * numPoints);
+        lock.lock();
+
+        _freeBuffers.push_back(std::vector<float>());
+        _freeBuffers.back().swap(job.points);
+
+        _queueChanged.notify_all();
+    }
+}
+
+void
+FaceGridWriter::writeFace(int face, float const points[], int numPoints,
+                          float const normals[]) {
+
+    if (_format == FORMAT_OBJ_PER_FACE) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "face_%05d.obj", face);
+
+        //  Failures are counted and reported once when closing:
+        FILE * fptr = fopen((_path + filename).c_str(), "w");
+        if (fptr == 0) {
+            ++_numFailedFiles;
+            return;
+        }
+        bool success = writeObjPoints(fptr, points,
+                                      _withNormals ? normals : 0, numPoints);
+        success = !ferror(fptr) && success;
+        success = (fclose(fptr) == 0) && success;
+        if (!success) {
+            ++_numFailedFiles;
+        }
+        return;
+    }
+
+    if ((face <= _lastFace) || (face >= _numFaces)) {
+        fprintf(stderr, "Warning: Face %d written out of order ignored\n", face);
+        return;
+    }
+
+    if (_format == FORMAT_OBJ) {
+        _success = (fprintf(_fptr, "g face_%05d\n", face) > 0) &&
+                   writeObjPoints(_fptr, points, _withNormals ? normals : 0,
+                                  numPoints) &&
+                   _success;
+    } else {
+        for (int f = _lastFace + 1; f <= face; ++f) {
+            _faceOffsets[f] = _numPointsWritten;
+        }
+        if (_withNormals) {
+            _interleaved.resize(6 * numPoints);
+            for (int i = 0; i < numPoints; ++i) {
+                std::memcpy(&_interleaved[6 * i],     points  + 3 * i,
+                            3 * sizeof(float));
+                std::memcpy(&_interleaved[6 * i + 3], normals + 3 * i,
+                            3 * sizeof(float));
+            }
+            points = _interleaved.data();
+        }
+        size_t pointSize = (_withNormals ? 6 : 3) * sizeof(float);
+        _success = (fwrite(points, pointSize, numPoints, _fptr) ==
+                    (size_t) numPoints) && _success;
+        _numPointsWritten += numPoints;
+    }
+    _lastFace = face;
+}
+
+bool
+FaceGridWriter::Close() {
+
+    if (_useWriterThread && _writerThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closing = true;
+        }
+        _queueChanged.notify_all();
+        _writerThread.join();
+    }
+
+    if (_closed) return _success;
+    _closed = true;
+
+    if (_format == FORMAT_OBJ_PER_FACE) {
+        if (_numFailedFiles > 0) {
+            fprintf(stderr, "Error:  FaceGridWriter failed writing %d files "
+                "'%sface_*.obj'\n", _numFailedFiles, _path.c_str());
+            _success = false;
+        }
+        return _success;
+    }
+
+    //  The file could not be opened (already reported):
+    if (_fptr == 0) {
+        _success = false;
+        return _success;
+    }
+
+    if (_format == FORMAT_BINARY) {
+        for (int f = _lastFace + 1; f <= _numFaces; ++f) {
+            _faceOffsets[f] = _numPointsWritten;
+        }
+
+        long long pointSize   = (_withNormals ? 6 : 3) * sizeof(float);
+        long long indexOffset = (long long) sizeof(kBinaryTag) +
+                                _numPointsWritten * pointSize;
+        long long numFaces = _numFaces;
+
+        size_t numOffsets = _faceOffsets.size();
+
+        _success = (fwrite(_faceOffsets.data(), sizeof(long long),
+                           numOffsets, _fptr) == numOffsets) &&
+                   (fwrite(&numFaces, sizeof(numFaces), 1, _fptr) == 1) &&
+                   (fwrite(&indexOffset, sizeof(indexOffset), 1, _fptr) == 1) &&
+                   _success;
+    }
+    _success = !ferror(_fptr) && _success;
+    _success = (fclose(_fptr) == 0) && _success;
+    _fptr = 0;
+
+    if (!_success) {
+        fprintf(stderr, "Error:  FaceGridWriter failed writing file '%s'\n",
+            _path.c_str());
+    }
+    return _success;
+}
+
+} // end namespace
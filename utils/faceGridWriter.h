@@ -0,0 +1,103 @@
+#ifndef FACE_GRID_WRITER_H
+#define FACE_GRID_WRITER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Output of the points evaluated for each face of a mesh (e.g. a grid of
+//  limit points per face).
+//
+//  Points can be written as a separate Obj file per face (the original
+//  behavior -- costly for large meshes as every face opens and closes a
+//  file), or as a single stream for all faces:  an Obj file with a group
+//  per face, or a binary file:
+//
+//      char[8]   "OSDQGRD1" (or "OSDQGRN1" with normals)
+//      float[3]  points of all faces, in face order (float[6] with normals,
+//                each point followed by its normal)
+//      int64[numFaces + 1]  offset of the points of each face (in points)
+//      int64     numFaces
+//      int64     byte offset of the face offsets
+//
+//  Faces must be written in increasing order to a single stream (faces
+//  not written have no points).  Writing can optionally be done by a
+//  background thread, in which case the points are copied and WriteFace()
+//  returns as soon as they are queued.
+//
+//  Normals of the points are optional ("vn" following the "v" of each face
+//  in Obj) -- when enabled, a normal must be given for every point.
+//
+class FaceGridWriter {
+public:
+    enum Format {
+        FORMAT_OBJ_PER_FACE,   // "<path>face_%05d.obj" for each face
+        FORMAT_OBJ,
+        FORMAT_BINARY
+    };
+
+public:
+    FaceGridWriter(Format format, std::string const & path, int numFaces,
+                   bool useWriterThread = false, bool withNormals = false);
+    ~FaceGridWriter();
+
+    //  Returns false if the output file could not be opened:
+    bool IsValid() const { return (_format == FORMAT_OBJ_PER_FACE) || _fptr; }
+
+    void WriteFace(int face, float const points[], int numPoints,
+                   float const normals[] = 0);
+
+    //  Flush all pending faces and finish the file (called on destruction)
+    //  -- returns false (with a message) if any output failed:
+    bool Close();
+
+private:
+    //  Points of a job are followed by their normals (if any):
+    struct Job {
+        int                face;
+        std::vector<float> points;
+    };
+
+    void writeFace(int face, float const points[], int numPoints,
+                   float const normals[]);
+    void writerLoop();
+
+private:
+    Format      _format;
+    std::string _path;
+    FILE *      _fptr;
+    int         _numFaces;
+    int         _lastFace;
+    bool        _withNormals;
+
+    //  Offsets of the points of each face in the binary format:
+    std::vector<long long> _faceOffsets;
+    long long              _numPointsWritten;
+    std::vector<float>     _interleaved;
+
+    //  Queue of faces for the writer thread (bounded, buffers recycled):
+    bool                    _useWriterThread;
+    std::thread             _writerThread;
+    std::mutex              _mutex;
+    std::condition_variable _queueChanged;
+    std::deque<Job>         _queue;
+    std::vector<std::vector<float> > _freeBuffers;
+    bool                    _closing;
+
+    //  Failures of the writes (only by the thread writing faces):
+    bool                    _success;
+    int                     _numFailedFiles;
+    bool                    _closed;
+};
+
+} // end namespace
+
+#endif /* FACE_GRID_WRITER_H */
@@ -0,0 +1,316 @@
+#include "faceStencilTable.h"
+#include "parallel.h"
+
+#include <opensubdiv/bfr/surface.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    char const kFileTag[8] = { 'O', 'S', 'D', 'Q', 'F', 'S', 'T', '2' };
+
+    //  Sizes of arrays are 64-bit in the file on all platforms:
+    template <typename T>
+    bool
+    writeArray(FILE * fptr, std::vector<T> const & v) {
+        int64_t size = (int64_t) v.size();
+        return (fwrite(&size, sizeof(size), 1, fptr) == 1) &&
+               (fwrite(v.data(), sizeof(T), v.size(), fptr) == v.size());
+    }
+
+    template <typename T>
+    bool
+    readArray(FILE * fptr, std::vector<T> & v) {
+        int64_t size = 0;
+        if ((fread(&size, sizeof(size), 1, fptr) != 1) || (size < 0)) {
+            return false;
+        }
+        v.resize((size_t) size);
+        return fread(v.data(), sizeof(T), v.size(), fptr) == v.size();
+    }
+
+    //
+    //  Dot products of the weights of a sample with the x, y and z of the
+    //  control points (gathered as separate arrays):
+    //
+#if defined(__AVX__)
+    inline float
+    horizontalSum(__m256 a) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(a),
+                              _mm256_extractf128_ps(a, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    inline __m256
+    madd(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__)
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+#endif
+
+    inline void
+    applyWeights(int n, float const w[], float const X[], float const Y[],
+                 float const Z[], float result[3]) {
+
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+
+        int k = 0;
+#if defined(__AVX__)
+        if (n >= 8) {
+            __m256 sumX = _mm256_setzero_ps();
+            __m256 sumY = _mm256_setzero_ps();
+            __m256 sumZ = _mm256_setzero_ps();
+            for ( ; k + 8 <= n; k += 8) {
+                __m256 wk = _mm256_loadu_ps(w + k);
+                sumX = madd(wk, _mm256_loadu_ps(X + k), sumX);
+                sumY = madd(wk, _mm256_loadu_ps(Y + k), sumY);
+                sumZ = madd(wk, _mm256_loadu_ps(Z + k), sumZ);
+            }
+            x = horizontalSum(sumX);
+            y = horizontalSum(sumY);
+            z = horizontalSum(sumZ);
+        }
+#endif
+        for ( ; k < n; ++k) {
+            x += w[k] * X[k];
+            y += w[k] * Y[k];
+            z += w[k] * Z[k];
+        }
+        result[0] = x;
+        result[1] = y;
+        result[2] = z;
+    }
+}
+
+//
+//  Definitions of FaceStencilTable methods:
+//
+FaceStencilTable::FaceStencilTable() : _rows(0), _columns(0), _faceOffsets(1, 0) {
+}
+
+void
+FaceStencilTable::Build(SurfaceFactory const & surfaceFactory, int numFaces,
+                        int rows, int columns, bool includeDerivatives,
+                        int numThreads) {
+
+    assert((rows > 1) && (columns > 1));
+
+    _rows    = rows;
+    _columns = columns;
+
+    //
+    //  Count the control points of all faces to allocate the table:
+    //
+    _faceOffsets.assign(numFaces + 1, 0);
+
+    ParallelFor(0, numFaces, 64, [&](int faceBegin, int faceEnd) {
+        Bfr::Surface<float> surface;
+        for (int face = faceBegin; face < faceEnd; ++face) {
+            if (surfaceFactory.InitVertexSurface(face, &surface)) {
+                _faceOffsets[face + 1] = surface.GetNumControlPoints();
+            }
+        }
+    }, numThreads);
+
+    for (int face = 0; face < numFaces; ++face) {
+        _faceOffsets[face + 1] += _faceOffsets[face];
+    }
+
+    int    numSamples = GetNumSamplesPerFace();
+    size_t numWeights = (size_t) numSamples * _faceOffsets[numFaces];
+
+    _controlIndices.resize(_faceOffsets[numFaces]);
+    _weightsP.resize(numWeights);
+    _weightsDu.resize(includeDerivatives ? numWeights : 0);
+    _weightsDv.resize(includeDerivatives ? numWeights : 0);
+
+    //
+    //  Evaluate the stencils of each sample directly into the table:
+    //
+    float const du = 1.0f / (float) (rows - 1);
+    float const dv = 1.0f / (float) (columns - 1);
+
+    ParallelFor(0, numFaces, 64, [&](int faceBegin, int faceEnd) {
+        Bfr::Surface<float> surface;
+        for (int face = faceBegin; face < faceEnd; ++face) {
+            int numControlPoints = GetNumControlPoints(face);
+            if (numControlPoints == 0) continue;
+
+            surfaceFactory.InitVertexSurface(face, &surface);
+            surface.GetControlPointIndices(&_controlIndices[_faceOffsets[face]]);
+
+            size_t base = (size_t) numSamples * _faceOffsets[face];
+            for (int i = 0; i < rows; ++i) {
+                for (int j = 0; j < columns; ++j) {
+                    float uv[2] = { i * du, j * dv };
+
+                    size_t row = base + (size_t) (i * columns + j) *
+                                 numControlPoints;
+                    if (includeDerivatives) {
+                        surface.EvaluateStencil(uv, &_weightsP[row],
+                                &_weightsDu[row], &_weightsDv[row]);
+                    } else {
+                        surface.EvaluateStencil(uv, &_weightsP[row]);
+                    }
+                }
+            }
+        }
+    }, numThreads);
+}
+
+//
+//  The x, y and z of the control points of a face are gathered into three
+//  contiguous arrays, so that each sample is three dot products of
+//  contiguous weights and coordinates (vectorized with AVX).  The blocks
+//  of the derivatives are applied the same way to the same control points:
+//
+void
+FaceStencilTable::applyFace(int face, float const meshPoints[],
+                            std::vector<float> & controlPoints,
+                            float P[], float Du[], float Dv[]) const {
+
+    int numSamples       = GetNumSamplesPerFace();
+    int numControlPoints = GetNumControlPoints(face);
+
+    std::vector<float> const * weights[3] = {
+        &_weightsP, &_weightsDu, &_weightsDv };
+    float * results[3] = { P, Du, Dv };
+
+    size_t resultOffset = (size_t) face * numSamples * 3;
+    if (numControlPoints == 0) {
+        for (int b = 0; b < 3; ++b) {
+            if (results[b] == 0) continue;
+            std::memset(results[b] + resultOffset, 0,
+                        numSamples * 3 * sizeof(float));
+        }
+        return;
+    }
+
+    int const * indices = &_controlIndices[_faceOffsets[face]];
+
+    controlPoints.resize(numControlPoints * 3);
+    float * X = controlPoints.data();
+    float * Y = X + numControlPoints;
+    float * Z = Y + numControlPoints;
+    for (int k = 0; k < numControlPoints; ++k) {
+        float const * src = meshPoints + 3 * indices[k];
+        X[k] = src[0];
+        Y[k] = src[1];
+        Z[k] = src[2];
+    }
+
+    size_t weightOffset = (size_t) numSamples * _faceOffsets[face];
+    for (int b = 0; b < 3; ++b) {
+        if (results[b] == 0) continue;
+
+        float const * w = &(*weights[b])[weightOffset];
+        float * result = results[b] + resultOffset;
+        for (int s = 0; s < numSamples; ++s, w += numControlPoints) {
+            applyWeights(numControlPoints, w, X, Y, Z, result + 3 * s);
+        }
+    }
+}
+
+void
+FaceStencilTable::Apply(float const meshPoints[], float P[],
+                        float Du[], float Dv[], int numThreads) const {
+
+    assert(HasDerivatives() || ((Du == 0) && (Dv == 0)));
+
+    ParallelFor(0, GetNumFaces(), 64, [&](int faceBegin, int faceEnd) {
+        std::vector<float> controlPoints;
+        for (int face = faceBegin; face < faceEnd; ++face) {
+            applyFace(face, meshPoints, controlPoints, P, Du, Dv);
+        }
+    }, numThreads);
+}
+
+bool
+FaceStencilTable::Save(std::string const & filename) const {
+
+    FILE * fptr = fopen(filename.c_str(), "wb");
+    if (fptr == 0) {
+        fprintf(stderr, "Error:  Cannot open stencil file '%s'\n",
+            filename.c_str());
+        return false;
+    }
+
+    int header[2] = { _rows, _columns };
+
+    bool success = (fwrite(kFileTag, sizeof(kFileTag), 1, fptr) == 1) &&
+                   (fwrite(header, sizeof(header), 1, fptr) == 1) &&
+                   writeArray(fptr, _faceOffsets) &&
+                   writeArray(fptr, _controlIndices) &&
+                   writeArray(fptr, _weightsP) &&
+                   writeArray(fptr, _weightsDu) &&
+                   writeArray(fptr, _weightsDv);
+    success = (fclose(fptr) == 0) && success;
+
+    if (!success) {
+        fprintf(stderr, "Error:  Failure writing stencil file '%s'\n",
+            filename.c_str());
+    }
+    return success;
+}
+
+bool
+FaceStencilTable::Load(std::string const & filename) {
+
+    FILE * fptr = fopen(filename.c_str(), "rb");
+    if (fptr == 0) {
+        fprintf(stderr, "Error:  Cannot open stencil file '%s'\n",
+            filename.c_str());
+        return false;
+    }
+
+    char tag[sizeof(kFileTag)];
+    int  header[2];
+
+    bool success = (fread(tag, sizeof(tag), 1, fptr) == 1) &&
+                   (memcmp(tag, kFileTag, sizeof(tag)) == 0) &&
+                   (fread(header, sizeof(header), 1, fptr) == 1) &&
+                   readArray(fptr, _faceOffsets) &&
+                   readArray(fptr, _controlIndices) &&
+                   readArray(fptr, _weightsP) &&
+                   readArray(fptr, _weightsDu) &&
+                   readArray(fptr, _weightsDv);
+    fclose(fptr);
+
+    if (success) {
+        _rows    = header[0];
+        _columns = header[1];
+
+        //  Sizes of all arrays must be consistent with the offsets (the
+        //  derivatives are either both present or both absent):
+        size_t numWeights = (size_t) _rows * _columns * _controlIndices.size();
+        size_t numDerivWeights = _weightsDu.empty() ? 0 : numWeights;
+        success = !_faceOffsets.empty() &&
+                  (_faceOffsets.back() == (int) _controlIndices.size()) &&
+                  (_weightsP.size() == numWeights) &&
+                  (_weightsDu.size() == numDerivWeights) &&
+                  (_weightsDv.size() == numDerivWeights);
+    }
+    if (!success) {
+        fprintf(stderr, "Error:  Invalid stencil file '%s'\n", filename.c_str());
+        *this = FaceStencilTable();
+    }
+    return success;
+}
+
+} // end namespace
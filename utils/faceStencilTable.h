@@ -0,0 +1,84 @@
+#ifndef FACE_STENCIL_TABLE_H
+#define FACE_STENCIL_TABLE_H
+
+#include <opensubdiv/bfr/surfaceFactory.h>
+
+#include <string>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Precomputed limit stencils for a grid of (u,v) samples of every face.
+//
+//  Limit stencils depend only on the topology of the mesh, so for a mesh
+//  that is animated (only its points changing) they can be computed once
+//  and applied to the points of every frame -- replacing the evaluation of
+//  a stencil per sample with a small dense matrix multiply per face.  The
+//  table can be saved to and loaded from a file to avoid recomputing it
+//  for repeated runs.
+//
+//  All samples of a face share the control points of its Surface, so the
+//  table is a CSR layout at the granularity of faces:  the mesh indices of
+//  the control points of each face are followed by a dense block of
+//  weights with a row for each sample (and optionally blocks for the
+//  derivatives).  Grid samples are ordered with u varying slowest, as in
+//  GridStencilCache.
+//
+class FaceStencilTable {
+public:
+    typedef OpenSubdiv::Bfr::SurfaceFactory SurfaceFactory;
+
+public:
+    FaceStencilTable();
+
+    //  Compute the stencils of a rows x columns grid for all faces of the
+    //  factory's mesh -- distributing faces across threads:
+    void Build(SurfaceFactory const & surfaceFactory, int numFaces,
+               int rows, int columns, bool includeDerivatives = false,
+               int numThreads = 0);
+
+    int GetNumFaces() const   { return (int) _faceOffsets.size() - 1; }
+    int GetNumRows() const    { return _rows; }
+    int GetNumColumns() const { return _columns; }
+    int GetNumSamplesPerFace() const { return _rows * _columns; }
+
+    bool HasDerivatives() const { return !_weightsDu.empty(); }
+
+    //  Faces without a limit surface have no stencils:
+    int GetNumControlPoints(int face) const {
+        return _faceOffsets[face + 1] - _faceOffsets[face];
+    }
+
+    //  Apply the stencils to the 3D points of the mesh -- the results for
+    //  all samples of all faces (derivatives are optional):
+    void Apply(float const meshPoints[], float P[],
+               float Du[] = 0, float Dv[] = 0, int numThreads = 0) const;
+
+    //  Returns false (with a message) on failure:
+    bool Save(std::string const & filename) const;
+    bool Load(std::string const & filename);
+
+private:
+    void applyFace(int face, float const meshPoints[],
+                   std::vector<float> & controlPoints,
+                   float P[], float Du[], float Dv[]) const;
+
+private:
+    int _rows;
+    int _columns;
+
+    //  Control point indices of each face, the weights of each face at
+    //  GetNumSamplesPerFace() times its offset into the indices:
+    std::vector<int>   _faceOffsets;
+    std::vector<int>   _controlIndices;
+
+    std::vector<float> _weightsP;
+    std::vector<float> _weightsDu;
+    std::vector<float> _weightsDv;
+};
+
+} // end namespace
+
+#endif /* FACE_STENCIL_TABLE_H */
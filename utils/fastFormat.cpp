@@ -0,0 +1,348 @@
+#include "fastFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    char const kDigitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    //  Powers of 10 exactly representable as double and as integer:
+    double const kPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12 };
+
+    unsigned long long const kIntPow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+        10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+        100000000000ull, 1000000000000ull };
+
+    template <typename UINT>
+    char *
+    formatUnsigned(char * dst, UINT value) {
+
+        char   digits[20];
+        char * d = digits + sizeof(digits);
+
+        while (value >= 100) {
+            UINT pair = (value % 100) * 2;
+            value /= 100;
+            *--d = kDigitPairs[pair + 1];
+            *--d = kDigitPairs[pair];
+        }
+        if (value >= 10) {
+            *--d = kDigitPairs[value * 2 + 1];
+            *--d = kDigitPairs[value * 2];
+        } else {
+            *--d = (char) ('0' + value);
+        }
+
+        size_t length = digits + sizeof(digits) - d;
+        std::memcpy(dst, d, length);
+        return dst + length;
+    }
+
+    //  Format digits / 10^decimals -- the fraction padded to all decimals:
+    char *
+    formatDecimal(char * dst, unsigned long long digits, int decimals) {
+
+        if (decimals == 0) return formatUnsigned(dst, digits);
+
+        //  32-bit arithmetic (faster) is used where values fit -- the
+        //  fraction has more than 9 digits only in FormatShortest():
+        unsigned long long scale = kIntPow10[decimals];
+        unsigned long long whole = digits / scale;
+        dst = (whole < 4294967296ull) ? formatUnsigned(dst, (unsigned int) whole)
+                                      : formatUnsigned(dst, whole);
+        *dst++ = '.';
+
+        unsigned long long fraction = digits % scale;
+        int i = decimals;
+        for ( ; i > 9; --i) {
+            dst[i - 1] = (char) ('0' + fraction % 10);
+            fraction /= 10;
+        }
+        unsigned int fraction32 = (unsigned int) fraction;
+        for ( ; i >= 2; i -= 2) {
+            unsigned int pair = (fraction32 % 100) * 2;
+            fraction32 /= 100;
+            dst[i - 1] = kDigitPairs[pair + 1];
+            dst[i - 2] = kDigitPairs[pair];
+        }
+        if (i == 1) {
+            dst[0] = (char) ('0' + fraction32);
+        }
+        return dst + decimals;
+    }
+
+    //  Round to the nearest integer (ties to even) for 0 <= x < 2^52 --
+    //  without the function call of std::nearbyint():
+    inline double
+    roundToInteger(double x) {
+        double const kTwo52 = 4503599627370496.0;
+        return (x + kTwo52) - kTwo52;
+    }
+
+    char *
+    formatPrintf(char * dst, char const * format, int precision, float value) {
+
+        int length = snprintf(dst, kMaxNumberLength, format, precision,
+                              (double) value);
+        return dst + std::max(0, std::min(length, kMaxNumberLength - 1));
+    }
+}
+
+char *
+FormatInt(char * dst, long long value) {
+
+    unsigned long long magnitude = (unsigned long long) value;
+    if (value < 0) {
+        *dst++ = '-';
+        magnitude = 0ull - magnitude;
+    }
+    return (magnitude < 4294967296ull) ? formatUnsigned(dst, (unsigned int) magnitude)
+                                       : formatUnsigned(dst, magnitude);
+}
+
+//
+//  The product of a float (24 bits of precision) and 10^N for N <= 9 is
+//  exact in double, so rounding it to an integer rounds the exact decimal
+//  value as printf does:
+//
+char *
+FormatFixed(char * dst, float value, int precision) {
+
+    if ((precision < 0) || (precision > 9) || !(std::abs(value) < 1.0e9f)) {
+        return formatPrintf(dst, "%.*f", precision, value);
+    }
+
+    if (std::signbit(value)) *dst++ = '-';
+
+    double scaled = (double) std::abs(value) * kPow10[precision];
+
+    return formatDecimal(dst, (unsigned long long) roundToInteger(scaled),
+                         precision);
+}
+
+//
+//  The shortest decimal is found by rounding the value to an increasing
+//  number of significant digits until the result is within half a unit in
+//  the last place of the float (the interval that reads back as the same
+//  float).  For the range handled here the scaled value and the tests are
+//  exact in double -- 10^12 needs 28 bits beyond the 24 of the float:
+//
+char *
+FormatShortest(char * dst, float value) {
+
+    if (value == 0.0f) {
+        if (std::signbit(value)) *dst++ = '-';
+        *dst++ = '0';
+        return dst;
+    }
+
+    float a = std::abs(value);
+    if ((a >= 1.0e-4f) && (a < 1.0e7f)) {
+        double ad = a;
+
+        //  Half the distance to the neighboring floats (closer below a
+        //  power of 2) and whether ties round to this float:
+        int exponent;
+        double mantissa = std::frexp(ad, &exponent);
+        double halfUp   = std::ldexp(1.0, exponent - 25);
+        double halfDown = (mantissa == 0.5) ? (halfUp * 0.5) : halfUp;
+
+        unsigned int bits;
+        std::memcpy(&bits, &a, sizeof(bits));
+        bool isEven = (bits & 1) == 0;
+
+        int e10 = (int) std::floor(std::log10(ad));
+
+        for (int n = 1; n <= 9; ++n) {
+            int decimals = n - 1 - e10;
+
+            double candidate, diff, half;
+            if (decimals >= 0) {
+                double scaled = ad * kPow10[decimals];
+                candidate = roundToInteger(scaled);
+                diff = candidate - scaled;
+                half = ((diff < 0.0) ? halfDown : halfUp) * kPow10[decimals];
+            } else {
+                double scale = kPow10[-decimals];
+                candidate = roundToInteger(ad / scale) * scale;
+                diff = candidate - ad;
+                half = (diff < 0.0) ? halfDown : halfUp;
+                decimals = 0;
+            }
+
+            if ((std::abs(diff) < half) || ((std::abs(diff) == half) && isEven)) {
+                unsigned long long digits = (unsigned long long) candidate;
+
+                //  Trailing zeros of the fraction are not needed:
+                while ((decimals > 0) && (digits % 10 == 0)) {
+                    digits /= 10;
+                    --decimals;
+                }
+                if (std::signbit(value)) *dst++ = '-';
+                return formatDecimal(dst, digits, decimals);
+            }
+        }
+    }
+
+    //  Outside of the range above, take the first precision that reads
+    //  back the same (9 digits always do):
+    char * end = dst;
+    for (int precision = 1; precision <= 9; ++precision) {
+        end = formatPrintf(dst, "%.*g", precision, value);
+        *end = 0;
+        if (std::strtof(dst, 0) == value) break;
+    }
+    return end;
+}
+
+//
+//  The value is rounded to N significant digits as in FormatFixed() --
+//  the decimals needed (N - 1 - exponent) must be within 0 and 12 for
+//  the scaled value to be exact -- and then written in fixed or exponent
+//  notation with trailing zeros removed, as printf chooses:
+//
+char *
+FormatGeneral(char * dst, float value, int precision) {
+
+    if (precision == 0) precision = 1;
+
+    if (value == 0.0f) {
+        if (std::signbit(value)) *dst++ = '-';
+        *dst++ = '0';
+        return dst;
+    }
+
+    float a = std::abs(value);
+    if ((precision < 0) || (precision > 9) || !(a < 1.0e9f)) {
+        return formatPrintf(dst, "%.*g", precision, value);
+    }
+
+    double ad = a;
+    int    e10 = (int) std::floor(std::log10(ad));
+
+    //  Correct an exponent from log10() that is off by one:
+    double lower = (double) kIntPow10[precision - 1];
+    double upper = (double) kIntPow10[precision];
+    double scaled;
+    for (;;) {
+        int decimals = precision - 1 - e10;
+        if ((decimals < 0) || (decimals > 12)) {
+            return formatPrintf(dst, "%.*g", precision, value);
+        }
+        scaled = ad * kPow10[decimals];
+        if (scaled >= upper) {
+            ++e10;
+        } else if (scaled < lower) {
+            --e10;
+        } else {
+            break;
+        }
+    }
+
+    unsigned long long digits = (unsigned long long) roundToInteger(scaled);
+    if (digits == kIntPow10[precision]) {
+        digits /= 10;
+        ++e10;
+    }
+
+    //  Trailing zeros are not written in either notation:
+    int numDigits = precision;
+    while ((numDigits > 1) && (digits % 10 == 0)) {
+        digits /= 10;
+        --numDigits;
+    }
+
+    if (std::signbit(value)) *dst++ = '-';
+
+    if ((e10 >= -4) && (e10 < precision)) {
+        int decimals = numDigits - 1 - e10;
+        if (decimals >= 0) {
+            return formatDecimal(dst, digits, decimals);
+        }
+        dst = formatUnsigned(dst, digits);
+        for ( ; decimals < 0; ++decimals) *dst++ = '0';
+        return dst;
+    }
+
+    dst = formatDecimal(dst, digits, numDigits - 1);
+    *dst++ = 'e';
+    *dst++ = (e10 < 0) ? '-' : '+';
+    unsigned int magnitude = (unsigned int) std::abs(e10);
+    if (magnitude < 10) *dst++ = '0';
+    return formatUnsigned(dst, magnitude);
+}
+
+//
+//  Definitions of FormatBuffer methods:
+//
+FormatBuffer::FormatBuffer(FILE * fptr, size_t capacity) :
+        _fptr(fptr), _stream(0),
+        _text(std::max(capacity, (size_t) kMaxNumberLength)), _size(0) {
+}
+
+FormatBuffer::FormatBuffer(std::ostream & stream, size_t capacity) :
+        _fptr(0), _stream(&stream),
+        _text(std::max(capacity, (size_t) kMaxNumberLength)), _size(0) {
+}
+
+FormatBuffer::~FormatBuffer() {
+
+    Flush();
+}
+
+void
+FormatBuffer::makeRoom(size_t size) {
+
+    Flush();
+    if (_size + size > _text.size()) {
+        _text.resize(std::max(2 * _text.size(), _size + size));
+    }
+}
+
+void
+FormatBuffer::Append(char const * text, size_t length) {
+
+    char * s = Reserve(length);
+    std::memcpy(s, text, length);
+    Commit(s + length);
+}
+
+void
+FormatBuffer::Append(char const * text) {
+
+    Append(text, std::strlen(text));
+}
+
+void
+FormatBuffer::Flush() {
+
+    if (_size == 0) return;
+
+    if (_fptr) {
+        fwrite(&_text[0], 1, _size, _fptr);
+        _size = 0;
+    } else if (_stream) {
+        _stream->write(&_text[0], (std::streamsize) _size);
+        _size = 0;
+    }
+}
+
+} // end namespace
@@ -0,0 +1,103 @@
+#ifndef FAST_FORMAT_H
+#define FAST_FORMAT_H
+
+#include <cstddef>
+#include <cstdio>
+#include <iosfwd>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Formatting of numbers as text without printf.
+//
+//  Each function writes the text for a value at dst (no terminating null)
+//  and returns the end of the text written -- at most kMaxNumberLength
+//  characters.  Integers are formatted two digits at a time.  Floats are
+//  formatted as "%.Nf" or "%.Ng" (identical to printf, N <= 9) or as the
+//  shortest decimal that reads back as the same float.  Values outside the
+//  range handled directly (very large or small, infinite or NaN) fall back
+//  to snprintf.
+//
+int const kMaxNumberLength = 64;
+
+char * FormatInt(char * dst, long long value);
+
+char * FormatFixed(char * dst, float value, int precision = 6);
+
+char * FormatShortest(char * dst, float value);
+
+//  "%.Ng" -- also the default output of a float to a std::ostream (and so
+//  of boost::format("%1%")) when N = 6:
+char * FormatGeneral(char * dst, float value, int precision = 6);
+
+//
+//  Selection of the format of floats written by the classes below:
+//
+struct FloatFormat {
+    enum Mode { FIXED, SHORTEST };
+
+    FloatFormat(Mode m = FIXED, int p = 6) : mode(m), precision(p) { }
+
+    Mode mode;
+    int  precision;   // of FIXED
+};
+
+inline char *
+FormatFloat(char * dst, float value, FloatFormat const & format) {
+    return (format.mode == FloatFormat::SHORTEST)
+         ? FormatShortest(dst, value)
+         : FormatFixed(dst, value, format.precision);
+}
+
+//
+//  A buffer of text that is written to a FILE or std::ostream (when given)
+//  as it fills and when flushed or destroyed -- replacing one fprintf() or
+//  boost::format per value or line with one write per buffer.  Space is
+//  reserved for each line or value, the text formatted directly into the
+//  buffer and then committed:
+//
+//      char * s = buffer.Reserve(3 * kMaxNumberLength + 4);
+//      *s++ = 'v';
+//      ...
+//      buffer.Commit(s);
+//
+class FormatBuffer {
+public:
+    explicit FormatBuffer(FILE * fptr = 0, size_t capacity = 1 << 20);
+    explicit FormatBuffer(std::ostream & stream, size_t capacity = 1 << 20);
+    ~FormatBuffer();
+
+    //  Returns the position at which to write at least size characters:
+    char * Reserve(size_t size) {
+        if (_size + size > _text.size()) makeRoom(size);
+        return &_text[_size];
+    }
+    void Commit(char const * end) { _size = end - &_text[0]; }
+
+    //  Convenience methods for occasional text:
+    void Append(char const * text, size_t length);
+    void Append(char const * text);
+
+    //  Text not yet written (all of it without a FILE or stream):
+    char const * GetText() const { return _text.empty() ? 0 : &_text[0]; }
+    size_t       GetSize() const { return _size; }
+    void         Clear()         { _size = 0; }
+
+    //  Write all pending text to the FILE or stream (if any):
+    void Flush();
+
+private:
+    void makeRoom(size_t size);
+
+private:
+    FILE *            _fptr;
+    std::ostream *    _stream;
+    std::vector<char> _text;
+    size_t            _size;
+};
+
+} // end namespace
+
+#endif /* FAST_FORMAT_H */
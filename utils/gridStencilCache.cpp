@@ -0,0 +1,170 @@
+#include "gridStencilCache.h"
+
+#include <cassert>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+//
+//  Definitions of GridStencilCache methods:
+//
+bool
+GridStencilCache::Key::operator<(Key const & k) const {
+
+    if (paramType != k.paramType) return paramType < k.paramType;
+    if (faceSize != k.faceSize) return faceSize < k.faceSize;
+    if (numControlPoints != k.numControlPoints) {
+        return numControlPoints < k.numControlPoints;
+    }
+    return zeroWeightMask < k.zeroWeightMask;
+}
+
+GridStencilCache::GridStencilCache(int rows, int columns) :
+        _rows(rows), _columns(columns), _numHits(0), _numMisses(0) {
+
+    assert((rows > 1) && (columns > 1));
+}
+
+void
+GridStencilCache::GetGridCoord(int pointIndex, float uv[2]) const {
+
+    //  Deltas computed as in the per-point evaluation they replace so that
+    //  the same (u,v) locations are used:
+    float uDelta = 1.0 / (_rows - 1);
+    float vDelta = 1.0 / (_columns - 1);
+
+    uv[0] = (pointIndex / _columns) * uDelta;
+    uv[1] = (pointIndex % _columns) * vDelta;
+}
+
+void
+GridStencilCache::ComputeStencils(Surface const & surface,
+                                  GridStencils & stencils) const {
+
+    int numPoints        = GetNumPoints();
+    int numControlPoints = surface.GetNumControlPoints();
+
+    stencils.numPoints        = numPoints;
+    stencils.numControlPoints = numControlPoints;
+
+    stencils.P.resize(numPoints * numControlPoints);
+    stencils.Du.resize(numPoints * numControlPoints);
+    stencils.Dv.resize(numPoints * numControlPoints);
+
+    for (int i = 0; i < numPoints; ++i) {
+        float uv[2];
+        GetGridCoord(i, uv);
+
+        int row = i * numControlPoints;
+        surface.EvaluateStencil(uv, &stencils.P[row],
+                                    &stencils.Du[row],
+                                    &stencils.Dv[row]);
+    }
+}
+
+bool
+GridStencilCache::GetKey(Surface const & surface,
+                         std::vector<float> & centerStencil, Key & key) const {
+
+    if (!surface.IsValid() || !surface.IsRegular()) return false;
+
+    //
+    //  Identify the configuration from the zero weights of the stencil at
+    //  the center of the face (regular patches have at most 16 points):
+    //
+    Bfr::Parameterization param = surface.GetParameterization();
+
+    int numControlPoints = surface.GetNumControlPoints();
+
+    centerStencil.resize(numControlPoints);
+
+    float uvCenter[2];
+    param.GetCenterCoord(uvCenter);
+    surface.EvaluateStencil(uvCenter, centerStencil.data());
+
+    key.paramType        = (int) param.GetType();
+    key.faceSize         = param.GetFaceSize();
+    key.numControlPoints = numControlPoints;
+    key.zeroWeightMask   = 0;
+    for (int i = 0; (i < numControlPoints) && (i < 32); ++i) {
+        if (centerStencil[i] == 0.0f) key.zeroWeightMask |= (1u << i);
+    }
+    return true;
+}
+
+GridStencilCache::GridStencils const *
+GridStencilCache::FindStencils(Key const & key) {
+
+    std::map<Key, GridStencils>::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+        ++ _numHits;
+        return &it->second;
+    }
+    ++ _numMisses;
+    return 0;
+}
+
+GridStencilCache::GridStencils const *
+GridStencilCache::AddStencils(Key const & key, GridStencils & stencils) {
+
+    std::pair<std::map<Key, GridStencils>::iterator, bool> inserted =
+            _entries.insert(std::make_pair(key, GridStencils()));
+    if (inserted.second) {
+        GridStencils & entry = inserted.first->second;
+        entry.numPoints        = stencils.numPoints;
+        entry.numControlPoints = stencils.numControlPoints;
+        entry.P.swap(stencils.P);
+        entry.Du.swap(stencils.Du);
+        entry.Dv.swap(stencils.Dv);
+    }
+    return &inserted.first->second;
+}
+
+GridStencilCache::GridStencils const *
+GridStencilCache::GetStencils(Surface const & surface) {
+
+    Key key;
+    if (!GetKey(surface, _centerStencil, key)) return 0;
+
+    GridStencils const * stencils = FindStencils(key);
+    if (stencils == 0) {
+        GridStencils newStencils;
+        ComputeStencils(surface, newStencils);
+        stencils = AddStencils(key, newStencils);
+    }
+    return stencils;
+}
+
+//
+//  Apply the dense stencil matrices to the control points of a face:
+//
+void
+GridStencilCache::GridStencils::Apply(float const controlPoints[],
+        int pointSize, float outP[], float outDu[], float outDv[]) const {
+
+    float const * weights[3] = { P.data(), Du.data(), Dv.data() };
+    float *       results[3] = { outP, outDu, outDv };
+
+    for (int k = 0; k < 3; ++k) {
+        if (results[k] == 0) continue;
+
+        float const * W   = weights[k];
+        float *       dst = results[k];
+        for (int i = 0; i < numPoints; ++i, W += numControlPoints,
+                                            dst += pointSize) {
+            for (int j = 0; j < pointSize; ++j) {
+                dst[j] = 0.0f;
+            }
+            float const * cp = controlPoints;
+            for (int c = 0; c < numControlPoints; ++c, cp += pointSize) {
+                for (int j = 0; j < pointSize; ++j) {
+                    dst[j] += W[c] * cp[j];
+                }
+            }
+        }
+    }
+}
+
+} // end namespace
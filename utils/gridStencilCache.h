@@ -0,0 +1,114 @@
+#ifndef GRID_STENCIL_CACHE_H
+#define GRID_STENCIL_CACHE_H
+
+#include <opensubdiv/bfr/surface.h>
+
+#include <map>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Cache of limit stencils for a fixed grid of (u,v) samples.
+//
+//  The stencil weights of a regular Surface depend only on its patch type,
+//  the boundary mask of the patch and the (u,v) location -- not on the face
+//  it was created for.  So for a fixed grid, the weights for all grid points
+//  can be computed once per distinct regular configuration and evaluation
+//  of any regular face reduces to a small dense matrix multiply with the
+//  control points gathered for that face.
+//
+//  The boundary mask is not exposed by Bfr::Surface, so a configuration is
+//  identified by the pattern of zero weights in the stencil at the center
+//  of the face (phantom points of a boundary patch always get zero weight).
+//  This single stencil is evaluated per face (into a buffer reused by all
+//  faces) as the number of control points alone does not distinguish the
+//  boundaries of regular patches.
+//
+//  The cache is not thread-safe, but only the lookup and insertion of
+//  entries modify it -- keys and stencils can be computed concurrently
+//  (each thread with its own buffer), serializing only FindStencils() and
+//  AddStencils().  GetStencils() combines all steps for serial use.
+//
+class GridStencilCache {
+public:
+    typedef OpenSubdiv::Bfr::Surface<float> Surface;
+
+    //
+    //  Dense stencil matrices for all points of the grid -- row i holds the
+    //  weights of grid point i for each of the face's control points:
+    //
+    struct GridStencils {
+        int numPoints;
+        int numControlPoints;
+
+        std::vector<float> P;
+        std::vector<float> Du;
+        std::vector<float> Dv;
+
+        void Apply(float const controlPoints[], int pointSize,
+                   float P[], float Du[] = 0, float Dv[] = 0) const;
+    };
+
+    //
+    //  Identifies a regular configuration:
+    //
+    struct Key {
+        int          paramType;
+        int          faceSize;
+        int          numControlPoints;
+        unsigned int zeroWeightMask;
+
+        bool operator<(Key const & k) const;
+    };
+
+public:
+    GridStencilCache(int rows, int columns);
+
+    int GetNumRows() const    { return _rows; }
+    int GetNumColumns() const { return _columns; }
+    int GetNumPoints() const  { return _rows * _columns; }
+
+    //  Grid points are ordered with u varying slowest:
+    void GetGridCoord(int pointIndex, float uv[2]) const;
+
+    //  Return the stencils for a regular Surface, computing them the first
+    //  time the configuration is encountered (returns 0 if not regular):
+    GridStencils const * GetStencils(Surface const & surface);
+
+    //  Compute the key of a Surface from its stencil at the center of the
+    //  face, evaluated into the given buffer (returns false if not regular):
+    bool GetKey(Surface const & surface, std::vector<float> & centerStencil,
+                Key & key) const;
+
+    //  Return the stencils cached for a key (0 if not yet computed):
+    GridStencils const * FindStencils(Key const & key);
+
+    //  Compute the stencils of all grid points for a regular Surface:
+    void ComputeStencils(Surface const & surface, GridStencils & stencils) const;
+
+    //  Add the stencils computed for a key (taking their contents) -- the
+    //  stencils cached for the key are returned if already added:
+    GridStencils const * AddStencils(Key const & key, GridStencils & stencils);
+
+    int GetNumEntries() const { return (int)_entries.size(); }
+    int GetNumHits() const    { return _numHits; }
+    int GetNumMisses() const  { return _numMisses; }
+
+private:
+    int _rows;
+    int _columns;
+
+    std::map<Key, GridStencils> _entries;
+
+    //  Stencil at the center of each face, reused by GetStencils():
+    std::vector<float> _centerStencil;
+
+    int _numHits;
+    int _numMisses;
+};
+
+} // end namespace
+
+#endif /* GRID_STENCIL_CACHE_H */
@@ -0,0 +1,63 @@
+#include "linearPatch.h"
+
+#include <cassert>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+//
+//  Definitions of LinearPatch methods:
+//
+bool
+LinearPatch::IsLinearSurface(Surface const & surface) {
+
+    if (!surface.IsLinear()) return false;
+
+    Bfr::Parameterization::Type type = surface.GetParameterization().GetType();
+    if (type == Bfr::Parameterization::QUAD_SUBFACES) return false;
+
+    return surface.GetNumControlPoints() ==
+           ((type == Bfr::Parameterization::QUAD) ? 4 : 3);
+}
+
+void
+LinearPatch::Evaluate(Surface const & surface,
+                      float const meshPoints[], int pointSize,
+                      int numCoords, float const uv[], float P[]) {
+
+    assert(IsLinearSurface(surface));
+
+    Surface::Index corners[kMaxCorners];
+    int numCorners = surface.GetControlPointIndices(corners);
+
+    float const * P0 = meshPoints + pointSize * corners[0];
+    float const * P1 = meshPoints + pointSize * corners[1];
+    float const * P2 = meshPoints + pointSize * corners[2];
+
+    if (numCorners == 3) {
+        for (int i = 0; i < numCoords; ++i, uv += 2, P += pointSize) {
+            float u = uv[0];
+            float v = uv[1];
+            float w = 1.0f - u - v;
+            for (int k = 0; k < pointSize; ++k) {
+                P[k] = w * P0[k] + u * P1[k] + v * P2[k];
+            }
+        }
+    } else {
+        float const * P3 = meshPoints + pointSize * corners[3];
+
+        for (int i = 0; i < numCoords; ++i, uv += 2, P += pointSize) {
+            float u = uv[0];
+            float v = uv[1];
+            for (int k = 0; k < pointSize; ++k) {
+                float bottom = P0[k] + u * (P1[k] - P0[k]);
+                float top    = P3[k] + u * (P2[k] - P3[k]);
+                P[k] = bottom + v * (top - bottom);
+            }
+        }
+    }
+}
+
+} // end namespace
@@ -0,0 +1,39 @@
+#ifndef LINEAR_PATCH_H
+#define LINEAR_PATCH_H
+
+#include <opensubdiv/bfr/surface.h>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Direct evaluation of linear Surfaces of quads and triangles.
+//
+//  Face-varying data is often interpolated linearly (e.g. UVs with
+//  FVAR_LINEAR_ALL, or faces of the bilinear scheme), in which case the
+//  Surface of a quad or triangle is simply the bilinear or barycentric
+//  interpolation of the values at its corners.  These are evaluated here
+//  directly from the data of the mesh -- without patch points and without
+//  going through Surface::Evaluate() for each coordinate.  Linear Surfaces
+//  of other faces (parameterized by sub-faces) are not supported.
+//
+class LinearPatch {
+public:
+    typedef OpenSubdiv::Bfr::Surface<float> Surface;
+
+    static int const kMaxCorners = 4;
+
+    //  Returns true if the Surface is linear with a control point for
+    //  each corner of a quad or triangle:
+    static bool IsLinearSurface(Surface const & surface);
+
+    //  Evaluate numCoords interleaved (u,v) coordinates of a linear Surface
+    //  with the points of the mesh (of the given size) it refers to:
+    static void Evaluate(Surface const & surface,
+                         float const meshPoints[], int pointSize,
+                         int numCoords, float const uv[], float P[]);
+};
+
+} // end namespace
+
+#endif /* LINEAR_PATCH_H */
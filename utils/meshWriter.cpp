@@ -0,0 +1,410 @@
+#include "meshWriter.h"
+#include "objWriter.h"
+#include "quantization.h"
+#include "vertexNormals.h"
+
+#include <cassert>
+#include <cstring>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    char const kRawTag[8]          = { 'O', 'S', 'D', 'Q', 'M', 'S', 'H', '1' };
+    char const kRawQuantizedTag[8] = { 'O', 'S', 'D', 'Q', 'M', 'S', 'H', '2' };
+
+    bool
+    hasExtension(std::string const & filename, char const * extension) {
+        size_t length = std::strlen(extension);
+        return (filename.size() > length) &&
+               (filename.compare(filename.size() - length, length, extension) == 0);
+    }
+
+    template <typename T>
+    bool
+    writeArray(FILE * fptr, std::vector<T> const & v) {
+        return v.empty() || (fwrite(v.data(), sizeof(T), v.size(), fptr) == v.size());
+    }
+
+    bool
+    writeBytes(FILE * fptr, void const * data, size_t size) {
+        return fwrite(data, 1, size, fptr) == size;
+    }
+
+    //  Close the file, reporting any failure writing to it (including
+    //  errors of the stream, e.g. of fprintf()):
+    bool
+    closeFile(FILE * fptr, bool success, char const * writerName,
+              std::string const & filename) {
+        success = !ferror(fptr) && success;
+        success = (fclose(fptr) == 0) && success;
+        if (!success) {
+            fprintf(stderr, "Error:  %s failed writing file '%s'\n",
+                writerName, filename.c_str());
+        }
+        return success;
+    }
+}
+
+MeshWriter *
+MeshWriter::Create(std::string const & filename) {
+
+    if (hasExtension(filename, ".ply")) {
+        return new PlyWriter(filename);
+    } else if (hasExtension(filename, ".raw")) {
+        return new RawMeshWriter(filename);
+    } else {
+        return new ObjWriter(filename);
+    }
+}
+
+void
+MeshWriter::WriteVertexNormals(std::vector<float> const & du,
+                               std::vector<float> const & dv) {
+
+    assert(du.size() == dv.size());
+    int numNewNormals = (int)du.size() / 3;
+
+    _derivNormals.resize(du.size());
+    ComputeVertexNormals(numNewNormals, du.data(), dv.data(), _derivNormals.data());
+    WriteVertexNormals(_derivNormals);
+}
+
+//
+//  Definitions of BinaryMeshWriter methods:
+//
+BinaryMeshWriter::BinaryMeshWriter(std::string const & filename) :
+        _filename(filename), _closed(false) {
+}
+
+void
+BinaryMeshWriter::releaseArrays() {
+
+    std::vector<float>().swap(_positions);
+    std::vector<float>().swap(_normals);
+    std::vector<float>().swap(_uvs);
+    std::vector<int>().swap(_faceSizes);
+    std::vector<int>().swap(_faceVertices);
+    std::vector<int>().swap(_faceUVs);
+}
+
+void
+BinaryMeshWriter::WriteVertexPositions(std::vector<float> const & pos, int dim) {
+
+    int numNewVerts = (int)pos.size() / dim;
+
+    if (dim == 3) {
+        _positions.insert(_positions.end(), pos.begin(), pos.end());
+    } else {
+        size_t base = _positions.size();
+        _positions.resize(base + 3 * numNewVerts, 0.0f);
+        for (int i = 0; i < numNewVerts; ++i) {
+            _positions[base + 3 * i    ] = pos[dim * i];
+            _positions[base + 3 * i + 1] = pos[dim * i + 1];
+            if (dim > 2) _positions[base + 3 * i + 2] = pos[dim * i + 2];
+        }
+    }
+    _numVertices += numNewVerts;
+}
+
+void
+BinaryMeshWriter::WriteVertexNormals(std::vector<float> const & normals) {
+
+    _normals.insert(_normals.end(), normals.begin(), normals.end());
+    _numNormals += (int)normals.size() / 3;
+}
+
+void
+BinaryMeshWriter::WriteVertexUVs(std::vector<float> const & uv) {
+
+    _uvs.insert(_uvs.end(), uv.begin(), uv.end());
+    _numUVs += (int)uv.size() / 2;
+}
+
+void
+BinaryMeshWriter::WriteFaces(std::vector<int> const & faceVertices, int faceSize,
+                             bool, bool) {
+
+    int numNewFaces = (int)faceVertices.size() / faceSize;
+
+    int const * v = &faceVertices[0];
+    for (int i = 0; i < numNewFaces; ++i, v += faceSize) {
+        int size = 0;
+        for (int j = 0; j < faceSize; ++j) {
+            if (v[j] >= 0) {
+                _faceVertices.push_back(v[j]);
+                if (!_faceUVs.empty()) _faceUVs.push_back(v[j]);
+                ++ size;
+            }
+        }
+        _faceSizes.push_back(size);
+    }
+    _numFaces += numNewFaces;
+}
+
+void
+BinaryMeshWriter::WriteFaces(std::vector<int> const & faceVertices,
+                             std::vector<int> const & faceUVs, int faceSize,
+                             bool) {
+
+    //  UV indices of faces written previously are those of their vertices:
+    if (_faceUVs.size() < _faceVertices.size()) {
+        _faceUVs = _faceVertices;
+    }
+
+    int numNewFaces = (int)faceVertices.size() / faceSize;
+
+    int const * v  = &faceVertices[0];
+    int const * vt = &faceUVs[0];
+    for (int i = 0; i < numNewFaces; ++i, v += faceSize, vt += faceSize) {
+        int size = 0;
+        for (int j = 0; j < faceSize; ++j) {
+            if (v[j] >= 0) {
+                _faceVertices.push_back(v[j]);
+                _faceUVs.push_back(vt[j]);
+                ++ size;
+            }
+        }
+        _faceSizes.push_back(size);
+    }
+    _numFaces += numNewFaces;
+}
+
+bool
+BinaryMeshWriter::hasVertexNormals() const {
+
+    return !_normals.empty() && (_normals.size() == _positions.size());
+}
+
+bool
+BinaryMeshWriter::hasVertexUVs() const {
+
+    return !_uvs.empty() && _faceUVs.empty() &&
+           (_uvs.size() / 2 == _positions.size() / 3);
+}
+
+//
+//  Definitions of PlyWriter methods:
+//
+//  Binary data is written in the byte order of the host, which is assumed
+//  to be little-endian (as are all platforms these tutorials target):
+//
+PlyWriter::~PlyWriter() {
+
+    if (!_closed) Close();
+}
+
+bool
+PlyWriter::Close() {
+
+    if (_closed) return true;
+    _closed = true;
+
+    FILE * fptr = fopen(_filename.c_str(), "wb");
+    if (fptr == 0) {
+        fprintf(stderr, "Error:  PlyWriter cannot open PLY file '%s'\n",
+            _filename.c_str());
+        releaseArrays();
+        return false;
+    }
+
+    bool writeNormals   = hasVertexNormals();
+    bool writeVertexUVs = hasVertexUVs();
+    bool writeCornerUVs = !_uvs.empty() && !_faceUVs.empty();
+
+    //  Normals and UVs (without their own indices) are properties of the
+    //  vertices, so those not matching the vertices cannot be written:
+    bool complete = true;
+    if (!_normals.empty() && !writeNormals) {
+        fprintf(stderr, "Error:  PlyWriter cannot write %d normals for %d "
+            "vertices to '%s'\n", (int)_normals.size() / 3,
+            (int)_positions.size() / 3, _filename.c_str());
+        complete = false;
+    }
+    if (!_uvs.empty() && !writeVertexUVs && !writeCornerUVs) {
+        fprintf(stderr, "Error:  PlyWriter cannot write %d UVs for %d "
+            "vertices to '%s'\n", (int)_uvs.size() / 2,
+            (int)_positions.size() / 3, _filename.c_str());
+        complete = false;
+    }
+
+    bool success = true;
+
+    int numVertices = (int)_positions.size() / 3;
+    int numFaces    = (int)_faceSizes.size();
+
+    fprintf(fptr, "ply\n"
+                  "format binary_little_endian 1.0\n"
+                  "element vertex %d\n"
+                  "property float x\n"
+                  "property float y\n"
+                  "property float z\n", numVertices);
+    if (writeNormals) {
+        fprintf(fptr, "property float nx\n"
+                      "property float ny\n"
+                      "property float nz\n");
+    }
+    if (writeVertexUVs) {
+        fprintf(fptr, "property float u\n"
+                      "property float v\n");
+    }
+    fprintf(fptr, "element face %d\n"
+                  "property list uchar int vertex_indices\n", numFaces);
+    if (writeCornerUVs) {
+        fprintf(fptr, "property list uchar float texcoord\n");
+    }
+    fprintf(fptr, "end_header\n");
+
+    //
+    //  Interleave the vertex properties and face lists through a buffer:
+    //
+    std::vector<char> buffer;
+    buffer.reserve(1 << 20);
+
+    for (int i = 0; i < numVertices; ++i) {
+        char const * P  = (char const *) &_positions[3 * i];
+        buffer.insert(buffer.end(), P, P + 3 * sizeof(float));
+        if (writeNormals) {
+            char const * N = (char const *) &_normals[3 * i];
+            buffer.insert(buffer.end(), N, N + 3 * sizeof(float));
+        }
+        if (writeVertexUVs) {
+            char const * UV = (char const *) &_uvs[2 * i];
+            buffer.insert(buffer.end(), UV, UV + 2 * sizeof(float));
+        }
+        if (buffer.size() >= (1 << 20)) {
+            success = writeBytes(fptr, buffer.data(), buffer.size()) && success;
+            buffer.clear();
+        }
+    }
+
+    int const * v  = _faceVertices.data();
+    int const * vt = _faceUVs.data();
+    for (int i = 0; i < numFaces; ++i) {
+        int size = _faceSizes[i];
+
+        buffer.push_back((char)(unsigned char) size);
+        char const * V = (char const *) v;
+        buffer.insert(buffer.end(), V, V + size * sizeof(int));
+        v += size;
+
+        if (writeCornerUVs) {
+            buffer.push_back((char)(unsigned char)(2 * size));
+            for (int j = 0; j < size; ++j, ++vt) {
+                char const * UV = (char const *) &_uvs[2 * *vt];
+                buffer.insert(buffer.end(), UV, UV + 2 * sizeof(float));
+            }
+        }
+        if (buffer.size() >= (1 << 20)) {
+            success = writeBytes(fptr, buffer.data(), buffer.size()) && success;
+            buffer.clear();
+        }
+    }
+    success = writeBytes(fptr, buffer.data(), buffer.size()) && success;
+
+    releaseArrays();
+    return closeFile(fptr, success, "PlyWriter", _filename) && complete;
+}
+
+//
+//  Definitions of RawMeshWriter methods:
+//
+RawMeshWriter::~RawMeshWriter() {
+
+    if (!_closed) Close();
+}
+
+bool
+RawMeshWriter::Close() {
+
+    if (_closed) return true;
+    _closed = true;
+
+    FILE * fptr = fopen(_filename.c_str(), "wb");
+    if (fptr == 0) {
+        fprintf(stderr, "Error:  RawMeshWriter cannot open file '%s'\n",
+            _filename.c_str());
+        releaseArrays();
+        return false;
+    }
+
+    bool success = true;
+
+    int sizes[6] = { (int)_positions.size() / 3,
+                     (int)_normals.size() / 3,
+                     (int)_uvs.size() / 2,
+                     (int)_faceSizes.size(),
+                     (int)_faceVertices.size(),
+                     (int)_faceUVs.size() };
+
+    if (_quantization == 0) {
+        success = writeBytes(fptr, kRawTag, sizeof(kRawTag)) &&
+                  writeBytes(fptr, sizes, sizeof(sizes)) &&
+                  writeArray(fptr, _positions) &&
+                  writeArray(fptr, _normals) &&
+                  writeArray(fptr, _uvs);
+    } else {
+        bool quantizePositions = (_quantization & QUANTIZE_POSITIONS) != 0;
+        bool quantizeNormals   = (_quantization & QUANTIZE_NORMALS) != 0;
+        bool quantizeUVs       = (_quantization & QUANTIZE_UVS) != 0;
+
+        QuantizationBox box;
+        if (quantizePositions) {
+            box = QuantizationBox::Bound(sizes[0], _positions.data());
+        }
+        float boxValues[6] = { box.min[0], box.min[1], box.min[2],
+                               box.extent[0], box.extent[1], box.extent[2] };
+
+        success = writeBytes(fptr, kRawQuantizedTag, sizeof(kRawQuantizedTag)) &&
+                  writeBytes(fptr, sizes, sizeof(sizes)) &&
+                  writeBytes(fptr, &_quantization, sizeof(int)) &&
+                  writeBytes(fptr, boxValues, sizeof(boxValues));
+
+        if (quantizePositions) {
+            std::vector<unsigned short> encoded(_positions.size());
+            EncodePositions(sizes[0], _positions.data(), box, encoded.data());
+            success = writeArray(fptr, encoded) && success;
+
+            fprintf(stderr, "RawMeshWriter:  positions quantized -- "
+                "max error %g (bound %g)\n",
+                MeasurePositionError(sizes[0], _positions.data(), box, encoded.data()),
+                box.GetErrorBound());
+        } else {
+            success = writeArray(fptr, _positions) && success;
+        }
+
+        if (quantizeNormals) {
+            std::vector<short> encoded(2 * sizes[1]);
+            EncodeOctNormals(sizes[1], _normals.data(), encoded.data());
+            success = writeArray(fptr, encoded) && success;
+
+            fprintf(stderr, "RawMeshWriter:  normals quantized -- "
+                "max error %g radians (bound %g)\n",
+                MeasureOctNormalError(sizes[1], _normals.data(), encoded.data()),
+                GetOctNormalErrorBound());
+        } else {
+            success = writeArray(fptr, _normals) && success;
+        }
+
+        if (quantizeUVs) {
+            std::vector<unsigned short> encoded(_uvs.size());
+            EncodeUnormUVs(sizes[2], _uvs.data(), encoded.data());
+            success = writeArray(fptr, encoded) && success;
+
+            fprintf(stderr, "RawMeshWriter:  UVs quantized -- "
+                "max error %g (bound %g within [0, 1])\n",
+                MeasureUnormUVError(sizes[2], _uvs.data(), encoded.data()),
+                GetUnormUVErrorBound());
+        } else {
+            success = writeArray(fptr, _uvs) && success;
+        }
+    }
+    success = writeArray(fptr, _faceSizes) &&
+              writeArray(fptr, _faceVertices) &&
+              writeArray(fptr, _faceUVs) && success;
+
+    releaseArrays();
+    return closeFile(fptr, success, "RawMeshWriter", _filename);
+}
+
+} // end namespace
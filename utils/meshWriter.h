@@ -0,0 +1,185 @@
+#ifndef MESH_WRITER_H
+#define MESH_WRITER_H
+
+#include "fastFormat.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Interface of the writers of tessellated meshes -- the methods of the
+//  original ObjWriter.  Create() chooses the writer from the extension of
+//  the file name:
+//
+//      ".ply"  binary little-endian PLY (PlyWriter)
+//      ".raw"  raw float and int32 arrays (RawMeshWriter)
+//      other   Obj (ObjWriter -- stdout with no file name)
+//
+//  As in Obj files, face indices refer to all vertices (or UVs) written
+//  so far, and negative indices (e.g. of triangles in a tessellation of
+//  quads) are ignored.
+//
+class MeshWriter {
+public:
+    virtual ~MeshWriter() { }
+
+    //  Returns a new writer for the file (to be deleted by the caller):
+    static MeshWriter * Create(std::string const & filename);
+
+    int GetNumVertices() const { return _numVertices; }
+    int GetNumFaces()    const { return _numFaces; }
+    int GetNumUVs()      const { return _numUVs; }
+
+    //  Format of floats written as text (ignored by binary writers):
+    virtual void SetFloatFormat(FloatFormat const &) { }
+
+    //  Threads formatting large arrays as text (ignored by binary writers),
+    //  0 for all hardware threads and 1 (the default) for none:
+    virtual void SetNumThreads(int) { }
+
+    //  Attributes to write in the compact encodings of quantization.h --
+    //  QuantizationFlags combined (ignored by all but RawMeshWriter):
+    virtual void SetQuantization(int) { }
+
+    virtual void WriteVertexPositions(std::vector<float> const & p,
+                                      int size = 3) = 0;
+    //  Unit normals (3 per vertex) computed once by the caller (e.g. with
+    //  ComputeVertexNormals()) or from the derivatives of the vertices:
+    virtual void WriteVertexNormals(std::vector<float> const & normals) = 0;
+    void WriteVertexNormals(std::vector<float> const & du,
+                            std::vector<float> const & dv);
+    virtual void WriteVertexUVs(std::vector<float> const & uv) = 0;
+
+    virtual void WriteFaces(std::vector<int> const & faceVertices,
+                            int faceSize,
+                            bool writeNormalIndices = false,
+                            bool writeUVIndices = false) = 0;
+
+    //  Faces with UV indices distinct from those of positions (and normals):
+    virtual void WriteFaces(std::vector<int> const & faceVertices,
+                            std::vector<int> const & faceUVs, int faceSize,
+                            bool writeNormalIndices = false) = 0;
+
+    virtual void WriteGroupName(char const * prefix, int index) = 0;
+
+    //  Write any output pending and close the file -- returns false (with
+    //  a message) on failure.  Nothing is to be written after closing, and
+    //  writers not closed are closed when destroyed (ignoring failure):
+    virtual bool Close() = 0;
+
+protected:
+    MeshWriter() : _numVertices(0), _numNormals(0), _numUVs(0), _numFaces(0) { }
+
+protected:
+    int _numVertices;
+    int _numNormals;
+    int _numUVs;
+    int _numFaces;
+
+private:
+    std::vector<float> _derivNormals;   // normals of the derivatives given
+};
+
+//
+//  The binary writers accumulate the mesh in memory (appending to arrays
+//  as it is given) and write it when closed, as the headers of their
+//  files need the final sizes.  The arrays are released once written:
+//
+class BinaryMeshWriter : public MeshWriter {
+public:
+    using MeshWriter::WriteVertexNormals;
+
+    virtual void WriteVertexPositions(std::vector<float> const & p, int size = 3);
+    virtual void WriteVertexNormals(std::vector<float> const & normals);
+    virtual void WriteVertexUVs(std::vector<float> const & uv);
+
+    virtual void WriteFaces(std::vector<int> const & faceVertices, int faceSize,
+                            bool writeNormalIndices = false,
+                            bool writeUVIndices = false);
+    virtual void WriteFaces(std::vector<int> const & faceVertices,
+                            std::vector<int> const & faceUVs, int faceSize,
+                            bool writeNormalIndices = false);
+
+    //  Groups are not supported by the binary formats:
+    virtual void WriteGroupName(char const *, int) { }
+
+protected:
+    BinaryMeshWriter(std::string const & filename);
+
+    bool hasVertexNormals() const;
+    bool hasVertexUVs() const;
+
+    void releaseArrays();
+
+protected:
+    std::string _filename;
+    bool        _closed;
+
+    std::vector<float> _positions;   // 3 per vertex
+    std::vector<float> _normals;     // 3 per normal
+    std::vector<float> _uvs;         // 2 per UV
+
+    std::vector<int>   _faceSizes;
+    std::vector<int>   _faceVertices;
+    std::vector<int>   _faceUVs;     // for faces with distinct UV indices
+};
+
+//
+//  Binary little-endian PLY:  normals and UVs are properties of the
+//  vertices when there is one for each vertex, and UVs with indices
+//  distinct from the vertices are written per face corner as a
+//  "texcoord" list.  Normals or UVs of a count not matching the vertices
+//  cannot be written, which is reported as a failure:
+//
+class PlyWriter : public BinaryMeshWriter {
+public:
+    PlyWriter(std::string const & filename) : BinaryMeshWriter(filename) { }
+    virtual ~PlyWriter();
+
+    virtual bool Close();
+};
+
+//
+//  Raw arrays preceded by their sizes:
+//
+//      char[8]   "OSDQMSH1"
+//      int32[6]  numVertices, numNormals, numUVs, numFaces,
+//                numFaceVertices, numFaceUVs (0 or numFaceVertices)
+//      float[3 * numVertices], float[3 * numNormals], float[2 * numUVs]
+//      int32[numFaces]           size of each face
+//      int32[numFaceVertices]    vertex indices of all faces
+//      int32[numFaceUVs]         UV indices of all faces
+//
+//  With quantization, the tag is "OSDQMSH2" and the sizes are followed by
+//  the flags and the box of the positions, the quantized arrays replacing
+//  those of floats (the int32 arrays that follow are then unaligned):
+//
+//      int32     flags (QuantizationFlags)
+//      float[6]  min and extent of the box (zero if not quantized)
+//      uint16[3 * numVertices]   QUANTIZE_POSITIONS -- DecodePositions()
+//      int16[2 * numNormals]     QUANTIZE_NORMALS   -- DecodeOctNormals()
+//      uint16[2 * numUVs]        QUANTIZE_UVS       -- DecodeUnormUVs()
+//
+//  The largest error of each quantized array is reported with its bound.
+//
+class RawMeshWriter : public BinaryMeshWriter {
+public:
+    RawMeshWriter(std::string const & filename) :
+        BinaryMeshWriter(filename), _quantization(0) { }
+    virtual ~RawMeshWriter();
+
+    virtual void SetQuantization(int flags) { _quantization = flags; }
+
+    virtual bool Close();
+
+private:
+    int _quantization;
+};
+
+} // end namespace
+
+#endif /* MESH_WRITER_H */
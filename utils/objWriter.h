@@ -22,172 +22,298 @@
 //   language governing permissions and limitations under the Apache License.
 //
 
+#ifndef OBJ_WRITER_H
+#define OBJ_WRITER_H
+
 #include <string>
 #include <vector>
 #include <cstdio>
 #include <cmath>
 #include <cassert>
+#include <cstring>
+
+#include "fastFormat.h"
+#include "meshWriter.h"
+#include "parallelFormat.h"
 
 //  Utilities local to this tutorial:
 namespace tutorial {
 
 //
 //  Simple class to write vertex positions, normals and faces to a
-//  specified Obj file:
+//  specified Obj file.  Text is formatted without printf into a large
+//  buffer that is written as it fills.  Floats are written as "%f" by
+//  default or in the format assigned (e.g. the shortest that reads back
+//  the same float).  Large arrays can be formatted on several threads
+//  (see FormatInParallel()) -- the text written is the same.
 //
-class ObjWriter {
+//  Methods are defined inline so that the header can be included by more
+//  than one source (it is included by MeshWriter::Create()):
+//
+class ObjWriter : public MeshWriter {
 public:
     ObjWriter(std::string const &filename = 0);
-    ~ObjWriter();
+    virtual ~ObjWriter();
 
-    int GetNumVertices() const { return _numVertices; }
-    int GetNumFaces()    const { return _numFaces; }
+    virtual void SetFloatFormat(FloatFormat const & format) { _floatFormat = format; }
+    virtual void SetNumThreads(int numThreads) { _numThreads = numThreads; }
 
-    void WriteVertexPositions(std::vector<float> const & p, int size = 3);
-    void WriteVertexNormals(std::vector<float> const & du,
-                            std::vector<float> const & dv);
-    void WriteVertexUVs(std::vector<float> const & uv);
+    using MeshWriter::WriteVertexNormals;
 
-    void WriteFaces(std::vector<int> const & faceVertices, int faceSize,
-                    bool writeNormalIndices = false,
-                    bool writeUVIndices = false);
+    virtual void WriteVertexPositions(std::vector<float> const & p, int size = 3);
+    virtual void WriteVertexNormals(std::vector<float> const & normals);
+    virtual void WriteVertexUVs(std::vector<float> const & uv);
 
-    void WriteGroupName(char const * prefix, int index);
+    virtual void WriteFaces(std::vector<int> const & faceVertices, int faceSize,
+                            bool writeNormalIndices = false,
+                            bool writeUVIndices = false);
 
-private:
-    void getNormal(float N[3], float const du[3], float const dv[3]) const;
+    //  Faces with UV indices distinct from those of positions (and normals):
+    virtual void WriteFaces(std::vector<int> const & faceVertices,
+                            std::vector<int> const & faceUVs, int faceSize,
+                            bool writeNormalIndices = false);
+
+    virtual void WriteGroupName(char const * prefix, int index);
+
+    virtual bool Close();
 
 private:
-    std::string _filename;
-    FILE *      _fptr;
+    static FILE * openFile(std::string const & filename);
+
+    char * writeFloats(char * s, float const * values, int count) const;
 
-    int _numVertices;
-    int _numNormals;
-    int _numUVs;
-    int _numFaces;
+    template <class FUNC>
+    void formatItems(int count, FUNC const & formatRange) {
+        FormatInParallel(_buffer, count, formatRange, _numThreads);
+    }
+
+private:
+    std::string  _filename;
+    FILE *       _fptr;
+    FormatBuffer _buffer;
+    FloatFormat  _floatFormat;
+    int          _numThreads;
 };
 
 
 //
 //  Definitions ObjWriter methods:
 //
+inline
 ObjWriter::ObjWriter(std::string const &filename) :
-        _fptr(0), _numVertices(0), _numNormals(0), _numUVs(0), _numFaces(0) {
+        _filename(filename), _fptr(openFile(filename)), _buffer(_fptr),
+        _numThreads(1) {
+}
+
+inline
+ObjWriter::~ObjWriter() {
 
+    Close();
+}
+
+inline bool
+ObjWriter::Close() {
+
+    if (_fptr == 0) return true;
+
+    _buffer.Flush();
+
+    bool success = !ferror(_fptr);
+    if (_fptr == stdout) {
+        success = (fflush(_fptr) == 0) && success;
+    } else {
+        success = (fclose(_fptr) == 0) && success;
+    }
+    if (!success) {
+        fprintf(stderr, "Error:  ObjWriter failed writing Obj file '%s'\n",
+            _filename.c_str());
+    }
+    _fptr = 0;
+    return success;
+}
+
+inline FILE *
+ObjWriter::openFile(std::string const & filename) {
+
+    FILE * fptr = 0;
     if (filename != std::string()) {
-        _fptr = fopen(filename.c_str(), "w");
-        if (_fptr == 0) {
+        fptr = fopen(filename.c_str(), "w");
+        if (fptr == 0) {
             fprintf(stderr, "Error:  ObjWriter cannot open Obj file '%s'\n",
                 filename.c_str());
         }
     }
-    if (_fptr == 0) _fptr = stdout;
+    return fptr ? fptr : stdout;
 }
 
-ObjWriter::~ObjWriter() {
+//
+//  Write the values separated by spaces (each preceded by a space):
+//
+inline char *
+ObjWriter::writeFloats(char * s, float const * values, int count) const {
 
-    if (_fptr != stdout) fclose(_fptr);
+    for (int i = 0; i < count; ++i) {
+        *s++ = ' ';
+        s = FormatFloat(s, values[i], _floatFormat);
+    }
+    return s;
 }
 
-void
+inline void
 ObjWriter::WriteVertexPositions(std::vector<float> const & pos, int dim) {
 
     assert(dim >= 2);
     int numNewVerts = (int)pos.size() / dim;
 
-    float const * P = pos.data();
-    for (int i = 0; i < numNewVerts; ++i, P += dim) {
-        if (dim == 2) {
-            fprintf(_fptr, "v %f %f 0.0\n", P[0], P[1]);
-        } else {
-            fprintf(_fptr, "v %f %f %f\n", P[0], P[1], P[2]);
+    formatItems(numNewVerts, [&](FormatBuffer & buffer, int begin, int end) {
+        float const * P = pos.data() + (size_t)begin * dim;
+        for (int i = begin; i < end; ++i, P += dim) {
+            char * s = buffer.Reserve(3 * (kMaxNumberLength + 1) + 8);
+            *s++ = 'v';
+            if (dim == 2) {
+                s = writeFloats(s, P, 2);
+                std::memcpy(s, " 0.0", 4);
+                s += 4;
+            } else {
+                s = writeFloats(s, P, 3);
+            }
+            *s++ = '\n';
+            buffer.Commit(s);
         }
-    }
+    });
     _numVertices += numNewVerts;
 }
 
-void
-ObjWriter::getNormal(float N[3], float const du[3], float const dv[3]) const {
+inline void
+ObjWriter::WriteVertexNormals(std::vector<float> const & normals) {
 
-    N[0] = du[1] * dv[2] - du[2] * dv[1];
-    N[1] = du[2] * dv[0] - du[0] * dv[2];
-    N[2] = du[0] * dv[1] - du[1] * dv[0];
+    int numNewNormals = (int)normals.size() / 3;
 
-    float lenSqrd = N[0] * N[0] + N[1] * N[1] + N[2] * N[2];
-    if (lenSqrd <= 0.0f) {
-        N[0] = 0.0f;
-        N[1] = 0.0f;
-        N[2] = 0.0f;
-    } else {
-        float lenInv = 1.0f / std::sqrt(lenSqrd);
-        N[0] *= lenInv;
-        N[1] *= lenInv;
-        N[2] *= lenInv;
-    }
-}
-
-void
-ObjWriter::WriteVertexNormals(std::vector<float> const & du,
-                              std::vector<float> const & dv) {
-
-    assert(du.size() == dv.size());
-    int numNewNormals = (int)du.size() / 3;
-
-    float const * dPdu = &du[0];
-    float const * dPdv = &dv[0];
-    for (int i = 0; i < numNewNormals; ++i, dPdu += 3, dPdv += 3) {
-        float N[3];
-        getNormal(N, dPdu, dPdv);
-        fprintf(_fptr, "vn %f %f %f\n", N[0], N[1], N[2]);
-    }
+    formatItems(numNewNormals, [&](FormatBuffer & buffer, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            char * s = buffer.Reserve(3 * (kMaxNumberLength + 1) + 8);
+            *s++ = 'v';
+            *s++ = 'n';
+            s = writeFloats(s, &normals[i*3], 3);
+            *s++ = '\n';
+            buffer.Commit(s);
+        }
+    });
     _numNormals += numNewNormals;
 }
 
-void
+inline void
 ObjWriter::WriteVertexUVs(std::vector<float> const & uv) {
 
     int numNewUVs = (int)uv.size() / 2;
 
-    for (int i = 0; i < numNewUVs; ++i) {
-        fprintf(_fptr, "vt %f %f\n", uv[i*2], uv[i*2+1]);
-    }
+    formatItems(numNewUVs, [&](FormatBuffer & buffer, int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            char * s = buffer.Reserve(2 * (kMaxNumberLength + 1) + 8);
+            *s++ = 'v';
+            *s++ = 't';
+            s = writeFloats(s, &uv[i*2], 2);
+            *s++ = '\n';
+            buffer.Commit(s);
+        }
+    });
     _numUVs += numNewUVs;
 }
 
-void
+inline void
 ObjWriter::WriteFaces(std::vector<int> const & faceVertices, int faceSize,
                       bool includeNormalIndices, bool includeUVIndices) {
 
     int numNewFaces = (int)faceVertices.size() / faceSize;
 
-    int const * v = &faceVertices[0];
-    for (int i = 0; i < numNewFaces; ++i, v += faceSize) {
-        fprintf(_fptr, "f ");
-        for (int j = 0; j < faceSize; ++j) {
-            if (v[j] >= 0) {
-                //  Remember Obj indices start with 1:
-                int vIndex = 1 + v[j];
-
-                if (includeNormalIndices && includeUVIndices) {
-                    fprintf(_fptr, " %d/%d/%d", vIndex, vIndex, vIndex);
-                } else if (includeNormalIndices) {
-                    fprintf(_fptr, " %d//%d", vIndex, vIndex);
-                } else if (includeUVIndices) {
-                    fprintf(_fptr, " %d/%d", vIndex, vIndex);
-                } else {
-                    fprintf(_fptr, " %d", vIndex);
-                } 
+    formatItems(numNewFaces, [&](FormatBuffer & buffer, int begin, int end) {
+        int const * v = &faceVertices[(size_t)begin * faceSize];
+        for (int i = begin; i < end; ++i, v += faceSize) {
+            char * s = buffer.Reserve(faceSize * (3 * kMaxNumberLength + 4) + 4);
+            *s++ = 'f';
+            *s++ = ' ';
+            for (int j = 0; j < faceSize; ++j) {
+                if (v[j] >= 0) {
+                    //  Remember Obj indices start with 1:
+                    int vIndex = 1 + v[j];
+
+                    *s++ = ' ';
+                    s = FormatInt(s, vIndex);
+                    if (includeNormalIndices && includeUVIndices) {
+                        *s++ = '/';
+                        s = FormatInt(s, vIndex);
+                        *s++ = '/';
+                        s = FormatInt(s, vIndex);
+                    } else if (includeNormalIndices) {
+                        *s++ = '/';
+                        *s++ = '/';
+                        s = FormatInt(s, vIndex);
+                    } else if (includeUVIndices) {
+                        *s++ = '/';
+                        s = FormatInt(s, vIndex);
+                    }
+                }
             }
+            *s++ = '\n';
+            buffer.Commit(s);
         }
-        fprintf(_fptr, "\n");
-    }
+    });
+    _numFaces += numNewFaces;
+}
+
+inline void
+ObjWriter::WriteFaces(std::vector<int> const & faceVertices,
+                      std::vector<int> const & faceUVs, int faceSize,
+                      bool includeNormalIndices) {
+
+    assert(faceVertices.size() == faceUVs.size());
+    int numNewFaces = (int)faceVertices.size() / faceSize;
+
+    formatItems(numNewFaces, [&](FormatBuffer & buffer, int begin, int end) {
+        int const * v  = &faceVertices[(size_t)begin * faceSize];
+        int const * vt = &faceUVs[(size_t)begin * faceSize];
+        for (int i = begin; i < end; ++i, v += faceSize, vt += faceSize) {
+            char * s = buffer.Reserve(faceSize * (3 * kMaxNumberLength + 4) + 4);
+            *s++ = 'f';
+            *s++ = ' ';
+            for (int j = 0; j < faceSize; ++j) {
+                if (v[j] >= 0) {
+                    //  Remember Obj indices start with 1:
+                    int vIndex  = 1 + v[j];
+                    int vtIndex = 1 + vt[j];
+
+                    *s++ = ' ';
+                    s = FormatInt(s, vIndex);
+                    *s++ = '/';
+                    s = FormatInt(s, vtIndex);
+                    if (includeNormalIndices) {
+                        *s++ = '/';
+                        s = FormatInt(s, vIndex);
+                    }
+                }
+            }
+            *s++ = '\n';
+            buffer.Commit(s);
+        }
+    });
     _numFaces += numNewFaces;
 }
 
-void
+inline void
 ObjWriter::WriteGroupName(char const * prefix, int index) {
 
-    fprintf(_fptr, "g %s%d\n", prefix ? prefix : "", index);
+    char * s = _buffer.Reserve(kMaxNumberLength + 4);
+    *s++ = 'g';
+    *s++ = ' ';
+    _buffer.Commit(s);
+    if (prefix) _buffer.Append(prefix);
+
+    s = _buffer.Reserve(kMaxNumberLength + 4);
+    s = FormatInt(s, index);
+    *s++ = '\n';
+    _buffer.Commit(s);
 }
 
 } // end namespace
+
+#endif /* OBJ_WRITER_H */
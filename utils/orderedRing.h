@@ -0,0 +1,84 @@
+#ifndef ORDERED_RING_H
+#define ORDERED_RING_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  A bounded ring of items produced in any order by several threads and
+//  consumed in order (0, 1, 2, ...) by a single thread -- e.g. faces
+//  evaluated by workers and written in face order by a writer thread.
+//
+//  Item i lives in slot (i % capacity), whose sequence number records its
+//  state with no locks:  2*i when the slot is free for item i, 2*i + 1
+//  when item i is complete.  A producer of item i waits until the item
+//  (i - capacity) of the slot has been consumed (back-pressure), and the
+//  consumer waits until item i is complete.  The items are reused, so
+//  memory they allocate is retained from one use of a slot to the next.
+//
+//  Progress is guaranteed as long as items are claimed in increasing
+//  order by the producers (e.g. from an atomic counter):  the earliest
+//  incomplete item always has a free slot.
+//
+template <typename T>
+class OrderedRing {
+public:
+    explicit OrderedRing(int capacity) : _slots(capacity) {
+        for (int i = 0; i < capacity; ++i) {
+            _slots[i].sequence.store(2 * (long long) i, std::memory_order_relaxed);
+        }
+    }
+
+    int GetCapacity() const { return (int) _slots.size(); }
+
+    //  Producer:  wait for the slot of item i to be free and return it,
+    //  then publish the item once complete:
+    T & AcquireItem(int i) {
+        Slot & slot = getSlot(i);
+        wait(slot, 2 * (long long) i);
+        return slot.item;
+    }
+    void PublishItem(int i) {
+        getSlot(i).sequence.store(2 * (long long) i + 1, std::memory_order_release);
+    }
+
+    //  Consumer:  wait for item i to be complete and return it, then
+    //  release its slot for item (i + capacity) once consumed:
+    T & WaitForItem(int i) {
+        Slot & slot = getSlot(i);
+        wait(slot, 2 * (long long) i + 1);
+        return slot.item;
+    }
+    void ReleaseItem(int i) {
+        getSlot(i).sequence.store(2 * ((long long) i + GetCapacity()),
+                                  std::memory_order_release);
+    }
+
+private:
+    struct Slot {
+        std::atomic<long long> sequence;
+        T                      item;
+    };
+
+    Slot & getSlot(int i) { return _slots[i % _slots.size()]; }
+
+    //  Spin briefly before yielding to other threads:
+    static void wait(Slot const & slot, long long sequence) {
+        for (int spin = 0;
+                slot.sequence.load(std::memory_order_acquire) != sequence;
+                ++spin) {
+            if (spin >= 64) std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<Slot> _slots;
+};
+
+} // end namespace
+
+#endif /* ORDERED_RING_H */
@@ -0,0 +1,65 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Number of threads used by ParallelFor() -- a value of 0 uses all of
+//  the hardware threads reported:
+//
+inline int
+GetNumThreads(int requested = 0) {
+
+    if (requested > 0) return requested;
+
+    int numHardwareThreads = (int) std::thread::hardware_concurrency();
+    return (numHardwareThreads > 0) ? numHardwareThreads : 1;
+}
+
+//
+//  Minimal parallel loop -- splits [begin, end) into contiguous ranges
+//  and calls func(rangeBegin, rangeEnd) for each range on its own thread.
+//  Ranges are never smaller than 'grainSize', so short loops run on the
+//  calling thread:
+//
+template <class FUNC>
+inline void
+ParallelFor(int begin, int end, int grainSize, FUNC const & func,
+            int numThreads = 0) {
+
+    int count = end - begin;
+    if (count <= 0) return;
+
+    numThreads = std::min(GetNumThreads(numThreads),
+                          std::max(1, count / std::max(1, grainSize)));
+    if (numThreads == 1) {
+        func(begin, end);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+
+    int rangeSize = (count + numThreads - 1) / numThreads;
+    for (int i = 1; i < numThreads; ++i) {
+        int rangeBegin = begin + i * rangeSize;
+        int rangeEnd   = std::min(end, rangeBegin + rangeSize);
+        if (rangeBegin < rangeEnd) {
+            threads.push_back(std::thread(func, rangeBegin, rangeEnd));
+        }
+    }
+    func(begin, std::min(end, begin + rangeSize));
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+}
+
+} // end namespace
+
+#endif /* PARALLEL_H */
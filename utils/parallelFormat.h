@@ -0,0 +1,65 @@
+#ifndef PARALLEL_FORMAT_H
+#define PARALLEL_FORMAT_H
+
+#include "fastFormat.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Formats items [0, count) as text in order into a FormatBuffer (and so
+//  to its FILE or stream), calling formatRange(buffer, begin, end) for
+//  ranges of items on several threads.  Each range is formatted into a
+//  private buffer and the buffers are then appended to the output in
+//  order, so the text is identical to that of a single call:
+//
+//      FormatInParallel(buffer, numVertices,
+//          [&](FormatBuffer & rangeBuffer, int begin, int end) {
+//              for (int i = begin; i < end; ++i) { ... }
+//          });
+//
+//  Ranges are formatted in rounds of one range per thread, so memory is
+//  bounded by the text of one round rather than of all items.  Fewer
+//  items than a range are formatted directly into the output:
+//
+template <class FUNC>
+inline void
+FormatInParallel(FormatBuffer & out, int count, FUNC const & formatRange,
+                 int numThreads = 0, int rangeSize = 1 << 15) {
+
+    numThreads = GetNumThreads(numThreads);
+    if ((numThreads == 1) || (count <= rangeSize)) {
+        formatRange(out, 0, count);
+        return;
+    }
+
+    std::vector<FormatBuffer> rangeBuffers(numThreads);
+
+    int roundSize = numThreads * rangeSize;
+    for (int roundBegin = 0; roundBegin < count; roundBegin += roundSize) {
+        int numRanges = std::min(numThreads,
+                            (count - roundBegin + rangeSize - 1) / rangeSize);
+
+        ParallelFor(0, numRanges, 1, [&](int rangesBegin, int rangesEnd) {
+            for (int i = rangesBegin; i < rangesEnd; ++i) {
+                int begin = roundBegin + i * rangeSize;
+                int end   = std::min(count, begin + rangeSize);
+
+                rangeBuffers[i].Clear();
+                formatRange(rangeBuffers[i], begin, end);
+            }
+        }, numThreads);
+
+        for (int i = 0; i < numRanges; ++i) {
+            out.Append(rangeBuffers[i].GetText(), rangeBuffers[i].GetSize());
+        }
+    }
+}
+
+} // end namespace
+
+#endif /* PARALLEL_FORMAT_H */
@@ -0,0 +1,237 @@
+#include "patchBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+//
+//  Definitions of PatchBVH::Bounds methods:
+//
+void
+PatchBVH::Bounds::Clear() {
+
+    min[0] = min[1] = min[2] =  FLT_MAX;
+    max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+void
+PatchBVH::Bounds::Add(float const p[3]) {
+
+    for (int k = 0; k < 3; ++k) {
+        min[k] = std::min(min[k], p[k]);
+        max[k] = std::max(max[k], p[k]);
+    }
+}
+
+void
+PatchBVH::Bounds::Add(Bounds const & b) {
+
+    Add(b.min);
+    Add(b.max);
+}
+
+float
+PatchBVH::Bounds::GetDistanceSquared(float const p[3]) const {
+
+    float dSqrd = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        float d = std::max(std::max(min[k] - p[k], p[k] - max[k]), 0.0f);
+        dSqrd += d * d;
+    }
+    return dSqrd;
+}
+
+bool
+PatchBVH::Bounds::ClipRay(float const origin[3], float const invDir[3],
+                          float & tMin, float & tMax) const {
+
+    for (int k = 0; k < 3; ++k) {
+        float t0 = (min[k] - origin[k]) * invDir[k];
+        float t1 = (max[k] - origin[k]) * invDir[k];
+        if (t0 > t1) std::swap(t0, t1);
+
+        //  NaN from 0*inf (origin on a slab of a parallel ray) is ignored:
+        if (t0 > tMin) tMin = t0;
+        if (t1 < tMax) tMax = t1;
+    }
+    return tMin <= tMax;
+}
+
+//
+//  Definitions of PatchBVH methods:
+//
+namespace {
+    //  Row or column of the 4x4 net at 'dst' as 2 * 'near' - 'far' -- where
+    //  'stride' steps between the points of the row or column:
+    void
+    extrapolateNet(float net[16][3], int dst, int nearP, int farP,
+                   int stride) {
+
+        for (int j = 0; j < 4; ++j) {
+            for (int k = 0; k < 3; ++k) {
+                net[dst + j * stride][k] = 2.0f * net[nearP + j * stride][k] -
+                                                  net[farP + j * stride][k];
+            }
+        }
+    }
+}
+
+void
+PatchBVH::ComputePatchBounds(PatchTable const & patchTable,
+                             Handle const & handle, float const points[],
+                             Bounds & bounds) {
+
+    Far::ConstIndexArray cvs = patchTable.GetPatchVertices(handle);
+
+    bounds.Clear();
+
+    Far::PatchDescriptor::Type type =
+        patchTable.GetPatchDescriptor(handle).GetType();
+    int boundary = patchTable.GetPatchParam(handle).GetBoundary();
+
+    if ((type != Far::PatchDescriptor::REGULAR) || (boundary == 0)) {
+        for (int i = 0; i < cvs.size(); ++i) {
+            if (cvs[i] >= 0) bounds.Add(points + 3 * cvs[i]);
+        }
+        return;
+    }
+
+    //
+    //  Extrapolate the phantom points of the 4x4 B-spline net along the
+    //  boundaries (rows vary in v, columns in u) -- the points assigned
+    //  by Far to phantom points are ignored:
+    //
+    float net[16][3];
+    for (int i = 0; i < 16; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            net[i][k] = (cvs[i] >= 0) ? points[3 * cvs[i] + k] : 0.0f;
+        }
+    }
+
+    if (boundary & 8) extrapolateNet(net, 0, 1, 2, 4);    // u = 0
+    if (boundary & 2) extrapolateNet(net, 3, 2, 1, 4);    // u = 1
+    if (boundary & 1) extrapolateNet(net, 0, 4, 8, 1);    // v = 0
+    if (boundary & 4) extrapolateNet(net, 12, 8, 4, 1);   // v = 1
+
+    for (int i = 0; i < 16; ++i) {
+        bounds.Add(net[i]);
+    }
+}
+
+PatchBVH::PatchBVH(PatchTable const & patchTable, float const points[],
+                   int maxLeafSize) : _isValid(false) {
+
+    //
+    //  Assign the handles and bounds of all patches -- rejecting
+    //  triangular patches:
+    //
+    int numArrays = patchTable.GetNumPatchArrays();
+
+    _handles.resize(patchTable.GetNumPatchesTotal());
+    _patchBounds.resize(_handles.size());
+
+    for (int array = 0, current = 0; array < numArrays; ++array) {
+        Far::PatchDescriptor desc = patchTable.GetPatchArrayDescriptor(array);
+
+        Far::PatchDescriptor::Type type = desc.GetType();
+        if ((type == Far::PatchDescriptor::TRIANGLES) ||
+            (type == Far::PatchDescriptor::LOOP) ||
+            (type == Far::PatchDescriptor::GREGORY_TRIANGLE)) {
+            _handles.clear();
+            _patchBounds.clear();
+            return;
+        }
+
+        int ringSize = desc.GetNumControlVertices();
+        for (int j = 0; j < patchTable.GetNumPatches(array); ++j, ++current) {
+            Handle & h = _handles[current];
+            h.arrayIndex = array;
+            h.patchIndex = current;
+            h.vertIndex  = j * ringSize;
+
+            ComputePatchBounds(patchTable, h, points, _patchBounds[current]);
+        }
+    }
+    _isValid = true;
+
+    int numPatches = (int)_handles.size();
+    if (numPatches == 0) return;
+
+    std::vector<float> centroids(3 * numPatches);
+    for (int i = 0; i < numPatches; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            centroids[3 * i + k] = 0.5f * (_patchBounds[i].min[k] +
+                                           _patchBounds[i].max[k]);
+        }
+    }
+
+    _leafPatches.resize(numPatches);
+    for (int i = 0; i < numPatches; ++i) {
+        _leafPatches[i] = i;
+    }
+
+    _nodes.reserve(2 * (numPatches / std::max(1, maxLeafSize)) + 1);
+    buildNode(0, numPatches, std::max(1, maxLeafSize), centroids);
+}
+
+int
+PatchBVH::buildNode(int first, int count, int maxLeafSize,
+                    std::vector<float> const & centroids) {
+
+    int nodeIndex = (int)_nodes.size();
+    _nodes.push_back(Node());
+
+    Bounds bounds;
+    Bounds centroidBounds;
+    bounds.Clear();
+    centroidBounds.Clear();
+    for (int i = first; i < first + count; ++i) {
+        bounds.Add(_patchBounds[_leafPatches[i]]);
+        centroidBounds.Add(&centroids[3 * _leafPatches[i]]);
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if ((centroidBounds.max[k] - centroidBounds.min[k]) >
+            (centroidBounds.max[axis] - centroidBounds.min[axis])) axis = k;
+    }
+
+    if ((count <= maxLeafSize) ||
+        (centroidBounds.max[axis] <= centroidBounds.min[axis])) {
+        Node & leaf = _nodes[nodeIndex];
+        leaf.bounds      = bounds;
+        leaf.first       = first;
+        leaf.count       = count;
+        leaf.secondChild = -1;
+        return nodeIndex;
+    }
+
+    //  Split at the median centroid along the largest axis:
+    int half = count / 2;
+    std::nth_element(_leafPatches.begin() + first,
+                     _leafPatches.begin() + first + half,
+                     _leafPatches.begin() + first + count,
+                     [&](int a, int b) {
+                         return centroids[3 * a + axis] <
+                                centroids[3 * b + axis];
+                     });
+
+    buildNode(first, half, maxLeafSize, centroids);
+    int secondChild = buildNode(first + half, count - half, maxLeafSize,
+                                centroids);
+
+    //  Nodes may have been reallocated by the recursion:
+    Node & node = _nodes[nodeIndex];
+    node.bounds      = bounds;
+    node.first       = first;
+    node.count       = 0;
+    node.secondChild = secondChild;
+    return nodeIndex;
+}
+
+} // end namespace
@@ -0,0 +1,95 @@
+#ifndef PATCH_BVH_H
+#define PATCH_BVH_H
+
+#include <opensubdiv/far/patchTable.h>
+
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Bounding volume hierarchy over the patches of a Far::PatchTable.
+//
+//  The bounds of each patch are conservative -- the limit surface of a
+//  patch always lies within them:  B-spline and Gregory patches lie in
+//  the convex hull of their control points, so the bounds of the control
+//  points are used, with the phantom points of boundary B-spline patches
+//  extrapolated first as Far does when evaluating them.
+//
+//  The hierarchy is stored as a flat array of nodes in depth-first order
+//  (the first child of an interior node immediately follows it) and is
+//  built by splitting the patch centroids at the median of the largest
+//  axis.  Traversal is left to the queries using it.
+//
+//  The control points are the xyz positions of all vertices referenced by
+//  the PatchTable (refined vertices followed by local points).  Only quad
+//  based patch tables are supported -- IsValid() returns false otherwise.
+//
+class PatchBVH {
+public:
+    typedef OpenSubdiv::Far::PatchTable              PatchTable;
+    typedef OpenSubdiv::Far::PatchTable::PatchHandle Handle;
+
+    struct Bounds {
+        float min[3];
+        float max[3];
+
+        void Clear();
+        void Add(float const p[3]);
+        void Add(Bounds const & b);
+
+        //  Squared distance from a point (zero if inside):
+        float GetDistanceSquared(float const p[3]) const;
+
+        //  Clip the ray interval [tMin,tMax] -- returns false if empty:
+        bool ClipRay(float const origin[3], float const invDir[3],
+                     float & tMin, float & tMax) const;
+    };
+
+    struct Node {
+        Bounds bounds;
+        int    first;        // leaf: first patch in GetLeafPatches()
+        int    count;        // leaf: number of patches, 0 for interior nodes
+        int    secondChild;  // interior: index of second child (first is +1)
+
+        bool IsLeaf() const { return count > 0; }
+    };
+
+public:
+    PatchBVH(PatchTable const & patchTable, float const points[],
+             int maxLeafSize = 4);
+
+    bool IsValid() const { return _isValid; }
+
+    int GetNumPatches() const { return (int)_handles.size(); }
+    int GetNumNodes() const   { return (int)_nodes.size(); }
+
+    Node const &   GetNode(int index) const         { return _nodes[index]; }
+    Handle const & GetPatchHandle(int patch) const  { return _handles[patch]; }
+    Bounds const & GetPatchBounds(int patch) const  { return _patchBounds[patch]; }
+
+    //  Patches referenced by leaf nodes (indices of patches):
+    int const * GetLeafPatches() const { return _leafPatches.data(); }
+
+    //  Conservative bounds of a single patch:
+    static void ComputePatchBounds(PatchTable const & patchTable,
+                                   Handle const & handle,
+                                   float const points[], Bounds & bounds);
+
+private:
+    int buildNode(int first, int count, int maxLeafSize,
+                  std::vector<float> const & centroids);
+
+private:
+    bool _isValid;
+
+    std::vector<Handle> _handles;
+    std::vector<Bounds> _patchBounds;
+    std::vector<int>    _leafPatches;
+    std::vector<Node>   _nodes;
+};
+
+} // end namespace
+
+#endif /* PATCH_BVH_H */
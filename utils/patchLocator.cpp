@@ -0,0 +1,263 @@
+#include "patchLocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+int const PatchLocator::kUnset = INT_MIN;
+
+//
+//  Definitions of PatchLocator methods:
+//
+PatchLocator::PatchLocator(PatchTable const & patchTable) :
+        _isValid(false), _minFace(0), _maxFace(-1) {
+
+    initialize(patchTable);
+    if (_isValid) {
+        sortBreadthFirst();
+    }
+}
+
+void
+PatchLocator::initialize(PatchTable const & patchTable) {
+
+    int numArrays = patchTable.GetNumPatchArrays();
+
+    //
+    //  Assign the handles in the same order as Far::PatchMap and identify
+    //  the range of faces -- rejecting triangular patches:
+    //
+    _handles.resize(patchTable.GetNumPatchesTotal());
+    _minFace = INT_MAX;
+    _maxFace = INT_MIN;
+
+    for (int array = 0, current = 0; array < numArrays; ++array) {
+        Far::PatchDescriptor desc = patchTable.GetPatchArrayDescriptor(array);
+
+        Far::PatchDescriptor::Type type = desc.GetType();
+        if ((type == Far::PatchDescriptor::TRIANGLES) ||
+            (type == Far::PatchDescriptor::LOOP) ||
+            (type == Far::PatchDescriptor::GREGORY_TRIANGLE)) {
+            return;
+        }
+
+        int ringSize = desc.GetNumControlVertices();
+        for (int j = 0; j < patchTable.GetNumPatches(array); ++j, ++current) {
+            Handle & h = _handles[current];
+            h.arrayIndex = array;
+            h.patchIndex = current;
+            h.vertIndex  = j * ringSize;
+
+            int faceId = patchTable.GetPatchParam(array, j).GetFaceId();
+            _minFace = std::min(_minFace, faceId);
+            _maxFace = std::max(_maxFace, faceId);
+        }
+    }
+    if (_handles.empty()) {
+        _minFace = 0;
+        _maxFace = -1;
+    }
+    _isValid = true;
+
+    //
+    //  Insert each patch into the quadtree of its face -- identifying the
+    //  quadrant at each level from the UV bits of its PatchParam:
+    //
+    _faceEntries.assign(_maxFace - _minFace + 1, kUnset);
+    _nodes.reserve(_handles.size());
+
+    Far::PatchParamTable const & params = patchTable.GetPatchParamTable();
+
+    for (int handleIndex = 0; handleIndex < (int)_handles.size(); ++handleIndex) {
+        Far::PatchParam const & param = params[handleIndex];
+
+        int depth     = param.GetDepth();
+        int rootDepth = param.NonQuadRoot();
+
+        int & faceEntry = _faceEntries[param.GetFaceId() - _minFace];
+        if (depth == rootDepth) {
+            faceEntry = leafEntry(handleIndex);
+            continue;
+        }
+        if (!isNode(faceEntry)) {
+            faceEntry = (int)_nodes.size();
+            _nodes.push_back(Node());
+            std::fill(_nodes.back().children, _nodes.back().children + 4,
+                      kUnset);
+        }
+
+        int u = param.GetU();
+        int v = param.GetV();
+
+        int node = faceEntry;
+        for (int j = rootDepth + 1; j <= depth; ++j) {
+            int uBit = (u >> (depth - j)) & 1;
+            int vBit = (v >> (depth - j)) & 1;
+            int quadrant = (vBit << 1) | uBit;
+
+            if (j == depth) {
+                _nodes[node].children[quadrant] = leafEntry(handleIndex);
+            } else {
+                int child = _nodes[node].children[quadrant];
+                if (!isNode(child)) {
+                    child = (int)_nodes.size();
+                    _nodes.push_back(Node());
+                    std::fill(_nodes.back().children,
+                              _nodes.back().children + 4, kUnset);
+                    _nodes[node].children[quadrant] = child;
+                }
+                node = child;
+            }
+        }
+    }
+}
+
+void
+PatchLocator::sortBreadthFirst() {
+
+    //
+    //  Visit the nodes breadth-first -- starting with the roots of all faces
+    //  in order -- and store them in the order visited:
+    //
+    std::vector<int> visitOrder;
+    visitOrder.reserve(_nodes.size());
+
+    for (int i = 0; i < (int)_faceEntries.size(); ++i) {
+        if (isNode(_faceEntries[i])) visitOrder.push_back(_faceEntries[i]);
+    }
+    for (int next = 0; next < (int)visitOrder.size(); ++next) {
+        Node const & node = _nodes[visitOrder[next]];
+        for (int q = 0; q < 4; ++q) {
+            if (isNode(node.children[q])) visitOrder.push_back(node.children[q]);
+        }
+    }
+    assert(visitOrder.size() == _nodes.size());
+
+    std::vector<int> newIndex(_nodes.size());
+    for (int i = 0; i < (int)visitOrder.size(); ++i) {
+        newIndex[visitOrder[i]] = i;
+    }
+
+    std::vector<Node> sortedNodes(_nodes.size());
+    for (int i = 0; i < (int)visitOrder.size(); ++i) {
+        Node & node = sortedNodes[i];
+        node = _nodes[visitOrder[i]];
+        for (int q = 0; q < 4; ++q) {
+            if (isNode(node.children[q])) {
+                node.children[q] = newIndex[node.children[q]];
+            }
+        }
+    }
+    _nodes.swap(sortedNodes);
+
+    for (int i = 0; i < (int)_faceEntries.size(); ++i) {
+        if (isNode(_faceEntries[i])) {
+            _faceEntries[i] = newIndex[_faceEntries[i]];
+        }
+    }
+}
+
+template <typename REAL>
+inline PatchLocator::Handle const *
+PatchLocator::findHandle(int entry, REAL u, REAL v) const {
+
+    REAL median = 0.5f;
+    while (isNode(entry)) {
+        int uHalf = (u >= median);
+        if (uHalf) u -= median;
+        int vHalf = (v >= median);
+        if (vHalf) v -= median;
+
+        entry = _nodes[entry].children[(vHalf << 1) | uHalf];
+        median *= 0.5f;
+    }
+    return (entry == kUnset) ? 0 : &_handles[leafHandle(entry)];
+}
+
+PatchLocator::Handle const *
+PatchLocator::FindPatch(int faceId, double u, double v) const {
+
+    if ((faceId < _minFace) || (faceId > _maxFace)) return 0;
+
+    assert((u >= 0.0) && (u <= 1.0) && (v >= 0.0) && (v <= 1.0));
+
+    int entry = _faceEntries[faceId - _minFace];
+    if (entry == kUnset) return 0;
+
+    return findHandle(entry, u, v);
+}
+
+void
+PatchLocator::FindPatches(int faceId, int numCoords, float const u[],
+                          float const v[], Handle const * handles[]) const {
+
+    int entry = kUnset;
+    if ((faceId >= _minFace) && (faceId <= _maxFace)) {
+        entry = _faceEntries[faceId - _minFace];
+    }
+
+    //  Faces without patches or with a single patch need no descent:
+    if (!isNode(entry)) {
+        Handle const * h = (entry == kUnset) ? 0 : &_handles[leafHandle(entry)];
+        std::fill(handles, handles + numCoords, h);
+        return;
+    }
+
+    int i = 0;
+#if defined(__AVX2__)
+    //
+    //  Descend for 8 locations at once -- gathering the child entries of the
+    //  nodes of all lanes still active at each level:
+    //
+    int const * children = &_nodes[0].children[0];
+
+    __m256i const one   = _mm256_set1_epi32(1);
+    __m256i const two   = _mm256_set1_epi32(2);
+
+    for ( ; i + 8 <= numCoords; i += 8) {
+        __m256  U = _mm256_loadu_ps(u + i);
+        __m256  V = _mm256_loadu_ps(v + i);
+        __m256i E = _mm256_set1_epi32(entry);
+        __m256  median = _mm256_set1_ps(0.5f);
+
+        for (;;) {
+            __m256i active = _mm256_cmpgt_epi32(E, _mm256_set1_epi32(-1));
+            if (_mm256_testz_si256(active, active)) break;
+
+            __m256 uHalf = _mm256_cmp_ps(U, median, _CMP_GE_OQ);
+            __m256 vHalf = _mm256_cmp_ps(V, median, _CMP_GE_OQ);
+            U = _mm256_sub_ps(U, _mm256_and_ps(uHalf, median));
+            V = _mm256_sub_ps(V, _mm256_and_ps(vHalf, median));
+
+            __m256i quadrant = _mm256_or_si256(
+                    _mm256_and_si256(_mm256_castps_si256(uHalf), one),
+                    _mm256_and_si256(_mm256_castps_si256(vHalf), two));
+            __m256i index = _mm256_add_epi32(_mm256_slli_epi32(E, 2), quadrant);
+
+            E = _mm256_mask_i32gather_epi32(E, children, index, active, 4);
+            median = _mm256_mul_ps(median, _mm256_set1_ps(0.5f));
+        }
+
+        int leaves[8];
+        _mm256_storeu_si256((__m256i *)leaves, E);
+        for (int k = 0; k < 8; ++k) {
+            handles[i + k] = (leaves[k] == kUnset) ? 0 :
+                             &_handles[leafHandle(leaves[k])];
+        }
+    }
+#endif
+    for ( ; i < numCoords; ++i) {
+        handles[i] = findHandle(entry, u[i], v[i]);
+    }
+}
+
+} // end namespace
@@ -0,0 +1,81 @@
+#ifndef PATCH_LOCATOR_H
+#define PATCH_LOCATOR_H
+
+#include <opensubdiv/far/patchTable.h>
+
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Flat alternative to Far::PatchMap for locating the patch of a (u,v)
+//  location on a ptex face.
+//
+//  Far::PatchMap allocates the nodes of its quadtree as patches are added,
+//  so a search hops between unrelated parts of memory.  Here the quadtree
+//  is rebuilt as a compact array ordered breadth-first (the roots of all
+//  faces first, then all nodes of depth 1, etc.) and faces covered by a
+//  single patch store the patch directly in the per-face table, so that
+//  no node is visited at all for them.
+//
+//  Only quad-based patch tables (Catmark and Bilinear) are supported --
+//  IsValid() returns false for triangular patches.
+//
+class PatchLocator {
+public:
+    typedef OpenSubdiv::Far::PatchTable            PatchTable;
+    typedef OpenSubdiv::Far::PatchTable::PatchHandle Handle;
+
+    PatchLocator(PatchTable const & patchTable);
+
+    bool IsValid() const { return _isValid; }
+
+    //  Same behavior as Far::PatchMap::FindPatch():
+    Handle const * FindPatch(int faceId, double u, double v) const;
+
+    //  Locate the patches of many (u,v) locations on the same face -- using
+    //  a SIMD descent when compiled for AVX2.  Entries of 'handles' are set
+    //  to 0 where no patch is found:
+    void FindPatches(int faceId, int numCoords, float const u[],
+                     float const v[], Handle const * handles[]) const;
+
+    int GetNumNodes() const   { return (int)_nodes.size(); }
+    int GetNumHandles() const { return (int)_handles.size(); }
+
+private:
+    //
+    //  Each entry referring to a node or a patch is a single int -- the
+    //  index of a node when non-negative, the complement of the index of
+    //  a handle when negative, or kUnset when nothing is there:
+    //
+    static int const kUnset;
+
+    static bool isNode(int entry) { return entry >= 0; }
+    static int  leafEntry(int handleIndex) { return ~handleIndex; }
+    static int  leafHandle(int entry) { return ~entry; }
+
+    struct Node {
+        int children[4];
+    };
+
+    void initialize(PatchTable const & patchTable);
+    void sortBreadthFirst();
+
+    template <typename REAL>
+    Handle const * findHandle(int entry, REAL u, REAL v) const;
+
+private:
+    bool _isValid;
+
+    int _minFace;
+    int _maxFace;
+
+    std::vector<int>    _faceEntries;
+    std::vector<Node>   _nodes;
+    std::vector<Handle> _handles;
+};
+
+} // end namespace
+
+#endif /* PATCH_LOCATOR_H */
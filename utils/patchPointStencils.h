@@ -0,0 +1,203 @@
+#ifndef PATCH_POINT_STENCILS_H
+#define PATCH_POINT_STENCILS_H
+
+#include <opensubdiv/far/patchTable.h>
+#include <opensubdiv/far/stencilTable.h>
+#include <opensubdiv/far/stencilTableFactory.h>
+#include <opensubdiv/far/topologyRefiner.h>
+
+#include "parallel.h"
+
+#include <cassert>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Stencils computing the control points of all patches of a PatchTable
+//  directly from the coarse vertices.
+//
+//  The usual evaluation of a PatchTable interpolates the refined vertices
+//  level by level with Far::PrimvarRefiner and then applies the local point
+//  stencils as a second pass -- every level being written and read back.
+//  Here the refinement stencils of all levels and the local point stencils
+//  are combined into a single Far::StencilTable (local points appended and
+//  factorized with StencilTableFactory::AppendLocalPointStencilTable), from
+//  which only the rows of points referenced by patches are kept.  Points
+//  are renumbered compactly, so intermediate refined vertices are neither
+//  computed nor stored, and each point is a single independent stencil
+//  that is trivially evaluated in parallel.
+//
+//  Patches must refer to the compact points through GetPatchPoints() in
+//  place of PatchTable::GetPatchVertices().
+//
+template <typename REAL>
+class PatchPointStencils {
+public:
+    typedef OpenSubdiv::Far::TopologyRefiner         TopologyRefiner;
+    typedef OpenSubdiv::Far::PatchTable              PatchTable;
+    typedef OpenSubdiv::Far::PatchTable::PatchHandle PatchHandle;
+    typedef OpenSubdiv::Far::ConstIndexArray         ConstIndexArray;
+
+    PatchPointStencils(TopologyRefiner const & refiner,
+                       PatchTable const & patchTable);
+
+    int GetNumControlVertices() const { return _numControlVertices; }
+    int GetNumPoints() const          { return (int)_sizes.size(); }
+
+    //  Indices of the patch's control points in the compact points:
+    ConstIndexArray GetPatchPoints(PatchHandle const & handle) const {
+        return ConstIndexArray(&_patchPoints[_arrayOffsets[handle.arrayIndex] +
+                                             handle.vertIndex],
+                               _arrayStrides[handle.arrayIndex]);
+    }
+
+    //  Compute all points from the coarse vertices -- both are containers
+    //  with the Clear()/AddWithWeight() interface of Far::PrimvarRefiner:
+    template <class T, class U>
+    void Update(T const * controlVertices, U * points,
+                int numThreads = 0) const;
+
+private:
+    int _numControlVertices;
+
+    //  Stencils of the compact points:
+    std::vector<int>  _sizes;
+    std::vector<int>  _offsets;
+    std::vector<int>  _indices;
+    std::vector<REAL> _weights;
+
+    //  Patch control points remapped to compact points:
+    std::vector<int> _patchPoints;
+    std::vector<int> _arrayOffsets;
+    std::vector<int> _arrayStrides;
+};
+
+//
+//  Definitions of PatchPointStencils methods:
+//
+template <typename REAL>
+inline
+PatchPointStencils<REAL>::PatchPointStencils(TopologyRefiner const & refiner,
+                                             PatchTable const & patchTable) {
+
+    using namespace OpenSubdiv;
+
+    typedef Far::StencilTableReal<REAL>        StencilTable;
+    typedef Far::StencilTableFactoryReal<REAL> StencilTableFactory;
+
+    _numControlVertices = refiner.GetLevel(0).GetNumVertices();
+
+    //
+    //  Combine the stencils of all refined vertices with those of the local
+    //  points -- all expressed in terms of the coarse vertices:
+    //
+    typename StencilTableFactory::Options options;
+    options.generateOffsets            = true;
+    options.generateIntermediateLevels = true;
+    options.maxLevel                   = refiner.GetMaxLevel();
+
+    StencilTable const * refinedStencils =
+        StencilTableFactory::Create(refiner, options);
+
+    StencilTable const * combinedStencils =
+        StencilTableFactory::AppendLocalPointStencilTable(refiner,
+            refinedStencils, patchTable.GetLocalPointStencilTable<REAL>());
+    if (combinedStencils == 0) {
+        //  No local points to append:
+        combinedStencils = refinedStencils;
+    } else {
+        delete refinedStencils;
+    }
+
+    //
+    //  Identify the points referenced by patches -- in order of first
+    //  reference so that points of neighboring patches are close in memory:
+    //
+    int numPatchArrays = patchTable.GetNumPatchArrays();
+
+    _arrayOffsets.resize(numPatchArrays);
+    _arrayStrides.resize(numPatchArrays);
+
+    int numVertexIndices = _numControlVertices +
+                           combinedStencils->GetNumStencils();
+
+    std::vector<int> pointIndex(numVertexIndices, -1);
+    std::vector<int> vertexOfPoint;
+
+    for (int array = 0; array < numPatchArrays; ++array) {
+        ConstIndexArray cvs = patchTable.GetPatchArrayVertices(array);
+
+        _arrayOffsets[array] = (int)_patchPoints.size();
+        _arrayStrides[array] = patchTable.GetNumControlVertices(array);
+
+        for (int i = 0; i < cvs.size(); ++i) {
+            int & point = pointIndex[cvs[i]];
+            if (point < 0) {
+                point = (int)vertexOfPoint.size();
+                vertexOfPoint.push_back(cvs[i]);
+            }
+            _patchPoints.push_back(point);
+        }
+    }
+
+    //
+    //  Gather the stencils of the referenced points -- coarse vertices
+    //  referenced directly by patches get an identity stencil:
+    //
+    std::vector<int>  const & sizes   = combinedStencils->GetSizes();
+    std::vector<int>  const & offsets = combinedStencils->GetOffsets();
+    std::vector<int>  const & indices = combinedStencils->GetControlIndices();
+    std::vector<REAL> const & weights = combinedStencils->GetWeights();
+
+    int numPoints = (int)vertexOfPoint.size();
+
+    _sizes.resize(numPoints);
+    _offsets.resize(numPoints);
+    for (int point = 0; point < numPoints; ++point) {
+        int vertex = vertexOfPoint[point];
+
+        _offsets[point] = (int)_indices.size();
+        if (vertex < _numControlVertices) {
+            _sizes[point] = 1;
+            _indices.push_back(vertex);
+            _weights.push_back(1.0f);
+        } else {
+            int stencil = vertex - _numControlVertices;
+
+            _sizes[point] = sizes[stencil];
+            _indices.insert(_indices.end(),
+                            indices.begin() + offsets[stencil],
+                            indices.begin() + offsets[stencil] + sizes[stencil]);
+            _weights.insert(_weights.end(),
+                            weights.begin() + offsets[stencil],
+                            weights.begin() + offsets[stencil] + sizes[stencil]);
+        }
+    }
+    delete combinedStencils;
+}
+
+template <typename REAL>
+template <class T, class U>
+inline void
+PatchPointStencils<REAL>::Update(T const * controlVertices, U * points,
+                                 int numThreads) const {
+
+    ParallelFor(0, GetNumPoints(), 1024, [&](int begin, int end) {
+        for (int point = begin; point < end; ++point) {
+            int const *  index  = &_indices[_offsets[point]];
+            REAL const * weight = &_weights[_offsets[point]];
+
+            U & dst = points[point];
+            dst.Clear();
+            for (int i = 0; i < _sizes[point]; ++i) {
+                dst.AddWithWeight(controlVertices[index[i]], weight[i]);
+            }
+        }
+    }, numThreads);
+}
+
+} // end namespace
+
+#endif /* PATCH_POINT_STENCILS_H */
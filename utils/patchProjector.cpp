@@ -0,0 +1,271 @@
+#include "patchProjector.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    inline double
+    dot(double const a[3], double const b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline double
+    clamp(double x, double lo, double hi) {
+        return std::min(std::max(x, lo), hi);
+    }
+}
+
+//
+//  Definitions of PatchProjector methods:
+//
+PatchProjector::PatchProjector(PatchTable const & patchTable,
+                               float const points[], PatchBVH const & bvh,
+                               Options const & options) :
+        _patchTable(patchTable), _points(points), _bvh(bvh),
+        _options(options), _numPatchTests(0) {
+
+    assert(bvh.IsValid());
+}
+
+void
+PatchProjector::evaluate(PatchTable::PatchHandle const & handle,
+                         double u, double v, double P[3], double Du[3],
+                         double Dv[3], double Duu[3], double Duv[3],
+                         double Dvv[3]) const {
+
+    double wP[20], wDu[20], wDv[20], wDuu[20], wDuv[20], wDvv[20];
+
+    bool needDerivs  = (Du != 0);
+    bool needDerivs2 = (Duu != 0);
+
+    _patchTable.EvaluateBasis(handle, u, v, wP,
+                              needDerivs  ? wDu  : 0, needDerivs  ? wDv  : 0,
+                              needDerivs2 ? wDuu : 0, needDerivs2 ? wDuv : 0,
+                              needDerivs2 ? wDvv : 0);
+
+    Far::ConstIndexArray cvs = _patchTable.GetPatchVertices(handle);
+
+    double * results[6] = { P, Du, Dv, Duu, Duv, Dvv };
+    double * weights[6] = { wP, wDu, wDv, wDuu, wDuv, wDvv };
+
+    int numResults = needDerivs2 ? 6 : (needDerivs ? 3 : 1);
+    for (int j = 0; j < numResults; ++j) {
+        double * dst = results[j];
+        double * w   = weights[j];
+
+        dst[0] = dst[1] = dst[2] = 0.0;
+        for (int i = 0; i < cvs.size(); ++i) {
+            if (w[i] == 0.0) continue;
+
+            float const * cv = _points + 3 * cvs[i];
+            dst[0] += w[i] * cv[0];
+            dst[1] += w[i] * cv[1];
+            dst[2] += w[i] * cv[2];
+        }
+    }
+}
+
+bool
+PatchProjector::projectToPatch(int patch, float const point[3],
+                               double & distSqrd, Result & result) const {
+
+    PatchTable::PatchHandle const & handle = _bvh.GetPatchHandle(patch);
+
+    Far::PatchParam param = _patchTable.GetPatchParam(handle);
+
+    //  Domain of the patch within its ptex face:
+    double uMin = 0.0, vMin = 0.0, uMax = 1.0, vMax = 1.0;
+    param.Unnormalize(uMin, vMin);
+    param.Unnormalize(uMax, vMax);
+
+    double q[3] = { point[0], point[1], point[2] };
+
+    //
+    //  Start from the nearest of a 3x3 grid of samples:
+    //
+    double u = uMin, v = vMin, P[3], d[3];
+    double nearest = DBL_MAX;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            double ui = uMin + 0.5 * i * (uMax - uMin);
+            double vj = vMin + 0.5 * j * (vMax - vMin);
+
+            evaluate(handle, ui, vj, P);
+            d[0] = P[0] - q[0]; d[1] = P[1] - q[1]; d[2] = P[2] - q[2];
+
+            double dd = dot(d, d);
+            if (dd < nearest) {
+                nearest = dd;
+                u = ui;
+                v = vj;
+            }
+        }
+    }
+
+    //
+    //  Newton iteration on f(u,v) = |S(u,v) - q|^2 / 2 -- falling back to
+    //  Gauss-Newton where the Hessian is not positive definite, and
+    //  halving steps that do not reduce the distance:
+    //
+    double tolerance = _options.tolerance * std::max(uMax - uMin, vMax - vMin);
+
+    double Du[3], Dv[3], Duu[3], Duv[3], Dvv[3];
+    for (int iteration = 0; iteration < _options.maxIterations; ++iteration) {
+        evaluate(handle, u, v, P, Du, Dv, Duu, Duv, Dvv);
+        d[0] = P[0] - q[0]; d[1] = P[1] - q[1]; d[2] = P[2] - q[2];
+        nearest = dot(d, d);
+
+        double gu = dot(Du, d);
+        double gv = dot(Dv, d);
+
+        double Huu = dot(Du, Du) + dot(Duu, d);
+        double Huv = dot(Du, Dv) + dot(Duv, d);
+        double Hvv = dot(Dv, Dv) + dot(Dvv, d);
+        double det = Huu * Hvv - Huv * Huv;
+        if ((Huu <= 0.0) || (det <= 0.0)) {
+            Huu = dot(Du, Du);
+            Huv = dot(Du, Dv);
+            Hvv = dot(Dv, Dv);
+            det = Huu * Hvv - Huv * Huv;
+        }
+
+        //
+        //  Coordinates at a bound of the domain with the gradient pointing
+        //  outside are held fixed while minimizing along the other:
+        //
+        bool uFixed = ((u <= uMin) && (gu > 0.0)) || ((u >= uMax) && (gu < 0.0));
+        bool vFixed = ((v <= vMin) && (gv > 0.0)) || ((v >= vMax) && (gv < 0.0));
+
+        double du = 0.0, dv = 0.0;
+        if (uFixed && vFixed) {
+            break;
+        } else if (uFixed) {
+            if (Hvv <= 0.0) break;
+            dv = -gv / Hvv;
+        } else if (vFixed) {
+            if (Huu <= 0.0) break;
+            du = -gu / Huu;
+        } else {
+            if (det <= 0.0) break;
+            du = -( Hvv * gu - Huv * gv) / det;
+            dv = -(-Huv * gu + Huu * gv) / det;
+        }
+
+        double uNew = clamp(u + du, uMin, uMax);
+        double vNew = clamp(v + dv, vMin, vMax);
+
+        bool reduced = false;
+        for (int halving = 0; !reduced && (halving < 8); ++halving) {
+            evaluate(handle, uNew, vNew, P);
+            d[0] = P[0] - q[0]; d[1] = P[1] - q[1]; d[2] = P[2] - q[2];
+
+            reduced = (dot(d, d) < nearest);
+            if (!reduced) {
+                uNew = 0.5 * (u + uNew);
+                vNew = 0.5 * (v + vNew);
+            }
+        }
+        if (!reduced) break;
+
+        double step = std::max(std::fabs(uNew - u), std::fabs(vNew - v));
+        u = uNew;
+        v = vNew;
+        if (step < tolerance) break;
+    }
+    evaluate(handle, u, v, P);
+    d[0] = P[0] - q[0]; d[1] = P[1] - q[1]; d[2] = P[2] - q[2];
+    nearest = dot(d, d);
+
+    if (nearest >= distSqrd) return false;
+
+    distSqrd = nearest;
+
+    result.faceId     = param.GetFaceId();
+    result.patchIndex = handle.patchIndex;
+    result.s          = (float) u;
+    result.t          = (float) v;
+    result.P[0]       = (float) P[0];
+    result.P[1]       = (float) P[1];
+    result.P[2]       = (float) P[2];
+    result.distance   = (float) std::sqrt(nearest);
+    return true;
+}
+
+bool
+PatchProjector::Project(float const point[3], Result & result) const {
+
+    result.faceId     = -1;
+    result.patchIndex = -1;
+    result.distance   = FLT_MAX;
+
+    if (_bvh.GetNumNodes() == 0) return false;
+
+    double distSqrd = (_options.maxDistance > 0.0f) ?
+        ((double)_options.maxDistance * _options.maxDistance) : DBL_MAX;
+
+    int numPatchTests = 0;
+
+    //
+    //  Visit the nodes nearest first -- pushing the further child first --
+    //  and skip those whose bounds are further than the nearest point:
+    //
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        int nodeIndex = stack[--stackSize];
+
+        PatchBVH::Node const & node = _bvh.GetNode(nodeIndex);
+        if (node.bounds.GetDistanceSquared(point) >= distSqrd) continue;
+
+        if (node.IsLeaf()) {
+            int const * patches = _bvh.GetLeafPatches() + node.first;
+            for (int i = 0; i < node.count; ++i) {
+                int patch = patches[i];
+                if (_bvh.GetPatchBounds(patch).GetDistanceSquared(point) <
+                        distSqrd) {
+                    projectToPatch(patch, point, distSqrd, result);
+                    ++ numPatchTests;
+                }
+            }
+            continue;
+        }
+
+        int first  = nodeIndex + 1;
+        int second = node.secondChild;
+
+        float dFirst  = _bvh.GetNode(first).bounds.GetDistanceSquared(point);
+        float dSecond = _bvh.GetNode(second).bounds.GetDistanceSquared(point);
+        if (dFirst < dSecond) std::swap(first, second);
+
+        assert(stackSize + 2 <= 64);
+        stack[stackSize++] = first;
+        stack[stackSize++] = second;
+    }
+
+    _numPatchTests += numPatchTests;
+
+    return result.faceId >= 0;
+}
+
+void
+PatchProjector::ProjectPoints(int numPoints, float const points[],
+                              Result results[], int numThreads) const {
+
+    ParallelFor(0, numPoints, 256, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            Project(points + 3 * i, results[i]);
+        }
+    }, numThreads);
+}
+
+} // end namespace
@@ -0,0 +1,81 @@
+#ifndef PATCH_PROJECTOR_H
+#define PATCH_PROJECTOR_H
+
+#include "patchBVH.h"
+
+#include <opensubdiv/far/patchTable.h>
+
+#include <atomic>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Closest point queries on the limit surface of a Far::PatchTable -- the
+//  inverse of sampling the limit surface at (ptexFace, s, t):  given a 3D
+//  point, find the (ptexFace, s, t) of the nearest point of the surface.
+//
+//  The patches are visited nearest first through a PatchBVH and pruned by
+//  the distance to their bounds.  For each candidate patch, the closest
+//  point of a small grid of samples is refined by Newton iteration on the
+//  squared distance (using the second derivatives of EvaluateBasis), with
+//  the parametric location constrained to the domain of the patch.
+//
+class PatchProjector {
+public:
+    typedef OpenSubdiv::Far::PatchTable PatchTable;
+
+    struct Options {
+        Options() : maxDistance(-1.0f), maxIterations(10),
+                    tolerance(1.0e-6f) { }
+
+        float maxDistance;    // ignore points further than this if > 0
+        int   maxIterations;  // Newton iterations per candidate patch
+        float tolerance;      // parametric convergence (fraction of patch)
+    };
+
+    struct Result {
+        int   faceId;      // ptex face, -1 if nothing within maxDistance
+        int   patchIndex;
+        float s, t;        // location within the ptex face
+        float P[3];        // closest point
+        float distance;
+    };
+
+public:
+    //  The PatchBVH must have been built from the same patches and points:
+    PatchProjector(PatchTable const & patchTable, float const points[],
+                   PatchBVH const & bvh, Options const & options = Options());
+
+    //  Returns false if no point is found within the maximum distance:
+    bool Project(float const point[3], Result & result) const;
+
+    //  Project many points (xyz triples) in parallel:
+    void ProjectPoints(int numPoints, float const points[], Result results[],
+                       int numThreads = 0) const;
+
+    //  Number of patches tested (Newton iterations applied) by all queries:
+    long GetNumPatchTests() const { return _numPatchTests; }
+
+private:
+    void evaluate(PatchTable::PatchHandle const & handle, double u, double v,
+                  double P[3], double Du[3] = 0, double Dv[3] = 0,
+                  double Duu[3] = 0, double Duv[3] = 0,
+                  double Dvv[3] = 0) const;
+
+    bool projectToPatch(int patch, float const point[3], double & distSqrd,
+                        Result & result) const;
+
+private:
+    PatchTable const & _patchTable;
+    float const *      _points;
+    PatchBVH const &   _bvh;
+    Options            _options;
+
+    //  Updated by concurrent queries:
+    mutable std::atomic<long> _numPatchTests;
+};
+
+} // end namespace
+
+#endif /* PATCH_PROJECTOR_H */
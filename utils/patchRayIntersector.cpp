@@ -0,0 +1,440 @@
+#include "patchRayIntersector.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    inline double
+    dot(double const a[3], double const b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    inline void
+    cross(double const a[3], double const b[3], double c[3]) {
+        c[0] = a[1] * b[2] - a[2] * b[1];
+        c[1] = a[2] * b[0] - a[0] * b[2];
+        c[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline void
+    sub(double const a[3], double const b[3], double c[3]) {
+        c[0] = a[0] - b[0];
+        c[1] = a[1] - b[1];
+        c[2] = a[2] - b[2];
+    }
+
+    //  Moller-Trumbore -- returns the ray parameter and barycentrics of
+    //  the hit with a small tolerance to avoid cracks between triangles:
+    bool
+    intersectTriangle(double const o[3], double const d[3],
+                      double const A[3], double const B[3], double const C[3],
+                      double & t, double & b1, double & b2) {
+
+        double const kEpsilon = 1.0e-6;
+
+        double AB[3], AC[3], p[3], AO[3], q[3];
+        sub(B, A, AB);
+        sub(C, A, AC);
+        cross(d, AC, p);
+
+        double det = dot(AB, p);
+        if (std::fabs(det) < 1.0e-20) return false;
+        double invDet = 1.0 / det;
+
+        sub(o, A, AO);
+        b1 = dot(AO, p) * invDet;
+        if ((b1 < -kEpsilon) || (b1 > 1.0 + kEpsilon)) return false;
+
+        cross(AO, AB, q);
+        b2 = dot(d, q) * invDet;
+        if ((b2 < -kEpsilon) || (b1 + b2 > 1.0 + kEpsilon)) return false;
+
+        t = dot(AC, q) * invDet;
+        return true;
+    }
+}
+
+//
+//  Per-ray state while traversing -- tMax shrinks to the closest hit:
+//
+struct PatchRayIntersector::RayState {
+    double origin[3];
+    double direction[3];
+    float  originF[3];
+    float  invDir[3];
+    float  tMin;
+    float  tMax;
+
+    void Init(Ray const & ray) {
+        for (int k = 0; k < 3; ++k) {
+            origin[k]    = ray.origin[k];
+            direction[k] = ray.direction[k];
+            originF[k]   = ray.origin[k];
+            invDir[k]    = 1.0f / ray.direction[k];
+        }
+        tMin = ray.tMin;
+        tMax = ray.tMax;
+    }
+
+    bool Clip(PatchBVH::Bounds const & bounds) const {
+        float t0 = tMin, t1 = tMax;
+        return bounds.ClipRay(originF, invDir, t0, t1);
+    }
+};
+
+//
+//  Sub-domain of a patch within its ptex face and the limit positions at
+//  its corners (ordered (u0,v0), (u1,v0), (u1,v1), (u0,v1)):
+//
+struct PatchRayIntersector::SubDomain {
+    double u0, v0, u1, v1;
+    double P[4][3];
+};
+
+//
+//  Definitions of PatchRayIntersector methods:
+//
+int const PatchRayIntersector::kPacketSize;
+
+PatchRayIntersector::PatchRayIntersector(PatchTable const & patchTable,
+                                         float const points[],
+                                         PatchBVH const & bvh,
+                                         Options const & options) :
+        _patchTable(patchTable), _points(points), _bvh(bvh),
+        _options(options) {
+
+    assert(bvh.IsValid());
+}
+
+void
+PatchRayIntersector::evaluate(PatchTable::PatchHandle const & handle,
+                              double u, double v, double P[3], double Du[3],
+                              double Dv[3]) const {
+
+    double wP[20], wDu[20], wDv[20];
+
+    bool needDerivs = (Du != 0);
+    _patchTable.EvaluateBasis(handle, u, v, wP, needDerivs ? wDu : 0,
+                                                needDerivs ? wDv : 0);
+
+    Far::ConstIndexArray cvs = _patchTable.GetPatchVertices(handle);
+
+    double * results[3] = { P, Du, Dv };
+    double * weights[3] = { wP, wDu, wDv };
+
+    int numResults = needDerivs ? 3 : 1;
+    for (int j = 0; j < numResults; ++j) {
+        double * dst = results[j];
+        double * w   = weights[j];
+
+        dst[0] = dst[1] = dst[2] = 0.0;
+        for (int i = 0; i < cvs.size(); ++i) {
+            if (w[i] == 0.0) continue;
+
+            float const * cv = _points + 3 * cvs[i];
+            dst[0] += w[i] * cv[0];
+            dst[1] += w[i] * cv[1];
+            dst[2] += w[i] * cv[2];
+        }
+    }
+}
+
+bool
+PatchRayIntersector::polishHit(int patch, double uvt[3], RayState const & ray,
+                               double const domainBounds[4],
+                               Hit & hit) const {
+
+    PatchTable::PatchHandle const & handle = _bvh.GetPatchHandle(patch);
+
+    PatchBVH::Bounds const & bounds = _bvh.GetPatchBounds(patch);
+    double size = std::max(std::max(bounds.max[0] - bounds.min[0],
+                                    bounds.max[1] - bounds.min[1]),
+                                    bounds.max[2] - bounds.min[2]);
+    double tolerance = 1.0e-6 * size;
+
+    double const * d = ray.direction;
+
+    //
+    //  Newton iteration on F(u,v,t) = S(u,v) - (origin + t * direction):
+    //
+    double P[3], Du[3], Dv[3], F[3];
+    for (int iteration = 0; ; ++iteration) {
+        evaluate(handle, uvt[0], uvt[1], P, Du, Dv);
+        for (int k = 0; k < 3; ++k) {
+            F[k] = P[k] - (ray.origin[k] + uvt[2] * d[k]);
+        }
+        if ((std::sqrt(dot(F, F)) < tolerance) ||
+            (iteration == _options.maxNewtonIterations)) break;
+
+        //  Solve [Du Dv -d] x = -F by Cramer's rule:
+        double minusD[3] = { -d[0], -d[1], -d[2] };
+        double c0[3], c1[3], c2[3];
+        cross(Dv, minusD, c0);
+        cross(minusD, Du, c1);
+        cross(Du, Dv, c2);
+
+        double det = dot(Du, c0);
+        if (std::fabs(det) < 1.0e-30) break;
+
+        uvt[0] -= dot(F, c0) / det;
+        uvt[1] -= dot(F, c1) / det;
+        uvt[2] -= dot(F, c2) / det;
+    }
+
+    //
+    //  Reject hits outside the patch (within a small tolerance) -- they are
+    //  found by the neighboring patch -- and hits that did not converge:
+    //
+    double uTol = 1.0e-6 * (domainBounds[2] - domainBounds[0]);
+    double vTol = 1.0e-6 * (domainBounds[3] - domainBounds[1]);
+    if ((uvt[0] < domainBounds[0] - uTol) || (uvt[0] > domainBounds[2] + uTol) ||
+        (uvt[1] < domainBounds[1] - vTol) || (uvt[1] > domainBounds[3] + vTol)) {
+        return false;
+    }
+    if (std::sqrt(dot(F, F)) > 1.0e3 * tolerance) return false;
+    if ((uvt[2] < ray.tMin) || (uvt[2] >= ray.tMax)) return false;
+
+    double N[3];
+    cross(Du, Dv, N);
+    double lenN = std::sqrt(dot(N, N));
+    if (lenN > 0.0) {
+        N[0] /= lenN; N[1] /= lenN; N[2] /= lenN;
+    }
+
+    hit.faceId     = _patchTable.GetPatchParam(handle).GetFaceId();
+    hit.patchIndex = handle.patchIndex;
+    hit.s          = (float) std::min(std::max(uvt[0], domainBounds[0]), domainBounds[2]);
+    hit.t          = (float) std::min(std::max(uvt[1], domainBounds[1]), domainBounds[3]);
+    hit.distance   = (float) uvt[2];
+    for (int k = 0; k < 3; ++k) {
+        hit.P[k] = (float) P[k];
+        hit.N[k] = (float) N[k];
+    }
+    return true;
+}
+
+void
+PatchRayIntersector::intersectSubDomain(int patch, SubDomain const & domain,
+                                        int depth, RayState & ray,
+                                        Hit & hit) const {
+
+    PatchTable::PatchHandle const & handle = _bvh.GetPatchHandle(patch);
+
+    double uMid = 0.5 * (domain.u0 + domain.u1);
+    double vMid = 0.5 * (domain.v0 + domain.v1);
+
+    //
+    //  Deviation of the center from the bilinear interpolation of the
+    //  corners -- a measure of flatness and the inflation of the bounds:
+    //
+    double center[3];
+    evaluate(handle, uMid, vMid, center);
+
+    double deviation[3];
+    for (int k = 0; k < 3; ++k) {
+        deviation[k] = center[k] - 0.25 * (domain.P[0][k] + domain.P[1][k] +
+                                           domain.P[2][k] + domain.P[3][k]);
+    }
+    double error = std::sqrt(dot(deviation, deviation));
+
+    PatchBVH::Bounds bounds;
+    bounds.Clear();
+    for (int i = 0; i < 4; ++i) {
+        float p[3] = { (float)domain.P[i][0], (float)domain.P[i][1],
+                       (float)domain.P[i][2] };
+        bounds.Add(p);
+    }
+    float c[3] = { (float)center[0], (float)center[1], (float)center[2] };
+    bounds.Add(c);
+
+    double size = std::max(std::max(bounds.max[0] - bounds.min[0],
+                                    bounds.max[1] - bounds.min[1]),
+                                    bounds.max[2] - bounds.min[2]);
+
+    //  The bounds of the whole patch were tested by the caller:
+    if (depth > 0) {
+        float inflate = (float) (2.0 * error + 1.0e-4 * size);
+        for (int k = 0; k < 3; ++k) {
+            bounds.min[k] -= inflate;
+            bounds.max[k] += inflate;
+        }
+        if (!ray.Clip(bounds)) return;
+    }
+
+    if ((depth == _options.maxDepth) || (error <= _options.flatness * size)) {
+        Far::PatchParam param = _patchTable.GetPatchParam(handle);
+
+        double domainBounds[4] = { 0.0, 0.0, 1.0, 1.0 };
+        param.Unnormalize(domainBounds[0], domainBounds[1]);
+        param.Unnormalize(domainBounds[2], domainBounds[3]);
+
+        double uv[4][2] = { { domain.u0, domain.v0 }, { domain.u1, domain.v0 },
+                            { domain.u1, domain.v1 }, { domain.u0, domain.v1 } };
+
+        int const triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+        for (int i = 0; i < 2; ++i) {
+            int const * tri = triangles[i];
+
+            double t, b1, b2;
+            if (!intersectTriangle(ray.origin, ray.direction, domain.P[tri[0]],
+                    domain.P[tri[1]], domain.P[tri[2]], t, b1, b2)) continue;
+
+            double uvt[3];
+            for (int k = 0; k < 2; ++k) {
+                uvt[k] = uv[tri[0]][k] + b1 * (uv[tri[1]][k] - uv[tri[0]][k]) +
+                                         b2 * (uv[tri[2]][k] - uv[tri[0]][k]);
+            }
+            uvt[2] = t;
+
+            if (polishHit(patch, uvt, ray, domainBounds, hit)) {
+                ray.tMax = hit.distance;
+            }
+        }
+        return;
+    }
+
+    //
+    //  Split into four -- evaluating the midpoints of the edges:
+    //
+    double edgeMid[4][3];
+    evaluate(handle, uMid, domain.v0, edgeMid[0]);
+    evaluate(handle, domain.u1, vMid, edgeMid[1]);
+    evaluate(handle, uMid, domain.v1, edgeMid[2]);
+    evaluate(handle, domain.u0, vMid, edgeMid[3]);
+
+    double const * const corners[4][4] = {
+        { domain.P[0], edgeMid[0], center, edgeMid[3] },
+        { edgeMid[0], domain.P[1], edgeMid[1], center },
+        { center, edgeMid[1], domain.P[2], edgeMid[2] },
+        { edgeMid[3], center, edgeMid[2], domain.P[3] } };
+
+    double const us[3] = { domain.u0, uMid, domain.u1 };
+    double const vs[3] = { domain.v0, vMid, domain.v1 };
+
+    for (int q = 0; q < 4; ++q) {
+        int uIndex = (q == 1 || q == 2);
+        int vIndex = (q >= 2);
+
+        SubDomain child;
+        child.u0 = us[uIndex];
+        child.u1 = us[uIndex + 1];
+        child.v0 = vs[vIndex];
+        child.v1 = vs[vIndex + 1];
+        for (int i = 0; i < 4; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                child.P[i][k] = corners[q][i][k];
+            }
+        }
+        intersectSubDomain(patch, child, depth + 1, ray, hit);
+    }
+}
+
+void
+PatchRayIntersector::intersectPatch(int patch, RayState & ray,
+                                    Hit & hit) const {
+
+    PatchTable::PatchHandle const & handle = _bvh.GetPatchHandle(patch);
+
+    Far::PatchParam param = _patchTable.GetPatchParam(handle);
+
+    SubDomain domain;
+    domain.u0 = 0.0;
+    domain.v0 = 0.0;
+    domain.u1 = 1.0;
+    domain.v1 = 1.0;
+    param.Unnormalize(domain.u0, domain.v0);
+    param.Unnormalize(domain.u1, domain.v1);
+
+    evaluate(handle, domain.u0, domain.v0, domain.P[0]);
+    evaluate(handle, domain.u1, domain.v0, domain.P[1]);
+    evaluate(handle, domain.u1, domain.v1, domain.P[2]);
+    evaluate(handle, domain.u0, domain.v1, domain.P[3]);
+
+    intersectSubDomain(patch, domain, 0, ray, hit);
+}
+
+void
+PatchRayIntersector::intersectPacket(int numRays, Ray const rays[],
+                                     Hit hits[]) const {
+
+    assert(numRays <= kPacketSize);
+
+    RayState states[kPacketSize];
+    for (int i = 0; i < numRays; ++i) {
+        states[i].Init(rays[i]);
+
+        hits[i].faceId     = -1;
+        hits[i].patchIndex = -1;
+        hits[i].distance   = rays[i].tMax;
+    }
+    if (_bvh.GetNumNodes() == 0) return;
+
+    //
+    //  Traverse the BVH once for the whole packet -- a node is visited if
+    //  any ray of the packet intersects it within its current interval:
+    //
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        int nodeIndex = stack[--stackSize];
+
+        PatchBVH::Node const & node = _bvh.GetNode(nodeIndex);
+
+        unsigned int activeMask = 0;
+        for (int i = 0; i < numRays; ++i) {
+            if (states[i].Clip(node.bounds)) activeMask |= (1u << i);
+        }
+        if (activeMask == 0) continue;
+
+        if (!node.IsLeaf()) {
+            assert(stackSize + 2 <= 64);
+            stack[stackSize++] = node.secondChild;
+            stack[stackSize++] = nodeIndex + 1;
+            continue;
+        }
+
+        int const * patches = _bvh.GetLeafPatches() + node.first;
+        for (int j = 0; j < node.count; ++j) {
+            PatchBVH::Bounds const & bounds = _bvh.GetPatchBounds(patches[j]);
+            for (int i = 0; i < numRays; ++i) {
+                if ((activeMask & (1u << i)) && states[i].Clip(bounds)) {
+                    intersectPatch(patches[j], states[i], hits[i]);
+                }
+            }
+        }
+    }
+}
+
+bool
+PatchRayIntersector::Intersect(Ray const & ray, Hit & hit) const {
+
+    intersectPacket(1, &ray, &hit);
+    return hit.faceId >= 0;
+}
+
+void
+PatchRayIntersector::IntersectRays(int numRays, Ray const rays[], Hit hits[],
+                                   int numThreads) const {
+
+    int numPackets = (numRays + kPacketSize - 1) / kPacketSize;
+
+    ParallelFor(0, numPackets, 16, [&](int begin, int end) {
+        for (int packet = begin; packet < end; ++packet) {
+            int first = packet * kPacketSize;
+            intersectPacket(std::min(kPacketSize, numRays - first),
+                            rays + first, hits + first);
+        }
+    }, numThreads);
+}
+
+} // end namespace
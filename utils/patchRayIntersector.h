@@ -0,0 +1,101 @@
+#ifndef PATCH_RAY_INTERSECTOR_H
+#define PATCH_RAY_INTERSECTOR_H
+
+#include "patchBVH.h"
+
+#include <opensubdiv/far/patchTable.h>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Ray intersection with the limit surface of a Far::PatchTable.
+//
+//  Candidate patches are identified through a PatchBVH.  The domain of
+//  each candidate is then subdivided adaptively -- a sub-domain is split
+//  while its surface deviates from the bilinear interpolation of its
+//  corners by more than a fraction of its size -- and sub-domains whose
+//  estimated bounds miss the ray are discarded.  The ray is intersected
+//  with the two triangles of each flat enough sub-domain and the hit is
+//  polished by Newton iteration on S(u,v) - (origin + t * direction) = 0,
+//  so that the result lies on the limit surface itself and not on the
+//  approximation used to find it.
+//
+//  Bounds of whole patches are conservative, but those of sub-domains are
+//  estimated from the samples evaluated (inflated by the deviation from
+//  the bilinear interpolation), which is accurate once the subdivision is
+//  fine relative to the curvature of the patch.
+//
+//  Rays are intersected in packets:  rays of a packet traverse the BVH
+//  together, so that coherent rays (e.g. neighboring pixels) share the
+//  nodes they visit.  Packets are distributed across threads.
+//
+class PatchRayIntersector {
+public:
+    typedef OpenSubdiv::Far::PatchTable PatchTable;
+
+    struct Options {
+        Options() : maxDepth(6), flatness(0.01f), maxNewtonIterations(6) { }
+
+        int   maxDepth;             // maximum subdivision of a patch domain
+        float flatness;             // deviation relative to sub-domain size
+        int   maxNewtonIterations;
+    };
+
+    struct Ray {
+        float origin[3];
+        float direction[3];
+        float tMin;
+        float tMax;
+    };
+
+    struct Hit {
+        int   faceId;      // ptex face, -1 if the ray misses
+        int   patchIndex;
+        float s, t;        // location within the ptex face
+        float distance;    // ray parameter of the hit
+        float P[3];
+        float N[3];        // unit normal
+    };
+
+    //  Number of rays traversing the BVH together:
+    static int const kPacketSize = 8;
+
+public:
+    //  The PatchBVH must have been built from the same patches and points:
+    PatchRayIntersector(PatchTable const & patchTable, float const points[],
+                        PatchBVH const & bvh,
+                        Options const & options = Options());
+
+    //  Returns false if the ray misses the surface within [tMin, tMax]:
+    bool Intersect(Ray const & ray, Hit & hit) const;
+
+    //  Intersect many rays -- in packets of consecutive rays, in parallel:
+    void IntersectRays(int numRays, Ray const rays[], Hit hits[],
+                       int numThreads = 0) const;
+
+private:
+    struct RayState;
+    struct SubDomain;
+
+    void intersectPacket(int numRays, Ray const rays[], Hit hits[]) const;
+
+    void intersectPatch(int patch, RayState & ray, Hit & hit) const;
+    void intersectSubDomain(int patch, SubDomain const & domain, int depth,
+                            RayState & ray, Hit & hit) const;
+    bool polishHit(int patch, double uvt[3], RayState const & ray,
+                   double const domainBounds[4], Hit & hit) const;
+
+    void evaluate(PatchTable::PatchHandle const & handle, double u, double v,
+                  double P[3], double Du[3] = 0, double Dv[3] = 0) const;
+
+private:
+    PatchTable const & _patchTable;
+    float const *      _points;
+    PatchBVH const &   _bvh;
+    Options            _options;
+};
+
+} // end namespace
+
+#endif /* PATCH_RAY_INTERSECTOR_H */
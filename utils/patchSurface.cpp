@@ -0,0 +1,115 @@
+#include "patchSurface.h"
+
+#include <opensubdiv/far/patchTableFactory.h>
+#include <opensubdiv/far/primvarRefiner.h>
+#include <opensubdiv/far/ptexIndices.h>
+
+#include <cassert>
+#include <cstring>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    //  Minimal Vertex interface for Far::PrimvarRefiner and StencilTable:
+    struct Point3 {
+        void Clear() { p[0] = p[1] = p[2] = 0.0f; }
+
+        void AddWithWeight(Point3 const & src, float weight) {
+            p[0] += weight * src.p[0];
+            p[1] += weight * src.p[1];
+            p[2] += weight * src.p[2];
+        }
+
+        float p[3];
+    };
+}
+
+//
+//  Definitions of PatchSurface methods:
+//
+PatchSurface::PatchSurface(TopologyRefiner & refiner,
+                           std::vector<float> const & coarsePositions,
+                           int maxPatchLevel) {
+
+    Far::PatchTableFactory::Options patchOptions(maxPatchLevel);
+    patchOptions.SetPatchPrecision<float>();
+    patchOptions.useInfSharpPatch = true;
+    patchOptions.generateVaryingTables = false;
+    patchOptions.endCapType =
+        Far::PatchTableFactory::Options::ENDCAP_GREGORY_BASIS;
+
+    refiner.RefineAdaptive(patchOptions.GetRefineAdaptiveOptions());
+
+    _patchTable = Far::PatchTableFactory::Create(refiner, patchOptions);
+    _patchMap   = new Far::PatchMap(*_patchTable);
+
+    _numPtexFaces = Far::PtexIndices(refiner).GetNumFaces();
+
+    //
+    //  Interpolate the refined vertices level by level, then the local
+    //  points, into a single buffer of points:
+    //
+    int numCoarse   = refiner.GetLevel(0).GetNumVertices();
+    int numRefined  = refiner.GetNumVerticesTotal();
+    int numLocal    = _patchTable->GetNumLocalPoints();
+
+    assert((int)coarsePositions.size() >= 3 * numCoarse);
+
+    _points.resize(3 * (numRefined + numLocal));
+    std::memcpy(&_points[0], &coarsePositions[0], 3 * numCoarse * sizeof(float));
+
+    Point3 * points = reinterpret_cast<Point3 *>(&_points[0]);
+
+    Far::PrimvarRefiner primvarRefiner(refiner);
+
+    Point3 * src = points;
+    for (int level = 1; level < refiner.GetNumLevels(); ++level) {
+        Point3 * dst = src + refiner.GetLevel(level - 1).GetNumVertices();
+        primvarRefiner.Interpolate(level, src, dst);
+        src = dst;
+    }
+    if (numLocal) {
+        _patchTable->GetLocalPointStencilTable()->UpdateValues(points,
+                                                      points + numRefined);
+    }
+}
+
+PatchSurface::~PatchSurface() {
+
+    delete _patchMap;
+    delete _patchTable;
+}
+
+bool
+PatchSurface::Evaluate(int faceId, float s, float t, float P[3],
+                       float Du[3], float Dv[3]) const {
+
+    PatchTable::PatchHandle const * handle = _patchMap->FindPatch(faceId, s, t);
+    if (handle == 0) return false;
+
+    float wP[20], wDu[20], wDv[20];
+    _patchTable->EvaluateBasis(*handle, s, t, wP, wDu, wDv);
+
+    Far::ConstIndexArray cvs = _patchTable->GetPatchVertices(*handle);
+
+    float * results[3] = { P, Du, Dv };
+    float * weights[3] = { wP, wDu, wDv };
+    for (int j = 0; j < 3; ++j) {
+        float * dst = results[j];
+        if (dst == 0) continue;
+
+        dst[0] = dst[1] = dst[2] = 0.0f;
+        for (int i = 0; i < cvs.size(); ++i) {
+            float const * cv = &_points[3 * cvs[i]];
+            dst[0] += weights[j][i] * cv[0];
+            dst[1] += weights[j][i] * cv[1];
+            dst[2] += weights[j][i] * cv[2];
+        }
+    }
+    return true;
+}
+
+} // end namespace
@@ -0,0 +1,57 @@
+#ifndef PATCH_SURFACE_H
+#define PATCH_SURFACE_H
+
+#include <opensubdiv/far/patchMap.h>
+#include <opensubdiv/far/patchTable.h>
+#include <opensubdiv/far/topologyRefiner.h>
+
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  The limit surface of a mesh as a Far::PatchTable, set up as in the 5_1
+//  tutorials -- adaptive refinement to a maximum patch level, Gregory basis
+//  end caps and the positions of all refined vertices and local points --
+//  for the queries that operate on patches rather than on tessellations.
+//
+class PatchSurface {
+public:
+    typedef OpenSubdiv::Far::TopologyRefiner TopologyRefiner;
+    typedef OpenSubdiv::Far::PatchTable      PatchTable;
+
+    //  Refines the given refiner adaptively and interpolates the coarse
+    //  positions (xyz triples) to all points of the PatchTable:
+    PatchSurface(TopologyRefiner & refiner,
+                 std::vector<float> const & coarsePositions,
+                 int maxPatchLevel);
+    ~PatchSurface();
+
+    //  The PatchTable and PatchMap owned are not copied:
+    PatchSurface(PatchSurface const &) = delete;
+    PatchSurface & operator=(PatchSurface const &) = delete;
+
+    PatchTable const & GetPatchTable() const { return *_patchTable; }
+
+    //  Positions (xyz) of all points referenced by the PatchTable:
+    float const * GetPoints() const { return _points.data(); }
+    int GetNumPoints() const        { return (int)_points.size() / 3; }
+
+    int GetNumPtexFaces() const { return _numPtexFaces; }
+
+    //  Evaluate the limit position and optional derivatives at (s,t) on a
+    //  ptex face -- returns false if no patch is found:
+    bool Evaluate(int faceId, float s, float t, float P[3],
+                  float Du[3] = 0, float Dv[3] = 0) const;
+
+private:
+    PatchTable const *            _patchTable;
+    OpenSubdiv::Far::PatchMap *   _patchMap;
+    std::vector<float>            _points;
+    int                           _numPtexFaces;
+};
+
+} // end namespace
+
+#endif /* PATCH_SURFACE_H */
@@ -0,0 +1,374 @@
+#include "quantization.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    float const kSnormScale = 32767.0f;
+    float const kUnormScale = 65535.0f;
+
+    //
+    //  Octahedral projection of a unit vector:  the vector is scaled to
+    //  the octahedron |x| + |y| + |z| = 1 and the lower half (z < 0) is
+    //  folded over the diagonals of the upper half, onto the square
+    //  [-1, 1] x [-1, 1]:
+    //
+    inline float signOf(float a) { return std::copysign(1.0f, a); }
+
+    inline void
+    encodeOct(float const n[3], short e[2]) {
+
+        float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+        float l1Inv = (l1 > 0.0f) ? (1.0f / l1) : 0.0f;
+
+        float x = n[0] * l1Inv;
+        float y = n[1] * l1Inv;
+        if (n[2] < 0.0f) {
+            float xFolded = (1.0f - std::abs(y)) * signOf(x);
+            float yFolded = (1.0f - std::abs(x)) * signOf(y);
+            x = xFolded;
+            y = yFolded;
+        }
+        e[0] = (short) std::floor(x * kSnormScale + 0.5f);
+        e[1] = (short) std::floor(y * kSnormScale + 0.5f);
+    }
+
+    inline void
+    decodeOct(short const e[2], float n[3]) {
+
+        float x = std::max((float) e[0] / kSnormScale, -1.0f);
+        float y = std::max((float) e[1] / kSnormScale, -1.0f);
+        float z = 1.0f - std::abs(x) - std::abs(y);
+        if (z < 0.0f) {
+            float xUnfolded = (1.0f - std::abs(y)) * signOf(x);
+            float yUnfolded = (1.0f - std::abs(x)) * signOf(y);
+            x = xUnfolded;
+            y = yUnfolded;
+        }
+        float lenInv = 1.0f / std::sqrt(x * x + y * y + z * z);
+        n[0] = x * lenInv;
+        n[1] = y * lenInv;
+        n[2] = z * lenInv;
+    }
+
+    inline unsigned short
+    encodeUnorm(float t) {
+        return (unsigned short) (std::min(std::max(t, 0.0f), 1.0f) * kUnormScale + 0.5f);
+    }
+
+    //  Scales mapping the extent of a box to and from [0, 65535]:
+    inline float
+    getEncodeScale(float extent) {
+        return (extent > 0.0f) ? (kUnormScale / extent) : 0.0f;
+    }
+    inline float
+    getDecodeScale(float extent) {
+        return extent / kUnormScale;
+    }
+
+    inline unsigned short
+    encodeScaled(float t) {
+        return (unsigned short) (std::min(std::max(t, 0.0f), kUnormScale) + 0.5f);
+    }
+
+#if defined(__AVX2__)
+    //
+    //  8 unorm values (already scaled to [0, 65535]) packed as 16 bits:
+    //
+    inline void
+    storeScaledUnorms(unsigned short * e, __m256 t) {
+
+        t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()),
+                          _mm256_set1_ps(kUnormScale));
+        __m256i i = _mm256_cvttps_epi32(_mm256_add_ps(t, _mm256_set1_ps(0.5f)));
+        _mm_storeu_si128((__m128i *) e,
+                         _mm_packus_epi32(_mm256_castsi256_si128(i),
+                                          _mm256_extracti128_si256(i, 1)));
+    }
+
+    //
+    //  8 normals -- the components are gathered from the triples and the
+    //  two 16-bit values of each are stored as one 32-bit value:
+    //
+    inline void
+    encodeOctBlock(float const * n, short * e) {
+
+        __m256i const offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        __m256 const signBit = _mm256_set1_ps(-0.0f);
+        __m256 const one     = _mm256_set1_ps(1.0f);
+
+        __m256 nx = _mm256_i32gather_ps(n,     offsets, 4);
+        __m256 ny = _mm256_i32gather_ps(n + 1, offsets, 4);
+        __m256 nz = _mm256_i32gather_ps(n + 2, offsets, 4);
+
+        __m256 ax = _mm256_andnot_ps(signBit, nx);
+        __m256 ay = _mm256_andnot_ps(signBit, ny);
+        __m256 az = _mm256_andnot_ps(signBit, nz);
+
+        __m256 l1 = _mm256_add_ps(_mm256_add_ps(ax, ay), az);
+        __m256 l1Inv = _mm256_and_ps(_mm256_div_ps(one, l1),
+                            _mm256_cmp_ps(l1, _mm256_setzero_ps(), _CMP_GT_OQ));
+
+        __m256 x = _mm256_mul_ps(nx, l1Inv);
+        __m256 y = _mm256_mul_ps(ny, l1Inv);
+
+        __m256 xSign = _mm256_or_ps(one, _mm256_and_ps(signBit, x));
+        __m256 ySign = _mm256_or_ps(one, _mm256_and_ps(signBit, y));
+        __m256 xFolded = _mm256_mul_ps(_mm256_sub_ps(one,
+                            _mm256_andnot_ps(signBit, y)), xSign);
+        __m256 yFolded = _mm256_mul_ps(_mm256_sub_ps(one,
+                            _mm256_andnot_ps(signBit, x)), ySign);
+
+        __m256 isLower = _mm256_cmp_ps(nz, _mm256_setzero_ps(), _CMP_LT_OQ);
+        x = _mm256_blendv_ps(x, xFolded, isLower);
+        y = _mm256_blendv_ps(y, yFolded, isLower);
+
+        __m256 const scale = _mm256_set1_ps(kSnormScale);
+        __m256 const half  = _mm256_set1_ps(0.5f);
+        __m256i ex = _mm256_cvttps_epi32(_mm256_floor_ps(
+                            _mm256_add_ps(_mm256_mul_ps(x, scale), half)));
+        __m256i ey = _mm256_cvttps_epi32(_mm256_floor_ps(
+                            _mm256_add_ps(_mm256_mul_ps(y, scale), half)));
+
+        __m256i packed = _mm256_or_si256(
+                _mm256_and_si256(ex, _mm256_set1_epi32(0xffff)),
+                _mm256_slli_epi32(ey, 16));
+        _mm256_storeu_si256((__m256i *) e, packed);
+    }
+#endif
+}
+
+//
+//  Normals:
+//
+void
+EncodeOctNormals(int count, float const normals[], short encoded[]) {
+
+    int i = 0;
+#if defined(__AVX2__)
+    for ( ; i + 8 <= count; i += 8) {
+        encodeOctBlock(normals + 3 * (size_t) i, encoded + 2 * (size_t) i);
+    }
+#endif
+    for ( ; i < count; ++i) {
+        encodeOct(normals + 3 * (size_t) i, encoded + 2 * (size_t) i);
+    }
+}
+
+void
+DecodeOctNormals(int count, short const encoded[], float normals[]) {
+
+    for (int i = 0; i < count; ++i) {
+        decodeOct(encoded + 2 * (size_t) i, normals + 3 * (size_t) i);
+    }
+}
+
+//
+//  Rounding errs by half a step (1/32767) in each of the two encoded
+//  values, and the unit vector moves by at most sqrt(18) times as much
+//  as the point of the octahedron (at least 1/sqrt(3) from the origin):
+//
+float
+GetOctNormalErrorBound() {
+
+    return 3.0f * std::sqrt(2.0f) * 0.5f / kSnormScale + 4.0f * FLT_EPSILON;
+}
+
+float
+MeasureOctNormalError(int count, float const normals[], short const encoded[]) {
+
+    //  The angle from the cross and dot products (acos() of the dot product
+    //  alone is too imprecise for small angles):
+    double maxAngle = 0.0;
+    for (int i = 0; i < count; ++i) {
+        float const * n = normals + 3 * (size_t) i;
+        if ((n[0] == 0.0f) && (n[1] == 0.0f) && (n[2] == 0.0f)) continue;
+
+        float d[3];
+        decodeOct(encoded + 2 * (size_t) i, d);
+
+        double cx = (double) n[1] * d[2] - (double) n[2] * d[1];
+        double cy = (double) n[2] * d[0] - (double) n[0] * d[2];
+        double cz = (double) n[0] * d[1] - (double) n[1] * d[0];
+        double dot = (double) n[0] * d[0] + (double) n[1] * d[1] + (double) n[2] * d[2];
+
+        maxAngle = std::max(maxAngle,
+                            std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot));
+    }
+    return (float) maxAngle;
+}
+
+//
+//  UVs:
+//
+void
+EncodeUnormUVs(int count, float const uvs[], unsigned short encoded[]) {
+
+    int numValues = 2 * count;
+
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 const scale = _mm256_set1_ps(kUnormScale);
+    for ( ; i + 8 <= numValues; i += 8) {
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(uvs + i),
+                                               _mm256_setzero_ps()),
+                                 _mm256_set1_ps(1.0f));
+        storeScaledUnorms(encoded + i, _mm256_mul_ps(t, scale));
+    }
+#endif
+    for ( ; i < numValues; ++i) {
+        encoded[i] = encodeUnorm(uvs[i]);
+    }
+}
+
+void
+DecodeUnormUVs(int count, unsigned short const encoded[], float uvs[]) {
+
+    for (int i = 0; i < 2 * count; ++i) {
+        uvs[i] = (float) encoded[i] / kUnormScale;
+    }
+}
+
+//  For UVs within [0, 1] -- half a step:
+float
+GetUnormUVErrorBound() {
+
+    return 0.5f / kUnormScale + FLT_EPSILON;
+}
+
+float
+MeasureUnormUVError(int count, float const uvs[], unsigned short const encoded[]) {
+
+    float maxError = 0.0f;
+    for (int i = 0; i < 2 * count; ++i) {
+        maxError = std::max(maxError,
+                            std::abs((float) encoded[i] / kUnormScale - uvs[i]));
+    }
+    return maxError;
+}
+
+//
+//  Positions:
+//
+QuantizationBox::QuantizationBox() {
+
+    min[0] = min[1] = min[2] = 0.0f;
+    extent[0] = extent[1] = extent[2] = 0.0f;
+}
+
+QuantizationBox
+QuantizationBox::Bound(int count, float const positions[]) {
+
+    QuantizationBox box;
+    if (count <= 0) return box;
+
+    float lo[3] = { positions[0], positions[1], positions[2] };
+    float hi[3] = { positions[0], positions[1], positions[2] };
+    for (int i = 1; i < count; ++i) {
+        float const * p = positions + 3 * (size_t) i;
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        box.min[k]    = lo[k];
+        box.extent[k] = hi[k] - lo[k];
+    }
+    return box;
+}
+
+//  Half a step of the largest extent, and the rounding of the arithmetic
+//  in float relative to the magnitude of the coordinates:
+float
+QuantizationBox::GetErrorBound() const {
+
+    float bound = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        float magnitude = std::abs(min[k]) + extent[k];
+        bound = std::max(bound, 0.5f * extent[k] / kUnormScale +
+                                4.0f * FLT_EPSILON * magnitude);
+    }
+    return bound;
+}
+
+void
+EncodePositions(int count, float const positions[],
+                QuantizationBox const & box, unsigned short encoded[]) {
+
+    float scale[3] = { getEncodeScale(box.extent[0]),
+                       getEncodeScale(box.extent[1]),
+                       getEncodeScale(box.extent[2]) };
+
+    int numValues = 3 * count;
+
+    int i = 0;
+#if defined(__AVX2__)
+    //  Blocks of 24 values (8 positions) -- three registers whose lanes
+    //  repeat the pattern of the 3 coordinates:
+    __m256 blockMin[3], blockScale[3];
+    for (int r = 0; r < 3; ++r) {
+        float m[8], s[8];
+        for (int k = 0; k < 8; ++k) {
+            m[k] = box.min[(8 * r + k) % 3];
+            s[k] = scale[(8 * r + k) % 3];
+        }
+        blockMin[r]   = _mm256_loadu_ps(m);
+        blockScale[r] = _mm256_loadu_ps(s);
+    }
+    for ( ; i + 24 <= numValues; i += 24) {
+        for (int r = 0; r < 3; ++r) {
+            __m256 p = _mm256_loadu_ps(positions + i + 8 * r);
+            storeScaledUnorms(encoded + i + 8 * r,
+                    _mm256_mul_ps(_mm256_sub_ps(p, blockMin[r]), blockScale[r]));
+        }
+    }
+#endif
+    for ( ; i < numValues; ++i) {
+        int k = i % 3;
+        encoded[i] = encodeScaled((positions[i] - box.min[k]) * scale[k]);
+    }
+}
+
+void
+DecodePositions(int count, unsigned short const encoded[],
+                QuantizationBox const & box, float positions[]) {
+
+    float scale[3] = { getDecodeScale(box.extent[0]),
+                       getDecodeScale(box.extent[1]),
+                       getDecodeScale(box.extent[2]) };
+
+    for (int i = 0; i < count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            positions[3 * i + k] = box.min[k] + (float) encoded[3 * i + k] * scale[k];
+        }
+    }
+}
+
+float
+MeasurePositionError(int count, float const positions[],
+                     QuantizationBox const & box, unsigned short const encoded[]) {
+
+    float scale[3] = { getDecodeScale(box.extent[0]),
+                       getDecodeScale(box.extent[1]),
+                       getDecodeScale(box.extent[2]) };
+
+    float maxError = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            float decoded = box.min[k] + (float) encoded[3 * i + k] * scale[k];
+            maxError = std::max(maxError, std::abs(decoded - positions[3 * i + k]));
+        }
+    }
+    return maxError;
+}
+
+} // end namespace
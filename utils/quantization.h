@@ -0,0 +1,70 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Compact encodings of vertex attributes in 16-bit integers, each with
+//  its decoding:
+//
+//      normals    octahedral projection, 2 x 16-bit snorm (from 3 floats)
+//      UVs        2 x 16-bit unorm of [0, 1] (values outside are clamped)
+//      positions  3 x 16-bit unorm of a bounding box
+//
+//  Encoding is vectorized with AVX2 when enabled.  The bound of the error
+//  of each encoding is given with it, and the largest error of a set of
+//  encoded values can be measured by decoding them.
+//
+enum QuantizationFlags {
+    QUANTIZE_NORMALS   = 1,
+    QUANTIZE_UVS       = 2,
+    QUANTIZE_POSITIONS = 4
+};
+
+//
+//  Unit normals -- errors are angles in radians:
+//
+void EncodeOctNormals(int count, float const normals[], short encoded[]);
+void DecodeOctNormals(int count, short const encoded[], float normals[]);
+
+float GetOctNormalErrorBound();
+float MeasureOctNormalError(int count, float const normals[], short const encoded[]);
+
+//
+//  UVs in [0, 1] -- errors are absolute:
+//
+void EncodeUnormUVs(int count, float const uvs[], unsigned short encoded[]);
+void DecodeUnormUVs(int count, unsigned short const encoded[], float uvs[]);
+
+float GetUnormUVErrorBound();
+float MeasureUnormUVError(int count, float const uvs[], unsigned short const encoded[]);
+
+//
+//  Positions relative to a box bounding them -- errors are absolute, the
+//  largest of any coordinate:
+//
+struct QuantizationBox {
+    QuantizationBox();
+
+    //  The box bounding the given positions:
+    static QuantizationBox Bound(int count, float const positions[]);
+
+    float GetErrorBound() const;
+
+    float min[3];
+    float extent[3];
+};
+
+void EncodePositions(int count, float const positions[],
+                     QuantizationBox const & box, unsigned short encoded[]);
+void DecodePositions(int count, unsigned short const encoded[],
+                     QuantizationBox const & box, float positions[]);
+
+float MeasurePositionError(int count, float const positions[],
+                           QuantizationBox const & box,
+                           unsigned short const encoded[]);
+
+} // end namespace
+
+#endif /* QUANTIZATION_H */
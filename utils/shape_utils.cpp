@@ -24,6 +24,7 @@
 
 
 #include "shape_utils.h"
+#include "fastFormat.h"
 
 #include <cassert>
 #include <cstdio>
@@ -258,135 +259,267 @@ void Shape::parseMtllib(char const * mtlstr) {
 }
 
 //------------------------------------------------------------------------------
-std::string Shape::tag::genTag() const {
-    std::stringstream t;
+// The text of tags and shapes is formatted directly into a FormatBuffer --
+// written to a FILE or stream as it fills, rather than built in memory.  Floats
+// are formatted as "%g", as by the std::stringstream originally used, so the
+// text is unchanged.
 
-    t<<"\"t \""<<name<<"\" ";
+static void writeText(tutorial::FormatBuffer & out, std::string const & text) {
+    out.Append(text.data(), text.size());
+}
 
-    t<<intargs.size()<<"/"<<floatargs.size()<<"/"<<stringargs.size()<<" ";
+// A line of floats separated by spaces, between a prefix and a suffix:
+static void writeFloats(tutorial::FormatBuffer & out, char const * prefix,
+                        float const * values, int n, char const * suffix) {
+    size_t prefixLen = strlen(prefix),
+           suffixLen = strlen(suffix);
+
+    char * s = out.Reserve(prefixLen + suffixLen +
+                           n * (tutorial::kMaxNumberLength + 1));
+    memcpy(s, prefix, prefixLen);
+    s += prefixLen;
+    for (int i=0; i<n; ++i) {
+        if (i>0) *s++ = ' ';
+        s = tutorial::FormatGeneral(s, values[i]);
+    }
+    memcpy(s, suffix, suffixLen);
+    out.Commit(s + suffixLen);
+}
 
-    std::copy(intargs.begin(), intargs.end(), std::ostream_iterator<int>(t));
-    t<<" ";
+// Values concatenated without separators (as by std::ostream_iterator):
+static void writeInts(tutorial::FormatBuffer & out,
+                      std::vector<int> const & values) {
+    for (int i=0; i<(int)values.size(); ++i) {
+        char * s = out.Reserve(tutorial::kMaxNumberLength);
+        out.Commit(tutorial::FormatInt(s, values[i]));
+    }
+}
 
-    std::copy(floatargs.begin(), floatargs.end(), std::ostream_iterator<float>(t));
-    t<<" ";
+static void writeFloats(tutorial::FormatBuffer & out,
+                        std::vector<float> const & values) {
+    for (int i=0; i<(int)values.size(); ++i) {
+        char * s = out.Reserve(tutorial::kMaxNumberLength);
+        out.Commit(tutorial::FormatGeneral(s, values[i]));
+    }
+}
 
-    std::copy(stringargs.begin(), stringargs.end(), std::ostream_iterator<std::string>(t));
-    t<<"\\n\"\n";
+static void writeStrings(tutorial::FormatBuffer & out,
+                         std::vector<std::string> const & values) {
+    for (int i=0; i<(int)values.size(); ++i) {
+        writeText(out, values[i]);
+    }
+}
 
-    return t.str();
+// Faces as "<prefix>v/vt/vn v/vt/vn ... <suffix>":
+static void writeFaces(tutorial::FormatBuffer & out, Shape const & shape,
+                       char const * prefix, char const * suffix) {
+    for (int i=0, idx=0; i<(int)shape.nvertsPerFace.size();++i) {
+        out.Append(prefix);
+        for (int j=0; j<shape.nvertsPerFace[i];++j) {
+            int vert = shape.faceverts[idx+j]+1,
+                uv = (int)shape.faceuvs.size()>0 ?
+                     shape.faceuvs[idx+j]+1 : vert,
+                normal = (int)shape.facenormals.size()>0 ?
+                         shape.facenormals[idx+j]+1 : vert;
+
+            char * s = out.Reserve(3 * tutorial::kMaxNumberLength + 3);
+            s = tutorial::FormatInt(s, vert);
+            *s++ = '/';
+            s = tutorial::FormatInt(s, uv);
+            *s++ = '/';
+            s = tutorial::FormatInt(s, normal);
+            *s++ = ' ';
+            out.Commit(s);
+        }
+        out.Append(suffix);
+        idx+=shape.nvertsPerFace[i];
+    }
 }
 
-//------------------------------------------------------------------------------
-std::string Shape::genShape(char const * name) const {
-    std::stringstream sh;
+// The string versions format into a buffer without a FILE -- starting
+// from an estimate of the size of the text, which the buffer grows past
+// as needed:
+static std::string getText(tutorial::FormatBuffer const & buffer) {
+    return buffer.GetSize() ? std::string(buffer.GetText(), buffer.GetSize())
+                            : std::string();
+}
 
-    sh<<"static char const * "<<name<<" = \n";
+static size_t estimateTagSize(Shape::tag const & t) {
+    return 64 + t.name.size() + 12 * t.intargs.size() +
+           16 * t.floatargs.size() + 32 * t.stringargs.size();
+}
 
-    for (int i=0; i<(int)verts.size(); i+=3)
-       sh << "\"v " << verts[i] << " " << verts[i+1] << " " << verts[i+2] <<"\\n\"\n";
+static size_t estimateShapeSize(Shape const & shape) {
+    size_t size = 256 +
+                  16 * (shape.verts.size() + shape.uvs.size() +
+                        shape.normals.size()) +
+                  12 * (shape.faceverts.size() + shape.faceuvs.size() +
+                        shape.facenormals.size() + shape.nvertsPerFace.size());
+    for (int i=0; i<(int)shape.tags.size(); ++i)
+        size += estimateTagSize(*shape.tags[i]);
+    return size;
+}
 
-    for (int i=0; i<(int)uvs.size(); i+=2)
-       sh << "\"vt " << uvs[i] << " " << uvs[i+1] << "\\n\"\n";
+//------------------------------------------------------------------------------
+void Shape::tag::genTag(tutorial::FormatBuffer & out) const {
 
-    for (int i=0; i<(int)normals.size(); i+=3)
-       sh << "\"vn " << normals[i] << " " << normals[i+1] << " " << normals[i+2] <<"\\n\"\n";
+    out.Append("\"t \"");
+    writeText(out, name);
+    out.Append("\" ");
 
-    sh << "\"s off\\n\"\n";
+    char * s = out.Reserve(3 * tutorial::kMaxNumberLength + 3);
+    s = tutorial::FormatInt(s, (long long)intargs.size());
+    *s++ = '/';
+    s = tutorial::FormatInt(s, (long long)floatargs.size());
+    *s++ = '/';
+    s = tutorial::FormatInt(s, (long long)stringargs.size());
+    *s++ = ' ';
+    out.Commit(s);
 
-    for (int i=0, idx=0; i<(int)nvertsPerFace.size();++i) {
-        sh << "\"f ";
-        for (int j=0; j<nvertsPerFace[i];++j) {
-            int vert = faceverts[idx+j]+1,
-                uv = (int)faceuvs.size()>0 ? faceuvs[idx+j]+1 : vert,
-                normal = (int)facenormals.size()>0 ? facenormals[idx+j]+1 : vert;
-            sh << vert << "/" << uv << "/" << normal << " ";
-        }
-        sh << "\\n\"\n";
-        idx+=nvertsPerFace[i];
-    }
+    writeInts(out, intargs);
+    out.Append(" ");
 
-    for (int i=0; i<(int)tags.size(); ++i)
-        sh << tags[i]->genTag();
+    writeFloats(out, floatargs);
+    out.Append(" ");
 
-    return sh.str();
+    writeStrings(out, stringargs);
+    out.Append("\\n\"\n");
+}
+
+std::string Shape::tag::genTag() const {
+    tutorial::FormatBuffer buffer((FILE *)0, estimateTagSize(*this));
+    genTag(buffer);
+    return getText(buffer);
 }
 
 //------------------------------------------------------------------------------
-std::string Shape::genObj() const {
-    std::stringstream sh;
+void Shape::genShape(tutorial::FormatBuffer & out, char const * name) const {
 
-    sh<<"# This file uses centimeters as units for non-parametric coordinates.\n\n";
+    out.Append("static char const * ");
+    out.Append(name);
+    out.Append(" = \n");
 
     for (int i=0; i<(int)verts.size(); i+=3)
-       sh << "v " << verts[i] << " " << verts[i+1] << " " << verts[i+2] <<"\n";
+        writeFloats(out, "\"v ", &verts[i], 3, "\\n\"\n");
 
     for (int i=0; i<(int)uvs.size(); i+=2)
-       sh << "vt " << uvs[i] << " " << uvs[i+1] << "\n";
+        writeFloats(out, "\"vt ", &uvs[i], 2, "\\n\"\n");
 
     for (int i=0; i<(int)normals.size(); i+=3)
-       sh << "vn " << normals[i] << " " << normals[i+1] << " " << normals[i+2] <<"\n";
-
-    for (int i=0, idx=0; i<(int)nvertsPerFace.size();++i) {
-        sh << "f ";
-        for (int j=0; j<nvertsPerFace[i];++j) {
-            int vert = faceverts[idx+j]+1,
-                uv = (int)faceuvs.size()>0 ? faceuvs[idx+j]+1 : vert,
-                normal = (int)facenormals.size()>0 ? facenormals[idx+j]+1 : vert;
-            sh << vert << "/" << uv << "/" << normal << " ";
-        }
-        sh << "\n";
-        idx+=nvertsPerFace[i];
-    }
+        writeFloats(out, "\"vn ", &normals[i], 3, "\\n\"\n");
+
+    out.Append("\"s off\\n\"\n");
+
+    writeFaces(out, *this, "\"f ", "\\n\"\n");
 
     for (int i=0; i<(int)tags.size(); ++i)
-        sh << tags[i]->genTag();
+        tags[i]->genTag(out);
+}
 
-    return sh.str();
+void Shape::genShape(FILE * fptr, char const * name) const {
+    tutorial::FormatBuffer buffer(fptr);
+    genShape(buffer, name);
+}
+
+std::string Shape::genShape(char const * name) const {
+    tutorial::FormatBuffer buffer((FILE *)0, estimateShapeSize(*this));
+    genShape(buffer, name);
+    return getText(buffer);
 }
 
 //------------------------------------------------------------------------------
-std::string Shape::genRIB() const {
-    std::stringstream rib;
+void Shape::genObj(tutorial::FormatBuffer & out) const {
+
+    out.Append("# This file uses centimeters as units for "
+               "non-parametric coordinates.\n\n");
+
+    for (int i=0; i<(int)verts.size(); i+=3)
+        writeFloats(out, "v ", &verts[i], 3, "\n");
 
-    rib << "HierarchicalSubdivisionMesh \"catmull-clark\" ";
+    for (int i=0; i<(int)uvs.size(); i+=2)
+        writeFloats(out, "vt ", &uvs[i], 2, "\n");
+
+    for (int i=0; i<(int)normals.size(); i+=3)
+        writeFloats(out, "vn ", &normals[i], 3, "\n");
 
-    rib << "[";
-    std::copy(nvertsPerFace.begin(), nvertsPerFace.end(), std::ostream_iterator<int>(rib));
-    rib << "] ";
+    writeFaces(out, *this, "f ", "\n");
 
-    rib << "[";
-    std::copy(faceverts.begin(), faceverts.end(), std::ostream_iterator<int>(rib));
-    rib << "] ";
+    for (int i=0; i<(int)tags.size(); ++i)
+        tags[i]->genTag(out);
+}
 
-    std::stringstream names, nargs, intargs, floatargs, strargs;
-    for (int i=0; i<(int)tags.size();) {
-        tag * t = tags[i];
+void Shape::genObj(FILE * fptr) const {
+    tutorial::FormatBuffer buffer(fptr);
+    genObj(buffer);
+}
 
-        names << t->name;
+std::string Shape::genObj() const {
+    tutorial::FormatBuffer buffer((FILE *)0, estimateShapeSize(*this));
+    genObj(buffer);
+    return getText(buffer);
+}
 
-        nargs << t->intargs.size() << " " << t->floatargs.size() << " " << t->stringargs.size();
+//------------------------------------------------------------------------------
+void Shape::genRIB(tutorial::FormatBuffer & out) const {
 
-        std::copy(t->intargs.begin(), t->intargs.end(), std::ostream_iterator<int>(intargs));
+    out.Append("HierarchicalSubdivisionMesh \"catmull-clark\" ");
 
-        std::copy(t->floatargs.begin(), t->floatargs.end(), std::ostream_iterator<float>(floatargs));
+    out.Append("[");
+    writeInts(out, nvertsPerFace);
+    out.Append("] ");
 
-        std::copy(t->stringargs.begin(), t->stringargs.end(), std::ostream_iterator<std::string>(strargs));
+    out.Append("[");
+    writeInts(out, faceverts);
+    out.Append("] ");
 
-        if (++i<(int)tags.size()) {
-            names << " ";
-            nargs << " ";
-            intargs << " ";
-            floatargs << " ";
-            strargs << " ";
-        }
+    // Each list of the arguments of all tags is written in turn, separating
+    // the tags with a space:
+    out.Append("[");
+    for (int i=0; i<(int)tags.size(); ++i) {
+        if (i>0) out.Append(" ");
+        writeText(out, tags[i]->name);
     }
+    out.Append("] [");
+    for (int i=0; i<(int)tags.size(); ++i) {
+        if (i>0) out.Append(" ");
+        tag const * t = tags[i];
+        char * s = out.Reserve(3 * tutorial::kMaxNumberLength + 2);
+        s = tutorial::FormatInt(s, (long long)t->intargs.size());
+        *s++ = ' ';
+        s = tutorial::FormatInt(s, (long long)t->floatargs.size());
+        *s++ = ' ';
+        s = tutorial::FormatInt(s, (long long)t->stringargs.size());
+        out.Commit(s);
+    }
+    out.Append("] [");
+    for (int i=0; i<(int)tags.size(); ++i) {
+        if (i>0) out.Append(" ");
+        writeInts(out, tags[i]->intargs);
+    }
+    out.Append("] [");
+    for (int i=0; i<(int)tags.size(); ++i) {
+        if (i>0) out.Append(" ");
+        writeFloats(out, tags[i]->floatargs);
+    }
+    out.Append("] [");
+    for (int i=0; i<(int)tags.size(); ++i) {
+        if (i>0) out.Append(" ");
+        writeStrings(out, tags[i]->stringargs);
+    }
+    out.Append("] ");
 
-    rib << "["<<names.str()<<"] " << "["<<nargs.str()<<"] " << "["<<intargs.str()<<"] " << "["<<floatargs.str()<<"] " << "["<<strargs.str()<<"] ";
+    out.Append("\"P\" [");
+    writeFloats(out, verts);
+    out.Append("] ");
+}
 
-    rib << "\"P\" [";
-    std::copy(verts.begin(), verts.end(), std::ostream_iterator<float>(rib));
-    rib << "] ";
+void Shape::genRIB(FILE * fptr) const {
+    tutorial::FormatBuffer buffer(fptr);
+    genRIB(buffer);
+}
 
-    return rib.str();
+std::string Shape::genRIB() const {
+    tutorial::FormatBuffer buffer((FILE *)0, estimateShapeSize(*this));
+    genRIB(buffer);
+    return getText(buffer);
 }
@@ -25,10 +25,13 @@
 #ifndef SHAPE_UTILS_H
 #define SHAPE_UTILS_H
 
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <map>
 
+namespace tutorial { class FormatBuffer; }
+
 //------------------------------------------------------------------------------
 
 enum Scheme {
@@ -77,6 +80,7 @@ struct Shape {
         static tag * parseTag(char const * stream);
 
         std::string genTag() const;
+        void genTag(tutorial::FormatBuffer & out) const;
 
         std::string              name;
         std::vector<int>         intargs;
@@ -96,6 +100,18 @@ struct Shape {
 
     std::string genRIB() const;
 
+    // Streaming variants of the above:  the text is written to the FILE (or
+    // through the buffer to its FILE or stream) in chunks as it is formatted,
+    // so memory is bounded by the size of the buffer rather than the text
+    void genShape(FILE * fptr, char const * name) const;
+    void genShape(tutorial::FormatBuffer & out, char const * name) const;
+
+    void genObj(FILE * fptr) const;
+    void genObj(tutorial::FormatBuffer & out) const;
+
+    void genRIB(FILE * fptr) const;
+    void genRIB(tutorial::FormatBuffer & out) const;
+
     Shape() : scheme(kCatmark), isLeftHanded(false) { }
 
     ~Shape();
@@ -0,0 +1,134 @@
+#include "surfaceCache.h"
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Definitions of SurfaceCache methods:
+//
+SurfaceCache::SurfaceCache(size_t maxEntries) :
+        _maxEntries(maxEntries),
+        _numHits(0), _numMisses(0), _numEvictions(0) {
+}
+
+SurfaceCache::~SurfaceCache() {
+}
+
+void
+SurfaceCache::SetMaxEntries(size_t maxEntries) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _maxEntries = maxEntries;
+    evict();
+}
+
+size_t
+SurfaceCache::GetMaxEntries() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _maxEntries;
+}
+
+size_t
+SurfaceCache::GetNumEntries() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _map.size();
+}
+
+size_t
+SurfaceCache::GetNumHits() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numHits;
+}
+
+size_t
+SurfaceCache::GetNumMisses() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numMisses;
+}
+
+size_t
+SurfaceCache::GetNumEvictions() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numEvictions;
+}
+
+void
+SurfaceCache::ResetCounters() {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _numHits      = 0;
+    _numMisses    = 0;
+    _numEvictions = 0;
+}
+
+void
+SurfaceCache::Clear() {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _entries.clear();
+    _map.clear();
+}
+
+//
+//  A successful Find() makes the entry the most recently used -- which
+//  modifies the list, so an exclusive lock is required even for lookups:
+//
+SurfaceCache::DataType
+SurfaceCache::Find(KeyType const & key) const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    EntryMap::const_iterator found = _map.find(key);
+    if (found == _map.end()) {
+        ++ _numMisses;
+        return DataType();
+    }
+    ++ _numHits;
+
+    _entries.splice(_entries.begin(), _entries, found->second);
+    return found->second->second;
+}
+
+//
+//  If another thread added the same key after our Find() failed, its data
+//  is kept and returned (as with the factory's own caches):
+//
+SurfaceCache::DataType
+SurfaceCache::Add(KeyType const & key, DataType const & data) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    EntryMap::iterator found = _map.find(key);
+    if (found != _map.end()) {
+        _entries.splice(_entries.begin(), _entries, found->second);
+        return found->second->second;
+    }
+
+    _entries.push_front(Entry(key, data));
+    _map[key] = _entries.begin();
+
+    evict();
+    return data;
+}
+
+void
+SurfaceCache::evict() {
+
+    if (_maxEntries == 0) return;
+
+    while (_map.size() > _maxEntries) {
+        _map.erase(_entries.back().first);
+        _entries.pop_back();
+        ++ _numEvictions;
+    }
+}
+
+} // end namespace
@@ -0,0 +1,85 @@
+#ifndef SURFACE_CACHE_H
+#define SURFACE_CACHE_H
+
+#include <opensubdiv/bfr/surfaceFactoryCache.h>
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Long-lived, bounded cache of the irregular patches constructed by a
+//  Bfr::SurfaceFactory.
+//
+//  A SurfaceFactory normally owns its cache, so the patches of irregular
+//  faces are rebuilt by every new factory -- e.g. once per frame of an
+//  animated sequence even though the topology does not change.  Patches
+//  are keyed by the topology of the neighborhood of a face and not by its
+//  positions, so an instance of this cache can be assigned to the
+//  factories of every frame (SurfaceFactory::Options::SetExternalCache())
+//  and later frames then find all of their irregular patches already
+//  built.  Factories sharing a cache must use the same approximation
+//  levels in their Options.
+//
+//  The number of patches retained is bounded -- the least recently used
+//  patch is evicted when the bound is exceeded.  The size of a patch is
+//  not exposed by Bfr, so memory is bounded through the number of entries.
+//  Patches still referenced by existing Surfaces remain valid after their
+//  eviction.
+//
+//  All methods are thread-safe, so a single instance can also be shared
+//  by factories used concurrently.
+//
+class SurfaceCache : public OpenSubdiv::Bfr::SurfaceFactoryCache {
+public:
+    //  A maximum of 0 entries leaves the cache unbounded:
+    explicit SurfaceCache(size_t maxEntries = 0);
+    ~SurfaceCache() override;
+
+    void   SetMaxEntries(size_t maxEntries);
+    size_t GetMaxEntries() const;
+
+    size_t GetNumEntries() const;
+
+    //  Counters accumulated since construction or the last reset:
+    size_t GetNumHits() const;
+    size_t GetNumMisses() const;
+    size_t GetNumEvictions() const;
+
+    void ResetCounters();
+
+    //  Discard all entries (counters are preserved):
+    void Clear();
+
+protected:
+    DataType Find(KeyType const & key) const override;
+    DataType Add(KeyType const & key, DataType const & data) override;
+
+private:
+    //  Entries are listed from most to least recently used:
+    typedef std::pair<KeyType, DataType>                        Entry;
+    typedef std::list<Entry>                                    EntryList;
+    typedef std::unordered_map<KeyType, EntryList::iterator>    EntryMap;
+
+    void evict();
+
+private:
+    mutable std::mutex _mutex;
+
+    mutable EntryList _entries;
+    EntryMap          _map;
+    size_t            _maxEntries;
+
+    mutable size_t _numHits;
+    mutable size_t _numMisses;
+    size_t         _numEvictions;
+};
+
+} // end namespace
+
+#endif /* SURFACE_CACHE_H */
@@ -0,0 +1,141 @@
+#include "tessellationPatternCache.h"
+#include "vertexCacheOrder.h"
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+//
+//  Definitions of TessellationPatternCache methods:
+//
+bool
+TessellationPatternCache::Key::operator<(Key const & k) const {
+
+    if (paramType != k.paramType) return paramType < k.paramType;
+    if (faceSize != k.faceSize) return faceSize < k.faceSize;
+    if (facetSize != k.facetSize) return facetSize < k.facetSize;
+    if (preserveQuads != k.preserveQuads) return preserveQuads < k.preserveQuads;
+    if (coordStride != k.coordStride) return coordStride < k.coordStride;
+    if (facetStride != k.facetStride) return facetStride < k.facetStride;
+    return rates < k.rates;
+}
+
+TessellationPatternCache::TessellationPatternCache(int maxEntries) :
+        _order(ORDER_TESSELLATION),
+        _maxEntries(maxEntries), _numHits(0), _numMisses(0) {
+}
+
+void
+TessellationPatternCache::SetOrder(Order order) {
+
+    if (order != _order) {
+        _patterns.clear();
+        _order = order;
+    }
+}
+
+TessellationPatternCache::Pattern const &
+TessellationPatternCache::GetPattern(Parameterization const & param,
+                                     int numRates, int const rates[],
+                                     Tessellation::Options const & options) {
+
+    _lookupKey.paramType     = (int) param.GetType();
+    _lookupKey.faceSize      = param.GetFaceSize();
+    _lookupKey.facetSize     = options.GetFacetSize();
+    _lookupKey.preserveQuads = options.PreservesQuads();
+    _lookupKey.coordStride   = options.GetCoordStride();
+    _lookupKey.facetStride   = options.GetFacetStride();
+    _lookupKey.rates.assign(rates, rates + numRates);
+
+    std::map<Key, Pattern>::const_iterator found = _patterns.find(_lookupKey);
+    if (found != _patterns.end()) {
+        ++ _numHits;
+        return found->second;
+    }
+    ++ _numMisses;
+
+    if ((int) _patterns.size() >= _maxEntries) {
+        _patterns.clear();
+    }
+
+    Pattern & pattern = _patterns[_lookupKey];
+    generatePattern(param, numRates, rates, options, pattern);
+    return pattern;
+}
+
+void
+TessellationPatternCache::generatePattern(Parameterization const & param,
+                                          int numRates, int const rates[],
+                                          Tessellation::Options const & options,
+                                          Pattern & pattern) const {
+
+    Tessellation tessPattern(param, numRates, rates, options);
+
+    pattern.numCoords         = tessPattern.GetNumCoords();
+    pattern.numBoundaryCoords = tessPattern.GetNumBoundaryCoords();
+    pattern.numInteriorCoords = tessPattern.GetNumInteriorCoords();
+    pattern.numFacets         = tessPattern.GetNumFacets();
+    pattern.facetSize         = tessPattern.GetFacetSize();
+
+    pattern.coords.resize(pattern.numCoords * options.GetCoordStride());
+    tessPattern.GetCoords(pattern.coords.data());
+
+    pattern.facets.resize(pattern.numFacets * options.GetFacetStride());
+    tessPattern.GetFacets(pattern.facets.data());
+
+    pattern.edgeCounts.resize(param.GetFaceSize());
+    for (int i = 0; i < param.GetFaceSize(); ++i) {
+        pattern.edgeCounts[i] = tessPattern.GetNumEdgeCoords(i);
+    }
+
+    pattern.numOriginalCacheMisses = 0;
+    pattern.numCacheMisses         = 0;
+    if ((_order != ORDER_TESSELLATION) && (pattern.facetSize == 3) &&
+            (options.GetCoordStride() == 2) && (options.GetFacetStride() == 3)) {
+        orderPattern(pattern);
+    }
+}
+
+//
+//  The facets are reordered (and the coordinates renumbered) only when
+//  that reduces the misses of the cache -- small patterns may already be
+//  in a better order than the greedy one:
+//
+void
+TessellationPatternCache::orderPattern(Pattern & pattern) const {
+
+    int numFacets = pattern.numFacets;
+    int numCoords = pattern.numCoords;
+
+    pattern.numOriginalCacheMisses = CountVertexCacheMisses(numFacets,
+            pattern.facets.data(), numCoords);
+    pattern.numCacheMisses = pattern.numOriginalCacheMisses;
+
+    std::vector<int> facets(pattern.facets);
+    OptimizeTriangleOrder(numFacets, facets.data(), numCoords);
+
+    std::vector<int> newIndices;
+    if (_order == ORDER_FACETS_AND_COORDS) {
+        newIndices.resize(numCoords);
+        OptimizeVertexOrder(numFacets, facets.data(), numCoords,
+                            newIndices.data());
+    }
+
+    int numMisses = CountVertexCacheMisses(numFacets, facets.data(), numCoords);
+    if (numMisses >= pattern.numOriginalCacheMisses) return;
+
+    pattern.facets.swap(facets);
+    pattern.numCacheMisses = numMisses;
+
+    if (!newIndices.empty()) {
+        std::vector<float> coords(pattern.coords.size());
+        for (int i = 0; i < numCoords; ++i) {
+            coords[2 * newIndices[i]    ] = pattern.coords[2 * i];
+            coords[2 * newIndices[i] + 1] = pattern.coords[2 * i + 1];
+        }
+        pattern.coords.swap(coords);
+    }
+}
+
+} // end namespace
@@ -0,0 +1,123 @@
+#ifndef TESSELLATION_PATTERN_CACHE_H
+#define TESSELLATION_PATTERN_CACHE_H
+
+#include <opensubdiv/bfr/parameterization.h>
+#include <opensubdiv/bfr/tessellation.h>
+
+#include <map>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Cache of the coordinates and facets of Bfr::Tessellation patterns.
+//
+//  A Tessellation depends only on the Parameterization of a face (its type
+//  and size), the tessellation rates and the Tessellation::Options -- so
+//  the faces of a mesh (mostly quads with the same rates) share very few
+//  distinct patterns.  Patterns are generated the first time they are
+//  requested and their arrays are returned for every subsequent request.
+//
+//  The cache is not thread-safe -- it is intended to be owned by each
+//  thread, which costs little given the few distinct patterns.  When the
+//  number of patterns exceeds the given maximum (e.g. with adaptive rates)
+//  the cache is cleared, so a pattern returned remains valid only until
+//  the next call to GetPattern().
+//
+//  The facets of the patterns (and optionally their coordinates) can be
+//  ordered for the post-transform vertex cache when generated -- see
+//  vertexCacheOrder.h -- so faces sharing a pattern share its ordering.
+//
+class TessellationPatternCache {
+public:
+    typedef OpenSubdiv::Bfr::Parameterization Parameterization;
+    typedef OpenSubdiv::Bfr::Tessellation     Tessellation;
+
+    struct Pattern {
+        int numCoords;
+        int numBoundaryCoords;
+        int numInteriorCoords;
+        int numFacets;
+        int facetSize;
+
+        //  (u,v) pairs of the boundary followed by the interior -- the
+        //  boundary ordered by vertex, each followed by the points of its
+        //  subsequent edge:
+        std::vector<float> coords;
+        std::vector<int>   facets;
+
+        //  Number of points interior to each edge:
+        std::vector<int>   edgeCounts;
+
+        //  Vertex cache misses drawing the facets in the order of the
+        //  Tessellation and in that of the pattern (0 when not ordered):
+        int numOriginalCacheMisses;
+        int numCacheMisses;
+    };
+
+    //
+    //  Order of the facets and coordinates of the patterns -- that of the
+    //  Tessellation, or the facets (triangles only) ordered for the vertex
+    //  cache and optionally the coordinates in their order of first use.
+    //  Reordered coordinates no longer follow the layout of the boundary
+    //  above (edgeCounts does not apply to them):
+    //
+    enum Order {
+        ORDER_TESSELLATION,
+        ORDER_FACETS,
+        ORDER_FACETS_AND_COORDS
+    };
+
+public:
+    explicit TessellationPatternCache(int maxEntries = 1024);
+
+    //  Patterns already generated are discarded when the order changes:
+    void  SetOrder(Order order);
+    Order GetOrder() const { return _order; }
+
+    //  Uniform or non-uniform rates as for the Tessellation constructor:
+    Pattern const & GetPattern(Parameterization const & param,
+                               int numRates, int const rates[],
+                               Tessellation::Options const & options);
+
+    int GetNumEntries() const { return (int) _patterns.size(); }
+    int GetNumHits() const    { return _numHits; }
+    int GetNumMisses() const  { return _numMisses; }
+
+private:
+    struct Key {
+        int paramType;
+        int faceSize;
+        int facetSize;
+        int preserveQuads;
+        int coordStride;
+        int facetStride;
+
+        std::vector<int> rates;
+
+        bool operator<(Key const & k) const;
+    };
+
+    void generatePattern(Parameterization const & param,
+                         int numRates, int const rates[],
+                         Tessellation::Options const & options,
+                         Pattern & pattern) const;
+    void orderPattern(Pattern & pattern) const;
+
+private:
+    std::map<Key, Pattern> _patterns;
+
+    //  Reused to avoid allocating a key for each request:
+    Key _lookupKey;
+
+    Order _order;
+
+    int _maxEntries;
+    int _numHits;
+    int _numMisses;
+};
+
+} // end namespace
+
+#endif /* TESSELLATION_PATTERN_CACHE_H */
@@ -0,0 +1,258 @@
+#include "tessellationRates.h"
+#include "parallel.h"
+
+#include <opensubdiv/bfr/surface.h>
+#include <opensubdiv/bfr/tessellation.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+using namespace OpenSubdiv;
+
+namespace {
+    //  Number of segments sampled along each edge and midline:
+    int const kNumSegments = 8;
+
+    float
+    distance(float const a[3], float const b[3]) {
+        return std::sqrt((a[0] - b[0]) * (a[0] - b[0]) +
+                         (a[1] - b[1]) * (a[1] - b[1]) +
+                         (a[2] - b[2]) * (a[2] - b[2]));
+    }
+}
+
+//
+//  Definitions of TessellationRates methods:
+//
+TessellationRates::TessellationRates(TopologyRefiner const & mesh,
+                                     SurfaceFactory const & surfaceFactory,
+                                     float const meshPoints[],
+                                     Options const & options,
+                                     int numThreads) :
+        _mesh(mesh), _options(options), _scale(1.0f), _numTriangles(0) {
+
+    computeRates(surfaceFactory, meshPoints, numThreads);
+    applyBudget(surfaceFactory, numThreads);
+}
+
+int
+TessellationRates::GetFaceRates(int face, int rates[]) const {
+
+    Far::ConstIndexArray edges = _mesh.GetLevel(0).GetFaceEdges(face);
+
+    int numEdges = edges.size();
+    for (int i = 0; i < numEdges; ++i) {
+        rates[i] = scaledRate(_edgeRates[edges[i]]);
+    }
+    if (_innerRates[2 * face] <= 0.0f) {
+        return numEdges;
+    }
+
+    //  Inner rates of quads are never less than those of the edges they
+    //  run parallel to -- edges 0 and 2 in U and edges 1 and 3 in V:
+    rates[4] = std::max(scaledRate(_innerRates[2 * face]),
+                        std::max(rates[0], rates[2]));
+    rates[5] = std::max(scaledRate(_innerRates[2 * face + 1]),
+                        std::max(rates[1], rates[3]));
+    return 6;
+}
+
+int
+TessellationRates::scaledRate(float desiredRate) const {
+
+    int rate = (int) std::ceil(desiredRate * _scale);
+    return std::min(std::max(rate, 1), _options.maxRate);
+}
+
+//
+//  Rate for a curve from evaluated samples at uniform parametric spacing:
+//
+//  For a curve of curvature k, segments of length h deviate from the
+//  curve by about k * h^2 / 8, so segments within a chordal tolerance
+//  have length sqrt(8 * tolerance / k).  The curvature is estimated from
+//  the second differences of the samples.  The projected length of each
+//  segment is its length scaled by the focal length over its distance
+//  from the eye.
+//
+float
+TessellationRates::rateFromSamples(float const samples[],
+                                   int numSamples) const {
+
+    float length = 0.0f;
+    for (int i = 1; i < numSamples; ++i) {
+        length += distance(&samples[3 * (i - 1)], &samples[3 * i]);
+    }
+    if (length <= 0.0f) return 1.0f;
+
+    float rate = 1.0f;
+
+    if (_options.chordalTolerance > 0.0f) {
+        float h = length / (float) (numSamples - 1);
+
+        float maxCurvature = 0.0f;
+        for (int i = 1; i + 1 < numSamples; ++i) {
+            float const * P0 = &samples[3 * (i - 1)];
+            float const * P1 = &samples[3 * i];
+            float const * P2 = &samples[3 * (i + 1)];
+
+            float d[3] = { P0[0] - 2.0f * P1[0] + P2[0],
+                           P0[1] - 2.0f * P1[1] + P2[1],
+                           P0[2] - 2.0f * P1[2] + P2[2] };
+            float curvature = std::sqrt(d[0] * d[0] + d[1] * d[1] +
+                                        d[2] * d[2]) / (h * h);
+            maxCurvature = std::max(maxCurvature, curvature);
+        }
+        rate = std::max(rate, length *
+                std::sqrt(maxCurvature / (8.0f * _options.chordalTolerance)));
+    }
+
+    if (_options.pixelLength > 0.0f) {
+        float projectedLength = 0.0f;
+        for (int i = 1; i < numSamples; ++i) {
+            float const * P0 = &samples[3 * (i - 1)];
+            float const * P1 = &samples[3 * i];
+
+            float midPoint[3] = { 0.5f * (P0[0] + P1[0]),
+                                  0.5f * (P0[1] + P1[1]),
+                                  0.5f * (P0[2] + P1[2]) };
+            float depth = std::max(distance(midPoint, _options.eye), 1.0e-6f);
+
+            projectedLength += distance(P0, P1) * _options.focalLength / depth;
+        }
+        rate = std::max(rate, projectedLength / _options.pixelLength);
+    }
+    return rate;
+}
+
+void
+TessellationRates::computeRates(SurfaceFactory const & surfaceFactory,
+                                float const meshPoints[], int numThreads) {
+
+    Far::TopologyLevel const & baseLevel = _mesh.GetLevel(0);
+
+    int numFaces = baseLevel.GetNumFaces();
+    int numEdges = baseLevel.GetNumEdges();
+
+    _edgeRates.assign(numEdges, 1.0f);
+    _innerRates.assign(2 * numFaces, 0.0f);
+
+    //
+    //  Each edge is evaluated by the first of its faces with a limit
+    //  surface, so its rate does not depend on the order of evaluation:
+    //
+    std::vector<int> edgeOwners(numEdges, -1);
+    for (int face = 0; face < numFaces; ++face) {
+        if (!surfaceFactory.FaceHasLimitSurface(face)) continue;
+
+        Far::ConstIndexArray edges = baseLevel.GetFaceEdges(face);
+        for (int i = 0; i < edges.size(); ++i) {
+            if (edgeOwners[edges[i]] < 0) edgeOwners[edges[i]] = face;
+        }
+    }
+
+    ParallelFor(0, numFaces, 64, [&](int faceBegin, int faceEnd) {
+        Bfr::Surface<float> surface;
+        std::vector<float>  patchPoints;
+        float               samples[3 * (kNumSegments + 1)];
+
+        for (int face = faceBegin; face < faceEnd; ++face) {
+            if (!surfaceFactory.InitVertexSurface(face, &surface)) continue;
+
+            patchPoints.resize(surface.GetNumPatchPoints() * 3);
+            surface.PreparePatchPoints(meshPoints, 3, patchPoints.data(), 3);
+
+            Bfr::Parameterization param = surface.GetParameterization();
+
+            Far::ConstIndexArray edges = baseLevel.GetFaceEdges(face);
+            for (int i = 0; i < edges.size(); ++i) {
+                if (edgeOwners[edges[i]] != face) continue;
+
+                for (int j = 0; j <= kNumSegments; ++j) {
+                    float uv[2];
+                    param.GetEdgeCoord(i, (float) j / kNumSegments, uv);
+                    surface.Evaluate(uv, patchPoints.data(), 3, &samples[3 * j]);
+                }
+                _edgeRates[edges[i]] = rateFromSamples(samples, kNumSegments + 1);
+            }
+
+            if (param.GetType() != Bfr::Parameterization::QUAD) continue;
+
+            //  Midlines of quads -- along U (at V = 1/2) and along V:
+            for (int dir = 0; dir < 2; ++dir) {
+                for (int j = 0; j <= kNumSegments; ++j) {
+                    float uv[2];
+                    uv[dir]     = (float) j / kNumSegments;
+                    uv[1 - dir] = 0.5f;
+                    surface.Evaluate(uv, patchPoints.data(), 3, &samples[3 * j]);
+                }
+                _innerRates[2 * face + dir] =
+                        rateFromSamples(samples, kNumSegments + 1);
+            }
+        }
+    }, numThreads);
+}
+
+long
+TessellationRates::countTriangles(SurfaceFactory const & surfaceFactory,
+                                  int numThreads) const {
+
+    Bfr::Tessellation::Options tessOptions;
+    tessOptions.SetFacetSize(3);
+
+    std::atomic<long> numTriangles(0);
+
+    int numFaces = _mesh.GetLevel(0).GetNumFaces();
+
+    ParallelFor(0, numFaces, 256, [&](int faceBegin, int faceEnd) {
+        std::vector<int> rates;
+        long             count = 0;
+
+        for (int face = faceBegin; face < faceEnd; ++face) {
+            if (!surfaceFactory.FaceHasLimitSurface(face)) continue;
+
+            Bfr::Parameterization param =
+                    surfaceFactory.GetFaceParameterization(face);
+
+            rates.resize(param.GetFaceSize() + 2);
+            int numRates = GetFaceRates(face, rates.data());
+
+            Bfr::Tessellation tessPattern(param, numRates, rates.data(),
+                                          tessOptions);
+            count += tessPattern.GetNumFacets();
+        }
+        numTriangles += count;
+    }, numThreads);
+
+    return numTriangles;
+}
+
+//
+//  Triangles grow with the square of the rates, so the scale is reduced
+//  by the square root of the excess over the budget until it fits (or the
+//  count no longer decreases, i.e. rates are all 1):
+//
+void
+TessellationRates::applyBudget(SurfaceFactory const & surfaceFactory,
+                               int numThreads) {
+
+    _scale        = 1.0f;
+    _numTriangles = countTriangles(surfaceFactory, numThreads);
+
+    if (_options.maxTriangles <= 0) return;
+
+    for (int i = 0; i < 16 && (_numTriangles > _options.maxTriangles); ++i) {
+        _scale *= 0.95f * std::sqrt((float) _options.maxTriangles /
+                                    (float) _numTriangles);
+
+        long numTriangles = countTriangles(surfaceFactory, numThreads);
+        if (numTriangles == _numTriangles) break;
+
+        _numTriangles = numTriangles;
+    }
+}
+
+} // end namespace
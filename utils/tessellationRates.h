@@ -0,0 +1,96 @@
+#ifndef TESSELLATION_RATES_H
+#define TESSELLATION_RATES_H
+
+#include <opensubdiv/far/topologyRefiner.h>
+#include <opensubdiv/bfr/surfaceFactory.h>
+
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Adaptive tessellation rates for the faces of a mesh.
+//
+//  A rate is computed for each edge of the base mesh from limit positions
+//  sampled along the edge -- using either a chordal error tolerance (the
+//  curvature estimated from the samples determines the segment length
+//  within the tolerance) or a target length in pixels of the edge as seen
+//  from a given eye point, or the larger of the two when both are given.
+//  Each edge is evaluated once, by the first face incident to it, and the
+//  same rate is assigned to all of its faces so that tessellations of
+//  adjacent faces match along the edge (no cracks).
+//
+//  Quads additionally get inner rates from samples along their two
+//  midlines, so that curvature across the interior of a face with
+//  straight edges (e.g. around a cylinder) is accounted for.  The inner
+//  rates of other faces are inferred from their edges by Bfr.
+//
+//  An optional budget bounds the total number of triangles:  all rates
+//  are scaled down uniformly until the estimated count fits the budget.
+//
+class TessellationRates {
+public:
+    typedef OpenSubdiv::Far::TopologyRefiner TopologyRefiner;
+    typedef OpenSubdiv::Bfr::SurfaceFactory  SurfaceFactory;
+
+    struct Options {
+        Options() : chordalTolerance(0.0f), pixelLength(0.0f),
+                    focalLength(1000.0f), maxRate(32), maxTriangles(0) {
+            eye[0] = eye[1] = eye[2] = 0.0f;
+        }
+
+        float chordalTolerance;  // maximum chordal error (0 to ignore)
+
+        float pixelLength;       // target edge length in pixels (0 to ignore)
+        float eye[3];            // eye point and focal length (in pixels)
+        float focalLength;       // for the projected edge lengths
+
+        int   maxRate;
+        int   maxTriangles;      // budget for the whole mesh (0 for none)
+    };
+
+public:
+    //  Rates are computed from the limit surface of the given (3D) points
+    //  of the base mesh -- distributing faces across threads:
+    TessellationRates(TopologyRefiner const & mesh,
+                      SurfaceFactory const & surfaceFactory,
+                      float const meshPoints[],
+                      Options const & options, int numThreads = 0);
+
+    //  Rates of a face for the Bfr::Tessellation constructor -- returns
+    //  the number of rates assigned (at most the face size plus 2):
+    int GetFaceRates(int face, int rates[]) const;
+
+    //  Triangles of the tessellation of all faces with the final rates:
+    long GetNumTriangles() const { return _numTriangles; }
+
+    //  Scale applied to the rates to satisfy the triangle budget:
+    float GetBudgetScale() const { return _scale; }
+
+private:
+    void computeRates(SurfaceFactory const & surfaceFactory,
+                      float const meshPoints[], int numThreads);
+    void applyBudget(SurfaceFactory const & surfaceFactory, int numThreads);
+
+    long countTriangles(SurfaceFactory const & surfaceFactory,
+                        int numThreads) const;
+
+    float rateFromSamples(float const samples[], int numSamples) const;
+    int   scaledRate(float desiredRate) const;
+
+private:
+    TopologyRefiner const & _mesh;
+    Options                 _options;
+
+    //  Desired (unscaled) rates for each edge and inner rates of quads:
+    std::vector<float> _edgeRates;
+    std::vector<float> _innerRates;
+
+    float _scale;
+    long  _numTriangles;
+};
+
+} // end namespace
+
+#endif /* TESSELLATION_RATES_H */
@@ -0,0 +1,214 @@
+#include "vertexCacheOrder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    //
+    //  Scores of a vertex by its position in the cache (the last triangle
+    //  drawn scored lower, so that strips do not turn back on themselves)
+    //  and by the number of its triangles still to be drawn (favoring
+    //  vertices that would otherwise be left isolated):
+    //
+    float const kLastTriangleScore = 0.75f;
+    float const kCacheDecayPower   = 1.5f;
+    float const kValenceBoostScale = 2.0f;
+    float const kValenceBoostPower = 0.5f;
+
+    int const kMaxScoredValence = 32;
+
+    struct ScoreTables {
+        float cache[kVertexCacheSize];
+        float valence[kMaxScoredValence + 1];
+
+        ScoreTables() {
+            for (int i = 0; i < kVertexCacheSize; ++i) {
+                if (i < 3) {
+                    cache[i] = kLastTriangleScore;
+                } else {
+                    float scale = 1.0f / (float) (kVertexCacheSize - 3);
+                    cache[i] = std::pow(1.0f - (float) (i - 3) * scale,
+                                        kCacheDecayPower);
+                }
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= kMaxScoredValence; ++i) {
+                valence[i] = kValenceBoostScale *
+                             std::pow((float) i, -kValenceBoostPower);
+            }
+        }
+    };
+
+    ScoreTables const kScores;
+
+    inline float
+    scoreVertex(int cachePosition, int numActiveTriangles) {
+
+        if (numActiveTriangles == 0) return -1.0f;
+
+        float score = (cachePosition < 0) ? 0.0f : kScores.cache[cachePosition];
+        return score + kScores.valence[std::min(numActiveTriangles,
+                                                kMaxScoredValence)];
+    }
+}
+
+//
+//  The triangles of each vertex are listed contiguously (offsets as in a
+//  compressed sparse row) and those drawn are removed from the lists, so
+//  that only triangles still to be drawn are rescored.  When no triangle
+//  of a vertex in the cache remains, the next triangle not yet drawn in
+//  the original order is taken:
+//
+void
+OptimizeTriangleOrder(int numTriangles, int triangles[], int numVertices) {
+
+    if (numTriangles <= 1) return;
+
+    std::vector<int> activeCounts(numVertices, 0);
+    for (int i = 0; i < 3 * numTriangles; ++i) {
+        assert((triangles[i] >= 0) && (triangles[i] < numVertices));
+        ++ activeCounts[triangles[i]];
+    }
+
+    std::vector<int> offsets(numVertices + 1, 0);
+    for (int v = 0; v < numVertices; ++v) {
+        offsets[v + 1] = offsets[v] + activeCounts[v];
+    }
+    std::vector<int> vertexTriangles(offsets[numVertices]);
+    {
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (int t = 0; t < numTriangles; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                vertexTriangles[fill[triangles[3 * t + k]]++] = t;
+            }
+        }
+    }
+
+    std::vector<int>   cachePositions(numVertices, -1);
+    std::vector<float> vertexScores(numVertices);
+    for (int v = 0; v < numVertices; ++v) {
+        vertexScores[v] = scoreVertex(-1, activeCounts[v]);
+    }
+
+    std::vector<bool> drawn(numTriangles, false);
+
+    //  The cache holds up to 3 more entries while being updated:
+    int cache[kVertexCacheSize + 3];
+    int cacheSize = 0;
+
+    std::vector<int> order;
+    order.reserve(3 * numTriangles);
+
+    int nextUndrawn  = 0;
+    int bestTriangle = -1;
+    for (int numDrawn = 0; numDrawn < numTriangles; ++numDrawn) {
+        if (bestTriangle < 0) {
+            while (drawn[nextUndrawn]) ++nextUndrawn;
+            bestTriangle = nextUndrawn;
+        }
+
+        //  Draw the triangle and remove it from the lists of its vertices:
+        int const * tri = triangles + 3 * bestTriangle;
+        drawn[bestTriangle] = true;
+        order.insert(order.end(), tri, tri + 3);
+
+        for (int k = 0; k < 3; ++k) {
+            int   v    = tri[k];
+            int * list = &vertexTriangles[offsets[v]];
+            int   last = activeCounts[v] - 1;
+            for (int j = 0; j <= last; ++j) {
+                if (list[j] == bestTriangle) {
+                    std::swap(list[j], list[last]);
+                    break;
+                }
+            }
+            activeCounts[v] = last;
+        }
+
+        //  Move its vertices to the front of the cache (LRU):
+        int newCache[kVertexCacheSize + 3];
+        int newSize = 0;
+        for (int k = 0; k < 3; ++k) {
+            newCache[newSize++] = tri[k];
+        }
+        for (int j = 0; j < cacheSize; ++j) {
+            int v = cache[j];
+            if ((v != tri[0]) && (v != tri[1]) && (v != tri[2])) {
+                newCache[newSize++] = v;
+            }
+        }
+
+        //  Rescore the vertices in (and falling out of) the cache, then
+        //  their triangles still to be drawn -- choosing the best:
+        for (int j = 0; j < newSize; ++j) {
+            int v = newCache[j];
+            cachePositions[v] = (j < kVertexCacheSize) ? j : -1;
+            vertexScores[v]   = scoreVertex(cachePositions[v], activeCounts[v]);
+        }
+
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int j = 0; j < newSize; ++j) {
+            int v = newCache[j];
+            int const * list = &vertexTriangles[offsets[v]];
+            for (int i = 0; i < activeCounts[v]; ++i) {
+                int const * other = triangles + 3 * list[i];
+                float score = vertexScores[other[0]] + vertexScores[other[1]] +
+                              vertexScores[other[2]];
+                if (score > bestScore) {
+                    bestScore    = score;
+                    bestTriangle = list[i];
+                }
+            }
+        }
+
+        cacheSize = std::min(newSize, kVertexCacheSize);
+        std::copy(newCache, newCache + cacheSize, cache);
+    }
+
+    std::copy(order.begin(), order.end(), triangles);
+}
+
+void
+OptimizeVertexOrder(int numTriangles, int triangles[], int numVertices,
+                    int newIndices[]) {
+
+    std::fill(newIndices, newIndices + numVertices, -1);
+
+    int nextIndex = 0;
+    for (int i = 0; i < 3 * numTriangles; ++i) {
+        int & index = newIndices[triangles[i]];
+        if (index < 0) index = nextIndex++;
+        triangles[i] = index;
+    }
+    for (int v = 0; v < numVertices; ++v) {
+        if (newIndices[v] < 0) newIndices[v] = nextIndex++;
+    }
+}
+
+//
+//  A vertex is in the FIFO cache if fewer than cacheSize vertices have
+//  been added to the cache since it was:
+//
+int
+CountVertexCacheMisses(int numTriangles, int const triangles[],
+                       int numVertices, int cacheSize) {
+
+    std::vector<int> timestamps(numVertices, -1);
+
+    int numMisses = 0;
+    for (int i = 0; i < 3 * numTriangles; ++i) {
+        int & timestamp = timestamps[triangles[i]];
+        if ((timestamp < 0) || (numMisses - timestamp >= cacheSize)) {
+            timestamp = numMisses++;
+        }
+    }
+    return numMisses;
+}
+
+} // end namespace
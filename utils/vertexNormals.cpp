@@ -0,0 +1,187 @@
+#include "vertexNormals.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+namespace {
+    inline void
+    computeNormal(float const du[3], float const dv[3], float N[3]) {
+
+        N[0] = du[1] * dv[2] - du[2] * dv[1];
+        N[1] = du[2] * dv[0] - du[0] * dv[2];
+        N[2] = du[0] * dv[1] - du[1] * dv[0];
+
+        float lenSqrd = N[0] * N[0] + N[1] * N[1] + N[2] * N[2];
+        if (lenSqrd <= 0.0f) {
+            N[0] = 0.0f;
+            N[1] = 0.0f;
+            N[2] = 0.0f;
+        } else {
+            float lenInv = 1.0f / std::sqrt(lenSqrd);
+            N[0] *= lenInv;
+            N[1] *= lenInv;
+            N[2] *= lenInv;
+        }
+    }
+
+#if defined(__AVX__)
+    int const kLanes = 8;
+
+    typedef __m256 Lanes;
+
+    inline Lanes splat(float s)        { return _mm256_set1_ps(s); }
+    inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+    inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+    inline Lanes madd(Lanes a, Lanes b, Lanes c) { return _mm256_fmadd_ps(a, b, c); }
+    inline Lanes msub(Lanes a, Lanes b, Lanes c) { return _mm256_fmsub_ps(a, b, c); }
+#else
+    inline Lanes madd(Lanes a, Lanes b, Lanes c) { return _mm256_add_ps(mul(a, b), c); }
+    inline Lanes msub(Lanes a, Lanes b, Lanes c) { return sub(mul(a, b), c); }
+#endif
+
+    //
+    //  Transpose 8 contiguous triples (xyz xyz ...) into the components
+    //  of the lanes and back -- each 128-bit half of the registers holds
+    //  4 triples:
+    //
+    inline void
+    loadTriples(float const * p, Lanes & x, Lanes & y, Lanes & z) {
+
+        Lanes m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                        _mm_loadu_ps(p)),     _mm_loadu_ps(p + 12), 1);
+        Lanes m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                        _mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 16), 1);
+        Lanes m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(
+                        _mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 20), 1);
+
+        Lanes xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+        Lanes yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+        x = _mm256_shuffle_ps(m03, xy,  _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm256_shuffle_ps(yz,  xy,  _MM_SHUFFLE(3, 1, 2, 0));
+        z = _mm256_shuffle_ps(yz,  m25, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+    inline void
+    storeTriples(float * p, Lanes x, Lanes y, Lanes z) {
+
+        Lanes xy  = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+        Lanes yz  = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+        Lanes zx  = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+        Lanes m03 = _mm256_shuffle_ps(xy, zx, _MM_SHUFFLE(2, 0, 2, 0));
+        Lanes m14 = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+        Lanes m25 = _mm256_shuffle_ps(zx, yz, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(p,      _mm256_castps256_ps128(m03));
+        _mm_storeu_ps(p + 4,  _mm256_castps256_ps128(m14));
+        _mm_storeu_ps(p + 8,  _mm256_castps256_ps128(m25));
+        _mm_storeu_ps(p + 12, _mm256_extractf128_ps(m03, 1));
+        _mm_storeu_ps(p + 16, _mm256_extractf128_ps(m14, 1));
+        _mm_storeu_ps(p + 20, _mm256_extractf128_ps(m25, 1));
+    }
+
+#if defined(__AVX2__)
+    //  Triples 'stride' floats apart (interleaved with other data):
+    inline void
+    gatherTriples(float const * p, int stride, Lanes & x, Lanes & y, Lanes & z) {
+
+        __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                             _mm256_set1_epi32(stride));
+        x = _mm256_i32gather_ps(p,     offsets, 4);
+        y = _mm256_i32gather_ps(p + 1, offsets, 4);
+        z = _mm256_i32gather_ps(p + 2, offsets, 4);
+    }
+#endif
+
+    //
+    //  Normals of a block of vertices -- returns false (with no normals)
+    //  if any squared length is too small for the reciprocal square root
+    //  but not zero, so that the block is computed exactly instead:
+    //
+    inline bool
+    computeBlock(Lanes ux, Lanes uy, Lanes uz, Lanes vx, Lanes vy, Lanes vz,
+                 Lanes & nx, Lanes & ny, Lanes & nz) {
+
+        nx = msub(uy, vz, mul(uz, vy));
+        ny = msub(uz, vx, mul(ux, vz));
+        nz = msub(ux, vy, mul(uy, vx));
+
+        Lanes lenSqrd = madd(nx, nx, madd(ny, ny, mul(nz, nz)));
+
+        Lanes isNormal  = _mm256_cmp_ps(lenSqrd, splat(FLT_MIN), _CMP_GE_OQ);
+        Lanes isNonZero = _mm256_cmp_ps(lenSqrd, splat(0.0f), _CMP_GT_OQ);
+        if (_mm256_movemask_ps(_mm256_andnot_ps(isNormal, isNonZero))) {
+            return false;
+        }
+
+        //  One Newton-Raphson step:  y' = y * (1.5 - 0.5 * lenSqrd * y^2),
+        //  and zero for a zero length:
+        Lanes y = _mm256_rsqrt_ps(lenSqrd);
+        y = mul(y, sub(splat(1.5f), mul(mul(lenSqrd, splat(0.5f)), mul(y, y))));
+        y = _mm256_and_ps(y, isNormal);
+
+        nx = mul(nx, y);
+        ny = mul(ny, y);
+        nz = mul(nz, y);
+        return true;
+    }
+#endif
+}
+
+void
+ComputeVertexNormals(int count, float const du[], float const dv[],
+                     float normals[], int derivStride) {
+
+    int i = 0;
+
+#if defined(__AVX__)
+#if defined(__AVX2__)
+    int numBlocked = count;
+#else
+    //  Transposing triples that are not contiguous is no faster than the
+    //  exact computation without a gather:
+    int numBlocked = (derivStride == 3) ? count : 0;
+#endif
+    for ( ; i + kLanes <= numBlocked; i += kLanes) {
+        float const * u = du + (size_t) i * derivStride;
+        float const * v = dv + (size_t) i * derivStride;
+
+        Lanes ux, uy, uz, vx, vy, vz;
+        if (derivStride == 3) {
+            loadTriples(u, ux, uy, uz);
+            loadTriples(v, vx, vy, vz);
+        } else {
+#if defined(__AVX2__)
+            gatherTriples(u, derivStride, ux, uy, uz);
+            gatherTriples(v, derivStride, vx, vy, vz);
+#endif
+        }
+
+        float * N = normals + 3 * (size_t) i;
+
+        Lanes nx, ny, nz;
+        if (computeBlock(ux, uy, uz, vx, vy, vz, nx, ny, nz)) {
+            storeTriples(N, nx, ny, nz);
+        } else {
+            for (int k = 0; k < kLanes; ++k) {
+                computeNormal(u + k * derivStride, v + k * derivStride, N + 3 * k);
+            }
+        }
+    }
+#endif
+
+    //  Remaining vertices (all without AVX):
+    for ( ; i < count; ++i) {
+        computeNormal(du + (size_t) i * derivStride, dv + (size_t) i * derivStride,
+                      normals + 3 * (size_t) i);
+    }
+}
+
+} // end namespace
@@ -0,0 +1,26 @@
+#ifndef VERTEX_NORMALS_H
+#define VERTEX_NORMALS_H
+
+//  Utilities local to this tutorial:
+namespace tutorial {
+
+//
+//  Unit normals of a batch of vertices from their derivatives -- the
+//  normalized cross products du x dv, zero where degenerate.  Normals are
+//  computed once, separately from any writer, and can then be given to
+//  every writer that needs them.
+//
+//  Derivatives are triples of floats 'derivStride' floats apart (3 when
+//  contiguous, more when interleaved with other data) and normals are
+//  written as contiguous triples.  When AVX is enabled, blocks of 8
+//  vertices are transposed into components (gathered with AVX2 when not
+//  contiguous) and normalized with an approximate reciprocal square root
+//  refined by one Newton-Raphson step -- within a few ulps of the exact
+//  normal.  Otherwise an exact square root is used:
+//
+void ComputeVertexNormals(int count, float const du[], float const dv[],
+                          float normals[], int derivStride = 3);
+
+} // end namespace
+
+#endif /* VERTEX_NORMALS_H */